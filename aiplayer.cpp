@@ -0,0 +1,222 @@
+/*
+ * Tetris -game
+ * Computer player. Searches every final
+ * placement the active tetromino can reach
+ * and picks the best one by a heuristic
+ *
+ * Timi Rautamäki, 284032
+ *
+ */
+
+#include "aiplayer.hh"
+#include <algorithm>
+#include <bitset>
+#include <cstdlib>
+#include <limits>
+
+namespace {
+
+// Weights of the default heuristic
+const double HEIGHT_WEIGHT = -0.510066;
+const double LINES_WEIGHT = 0.760666;
+const double HOLES_WEIGHT = -0.35663;
+const double BUMPINESS_WEIGHT = -0.184483;
+
+// Placements of the active tetromino that get the next one
+// placed on top of them before scoring
+const size_t LOOKAHEAD_BEAM = 6;
+
+// Score of a placement that ends the game
+const double LOST = -std::numeric_limits< double >::max();
+
+int popcount(Board::RowMask mask) {
+    return int(std::bitset< Board::COLUMNS >(mask).count());
+}
+
+}
+
+AiPlayer::AiPlayer(bool lookahead) :
+    heuristic_(defaultScore),
+    lookahead_(lookahead) {
+
+    for ( Search* s : { &first_, &second_ } ) {
+        s->nodes.resize(MAX_NODES);
+        s->seen.assign(MAX_NODES, 0);
+    }
+}
+
+bool AiPlayer::plan(const Engine& engine, std::vector< int >& inputs) {
+    inputs.clear();
+    if ( engine.current() == nullptr || engine.gameOver() ) return false;
+
+    const Board& board = engine.board();
+    int shape = engine.currentShape();
+    int next = lookahead_ ? engine.nextShape() : -1;
+
+    search(board, shape, engine.piece(), first_);
+
+    // Score every placement alone first, only the most
+    // promising ones are worth placing the next tetromino on
+    candidates_.clear();
+    for ( int i = 0; i < first_.count; ++i ) {
+        const Node& node = first_.nodes[i];
+        if ( !node.resting ) continue;
+
+        Board after = board;
+        int lines = lock(after, shape, node);
+        candidates_.push_back({ i, score(after, lines, -1) });
+    }
+
+    if ( next >= 0 ) {
+        size_t beam = std::min(candidates_.size(), size_t(LOOKAHEAD_BEAM));
+        std::stable_sort(candidates_.begin(), candidates_.end(),
+                         [](const Candidate& a, const Candidate& b) {
+            return a.score > b.score;
+        });
+        candidates_.resize(beam);
+
+        for ( Candidate& c : candidates_ ) {
+            Board after = board;
+            int lines = lock(after, shape, first_.nodes[c.node]);
+            c.score = score(after, lines, next);
+        }
+    }
+
+    int best = -1;
+    double best_score = 0;
+    for ( const Candidate& c : candidates_ ) {
+        if ( best < 0 || c.score > best_score ) {
+            best = c.node;
+            best_score = c.score;
+        }
+    }
+
+    // Walk back from the chosen placement to the start
+    for ( int i = best; i > 0; i = first_.nodes[i].parent ) {
+        inputs.push_back(first_.nodes[i].input);
+    }
+    std::reverse(inputs.begin(), inputs.end());
+
+    return true;
+}
+
+AiPlayer::Features AiPlayer::features(const Board& board) {
+    Features f = { 0, 0, 0 };
+
+    // Rows are scanned top down, 'seen' has a bit
+    // for every column that already had a taken cell
+    Board::RowMask seen = 0;
+    for ( int y = 0; y < Board::ROWS; ++y ) {
+        Board::RowMask row = board.row(y);
+        f.holes += popcount(Board::RowMask(seen & ~row));
+        seen |= row;
+    }
+
+    int previous = 0;
+    for ( int x = 0; x < Board::COLUMNS; ++x ) {
+        int height = Board::ROWS - board.surface(x);
+        f.height += height;
+        if ( x > 0 ) {
+            f.bumpiness += std::abs(height - previous);
+        }
+        previous = height;
+    }
+
+    return f;
+}
+
+double AiPlayer::defaultScore(const Board& board, int lines) {
+    Features f = features(board);
+
+    return HEIGHT_WEIGHT * f.height +
+           LINES_WEIGHT * lines +
+           HOLES_WEIGHT * f.holes +
+           BUMPINESS_WEIGHT * f.bumpiness;
+}
+
+void AiPlayer::search(const Board& board, int shape,
+                      const Engine::Pose& start, Search& s) {
+    // Bumping the generation forgets every pose at once
+    ++s.generation;
+    s.count = 0;
+
+    auto index = [](const Engine::Pose& p) {
+        return (p.rotation * Y_SPAN + p.y + 3) * X_SPAN + p.x + 3;
+    };
+
+    auto visit = [&](const Engine::Pose& p, int parent, int input) {
+        int i = index(p);
+        if ( s.seen[i] == s.generation ) return;
+        s.seen[i] = s.generation;
+
+        const Tetrominos::Orientation& o =
+                Tetrominos::orientation(shape, p.rotation);
+        s.nodes[s.count++] = { int8_t(p.x), int8_t(p.rotation),
+                               int8_t(input),
+                               !Tetrominos::fits(board, o, p.x, p.y + 1),
+                               int16_t(p.y), int32_t(parent) };
+    };
+
+    visit(start, -1, Engine::TICK);
+
+    for ( int i = 0; i < s.count; ++i ) {
+        const Node node = s.nodes[i];
+        Engine::Pose pose = { node.x, node.y, node.rotation };
+        const Tetrominos::Orientation& o =
+                Tetrominos::orientation(shape, pose.rotation);
+
+        for ( int dx : { -1, 1 } ) {
+            if ( Tetrominos::fits(board, o, pose.x + dx, pose.y) ) {
+                visit({ pose.x + dx, pose.y, pose.rotation }, i,
+                      dx < 0 ? Engine::LEFT : Engine::RIGHT);
+            }
+        }
+
+        Engine::Pose turned = pose;
+        if ( Engine::rotated(board, shape, turned) ) {
+            visit(turned, i, Engine::ROTATE);
+        }
+
+        if ( !node.resting ) {
+            int distance = Tetrominos::dropDistance(board, o, pose.x, pose.y);
+            visit({ pose.x, pose.y + distance, pose.rotation }, i,
+                  Engine::DROP);
+        }
+    }
+}
+
+int AiPlayer::lock(Board& board, int shape, const Node& node) {
+    const Tetrominos::Orientation& o =
+            Tetrominos::orientation(shape, node.rotation);
+
+    for ( int py = o.min_y; py <= o.max_y; ++py ) {
+        for ( int px = o.min_x; px <= o.max_x; ++px ) {
+            if ( Tetrominos::filled(o, px, py) ) {
+                board.set(node.x + px, node.y + py, shape);
+            }
+        }
+    }
+
+    return board.clearFullRows(node.y + o.min_y, node.y + o.max_y);
+}
+
+double AiPlayer::score(const Board& board, int lines, int next) {
+    if ( Engine::spawnBlocked(board) ) return LOST;
+    if ( next < 0 ) return heuristic_(board, lines);
+
+    search(board, next, Engine::spawnPose(next), second_);
+
+    double best = LOST;
+    for ( int i = 0; i < second_.count; ++i ) {
+        const Node& node = second_.nodes[i];
+        if ( !node.resting ) continue;
+
+        Board after = board;
+        int more = lock(after, next, node);
+        if ( Engine::spawnBlocked(after) ) continue;
+
+        best = std::max(best, heuristic_(after, lines + more));
+    }
+
+    return best;
+}
@@ -0,0 +1,139 @@
+/*
+ * Tetris -game
+ * Computer player. Searches every final
+ * placement the active tetromino can reach
+ * and picks the best one by a heuristic
+ *
+ * Timi Rautamäki, 284032
+ *
+ */
+
+#ifndef AIPLAYER_HH
+#define AIPLAYER_HH
+
+#include "engine.hh"
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+class AiPlayer {
+public:
+    // Shape of the field used by the default heuristic
+    struct Features {
+        // Sum of the column heights
+        int height;
+        // Free cells with a taken cell somewhere above
+        int holes;
+        // Sum of height differences of neighbouring columns
+        int bumpiness;
+    };
+
+    // Scores the field after a lock and the rows it cleared,
+    // higher is better
+    using Heuristic = std::function< double(const Board& board, int lines) >;
+
+    /**
+     * @brief AiPlayer
+     * @param lookahead: also place the next tetromino before scoring
+     */
+    explicit AiPlayer(bool lookahead = true);
+
+    void setHeuristic(const Heuristic& heuristic) { heuristic_ = heuristic; }
+    void setLookahead(bool lookahead) { lookahead_ = lookahead; }
+
+    /**
+     * @brief plan
+     * @param engine: game to play
+     * @param inputs: filled with the inputs that take the active
+     *                tetromino to the chosen placement
+     * @return false if there is no active tetromino
+     * With lookahead only the best few placements by their own
+     * score get the next tetromino placed on top. The tetromino
+     * is left resting on the chosen placement, the next gravity
+     * tick locks it.
+     */
+    bool plan(const Engine& engine, std::vector< int >& inputs);
+
+    /**
+     * @brief features
+     * @param board: field to measure
+     * @return features of the field
+     */
+    static Features features(const Board& board);
+    /**
+     * @brief defaultScore
+     * @param board: field after a lock
+     * @param lines: rows cleared
+     * @return weighted sum of the features and cleared rows
+     */
+    static double defaultScore(const Board& board, int lines);
+
+private:
+    // One pose reached by the search and how it was reached
+    struct Node {
+        int8_t x;
+        int8_t rotation;
+        int8_t input;
+        bool resting;
+        int16_t y;
+        int32_t parent;
+    };
+
+    // Resting pose and its score
+    struct Candidate {
+        int node;
+        double score;
+    };
+
+    // The 4*4 box can hang over the left wall and the top by 3
+    static const int X_SPAN = Board::COLUMNS + 4;
+    static const int Y_SPAN = Board::ROWS + 4;
+    static const int MAX_NODES = Tetrominos::ORIENTATIONS * X_SPAN * Y_SPAN;
+    static_assert(X_SPAN <= INT8_MAX, "Node::x is a byte");
+    static_assert(Y_SPAN <= INT16_MAX, "Node::y is 16 bits");
+
+    // Breadth first search state, reused between searches
+    struct Search {
+        std::vector< Node > nodes;
+        std::vector< uint32_t > seen;
+        uint32_t generation = 0;
+        int count = 0;
+    };
+
+    /**
+     * @brief search
+     * @param board: finished cells
+     * @param shape: tetromino kind
+     * @param start: pose of the tetromino
+     * @param s: filled with every reachable pose
+     * Explores left, right, rotate and drop from the start
+     * exactly like Engine::step() would move the tetromino
+     */
+    static void search(const Board& board, int shape,
+                       const Engine::Pose& start, Search& s);
+    /**
+     * @brief lock
+     * @param board: field to lock onto
+     * @param shape: tetromino kind
+     * @param node: resting pose
+     * @return rows cleared
+     */
+    static int lock(Board& board, int shape, const Node& node);
+    /**
+     * @brief score
+     * @param board: field after a lock
+     * @param lines: rows cleared so far
+     * @param next: tetromino to place before scoring or -1
+     * @return score of the best follow up
+     */
+    double score(const Board& board, int lines, int next);
+
+    Heuristic heuristic_;
+    bool lookahead_;
+
+    Search first_;
+    Search second_;
+    std::vector< Candidate > candidates_;
+};
+
+#endif // AIPLAYER_HH
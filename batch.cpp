@@ -0,0 +1,156 @@
+/*
+ * Tetris -game
+ * Runs many independent seeded games on all
+ * cores and merges their results
+ *
+ * Timi Rautamäki, 284032
+ *
+ */
+
+#include "batch.hh"
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace {
+
+// Each worker owns a slice [next, end) of the game indices. The owner
+// takes from the front, thieves cut from the back. The lock is only
+// contended while somebody is stealing.
+struct Worker {
+    std::mutex lock;
+    long next = 0;
+    long end = 0;
+
+    Batch::Report results;
+
+    // Keeps the next worker off our cache lines
+    char padding[64];
+};
+
+using Workers = std::vector< std::unique_ptr< Worker > >;
+
+bool takeOwn(Worker& worker, long& index) {
+    std::lock_guard< std::mutex > guard(worker.lock);
+    if ( worker.next >= worker.end ) {
+        return false;
+    }
+
+    index = worker.next++;
+    return true;
+}
+
+bool steal(Workers& workers, size_t self) {
+    size_t n = workers.size();
+
+    for ( size_t k = 1; k < n; ++k ) {
+        Worker& victim = *workers.at((self + k) % n);
+        long begin = 0;
+        long end = 0;
+
+        {
+            std::lock_guard< std::mutex > guard(victim.lock);
+            long remaining = victim.end - victim.next;
+            if ( remaining <= 0 ) continue;
+
+            end = victim.end;
+            victim.end -= (remaining + 1) / 2;
+            begin = victim.end;
+        }
+
+        Worker& own = *workers.at(self);
+        std::lock_guard< std::mutex > guard(own.lock);
+        own.next = begin;
+        own.end = end;
+        return true;
+    }
+
+    return false;
+}
+
+void work(Workers& workers, size_t self, unsigned first_seed,
+          const Batch::Game& play) {
+    Worker& own = *workers.at(self);
+    Batch::Report& r = own.results;
+
+    for ( ;; ) {
+        long index = 0;
+        if ( !takeOwn(own, index) ) {
+            if ( !steal(workers, self) ) return;
+            continue;
+        }
+
+        Batch::GameResult game = play(first_seed + unsigned(index));
+
+        ++r.games;
+        r.pieces += game.pieces;
+        r.lines += game.lines;
+        r.points.push_back(game.points);
+        r.time_ms.push_back(game.time_ms);
+        r.lines_per_game.push_back(game.lines);
+    }
+}
+
+template< typename T >
+void append(std::vector< T >& to, const std::vector< T >& from) {
+    to.insert(to.end(), from.begin(), from.end());
+}
+
+}
+
+Batch::Report Batch::run(long games, unsigned first_seed, int threads,
+                         const Game& play) {
+    if ( threads <= 0 ) {
+        threads = int(std::thread::hardware_concurrency());
+        if ( threads <= 0 ) threads = 1;
+    }
+    if ( games < threads ) {
+        threads = games > 0 ? int(games) : 1;
+    }
+
+    // Equal slices to start with
+    Workers workers;
+    for ( int t = 0; t < threads; ++t ) {
+        std::unique_ptr< Worker > w(new Worker);
+        w->next = games * t / threads;
+        w->end = games * (t + 1) / threads;
+        workers.push_back(std::move(w));
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector< std::thread > pool;
+    for ( int t = 1; t < threads; ++t ) {
+        pool.emplace_back(work, std::ref(workers), size_t(t), first_seed,
+                          std::cref(play));
+    }
+    work(workers, 0, first_seed, play);
+    for ( std::thread& t : pool ) {
+        t.join();
+    }
+
+    std::chrono::duration< double > elapsed =
+            std::chrono::steady_clock::now() - start;
+
+    // Merge once everybody is done
+    Report report;
+    report.threads = threads;
+    report.seconds = elapsed.count();
+    for ( const std::unique_ptr< Worker >& w : workers ) {
+        const Report& r = w->results;
+        report.games += r.games;
+        report.pieces += r.pieces;
+        report.lines += r.lines;
+        append(report.points, r.points);
+        append(report.time_ms, r.time_ms);
+        append(report.lines_per_game, r.lines_per_game);
+    }
+
+    std::sort(report.points.begin(), report.points.end());
+    std::sort(report.time_ms.begin(), report.time_ms.end());
+    std::sort(report.lines_per_game.begin(), report.lines_per_game.end());
+
+    return report;
+}
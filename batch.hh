@@ -0,0 +1,59 @@
+/*
+ * Tetris -game
+ * Runs many independent seeded games on all
+ * cores and merges their results
+ *
+ * Timi Rautamäki, 284032
+ *
+ */
+
+#ifndef BATCH_HH
+#define BATCH_HH
+
+#include <functional>
+#include <vector>
+
+class Batch {
+public:
+    // Outcome of one game
+    struct GameResult {
+        int points;
+        long pieces;
+        long lines;
+        // Simulated play time
+        long time_ms;
+    };
+
+    // Merged outcome of all games. The per-game
+    // vectors are sorted for percentiles.
+    struct Report {
+        long games = 0;
+        long pieces = 0;
+        long lines = 0;
+        int threads = 0;
+        double seconds = 0;
+        std::vector< int > points;
+        std::vector< long > time_ms;
+        std::vector< long > lines_per_game;
+    };
+
+    // Plays the game with the given seed to the end.
+    // Called from several threads at once.
+    using Game = std::function< GameResult(unsigned seed) >;
+
+    /**
+     * @brief run
+     * @param games: number of games to play
+     * @param first_seed: seed of the first game, the rest follow
+     * @param threads: worker threads, 0 for one per core
+     * @param play: plays one game
+     * @return merged results
+     * Each worker starts with an equal slice of the seeds and steals
+     * half of another worker's remaining slice when it runs out.
+     * Results stay in the worker until everything is done.
+     */
+    static Report run(long games, unsigned first_seed, int threads,
+                      const Game& play);
+};
+
+#endif // BATCH_HH
@@ -0,0 +1,551 @@
+/*
+ * Tetris -game
+ * Microbenchmarks for the engine hot paths.
+ * Prints one CSV row per operation and fixture
+ *
+ * Timi Rautamäki, 284032
+ *
+ */
+
+#include "engine.hh"
+#include "featurebatch.hh"
+#include "wideboard.hh"
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Counts every heap allocation made by the process
+std::atomic< long > allocations(0);
+
+// Results are summed here so the compiler cannot drop the work
+volatile long sink = 0;
+
+// How long to run each measurement
+const double TARGET_SECONDS = 0.2;
+
+const int POINTS_PER_ROW = 15;
+
+// Candidate boards per feature evaluation, about one placement search
+const int BATCH_BOARDS = 256;
+
+struct Fixture {
+    std::string name;
+    // Active tetromino in the air, ready to move
+    Engine engine;
+    // Same with the tetromino already dropped, next tick locks it
+    Engine dropped;
+};
+
+/**
+ * @brief makeFixture
+ * @param name: fixture name
+ * @param board: finished cells
+ * @param well_tetris: place a vertical long tetromino over the well
+ */
+Fixture makeFixture(const std::string& name, const Board& board,
+                    bool well_tetris = false) {
+    Fixture f = { name, Engine(), Engine() };
+
+    // The long tetromino can only turn once it is below the ceiling
+    unsigned seed = 1;
+    do {
+        f.engine.reset(seed++, POINTS_PER_ROW);
+    } while ( well_tetris &&
+              f.engine.currentShape() != Engine::HORIZONTAL );
+
+    for ( int i = 0; i < 3; ++i ) {
+        f.engine.step(Engine::TICK);
+    }
+    if ( well_tetris ) {
+        f.engine.step(Engine::ROTATE);
+    }
+
+    f.engine.setBoard(board);
+    f.dropped = f.engine;
+    f.dropped.step(Engine::DROP);
+
+    return f;
+}
+
+/**
+ * @brief fillRows
+ * @param board: board to fill
+ * @param top: first row to fill
+ * @param random: fixed-seed generator
+ * Fill the rows from 'top' to the floor with about 70 %
+ * density, leaving at least one hole in every row
+ */
+void fillRows(Board& board, int top, std::mt19937& random) {
+    for ( int y = top; y < Board::ROWS; ++y ) {
+        int hole = random() % Board::COLUMNS;
+        for ( int x = 0; x < Board::COLUMNS; ++x ) {
+            if ( x != hole && random() % 10 < 7 ) {
+                board.set(x, y, random() % Engine::NUMBER_OF_TETROMINOS);
+            }
+        }
+    }
+}
+
+std::vector< Fixture > makeFixtures() {
+    std::mt19937 random(1234);
+    std::vector< Fixture > fixtures;
+
+    Board empty;
+    fixtures.push_back(makeFixture("empty", empty));
+
+    Board half;
+    fillRows(half, Board::ROWS / 2, random);
+    fixtures.push_back(makeFixture("half_full", half));
+
+    // Spawn zone stays free so the game goes on
+    Board near_top;
+    fillRows(near_top, 4, random);
+    fixtures.push_back(makeFixture("near_top_out", near_top));
+
+    // Four full rows except the column under the long tetromino
+    Board tetris;
+    int well = 6;
+    for ( int y = Board::ROWS - 4; y < Board::ROWS; ++y ) {
+        for ( int x = 0; x < Board::COLUMNS; ++x ) {
+            if ( x != well ) {
+                tetris.set(x, y, random() % Engine::NUMBER_OF_TETROMINOS);
+            }
+        }
+    }
+    fixtures.push_back(makeFixture("tetris_ready", tetris, true));
+
+    return fixtures;
+}
+
+/**
+ * @brief naiveFeatures
+ * @param board: board to measure
+ * @param f: filled with FeatureBatch::FEATURE values
+ * Cell by cell reference for FeatureBatch
+ */
+void naiveFeatures(const Board& board, int f[]) {
+    const int W = Board::COLUMNS;
+    const int H = Board::ROWS;
+
+    int height[W];
+    for ( int x = 0; x < W; ++x ) {
+        height[x] = 0;
+        for ( int y = 0; y < H; ++y ) {
+            if ( board.occupied(x, y) ) {
+                height[x] = H - y;
+                break;
+            }
+        }
+    }
+
+    for ( int i = 0; i < FeatureBatch::NUMBER_OF_FEATURES; ++i ) {
+        f[i] = 0;
+    }
+
+    for ( int x = 0; x < W; ++x ) {
+        f[FeatureBatch::HEIGHT] += height[x];
+        if ( x + 1 < W ) {
+            f[FeatureBatch::BUMPINESS] += std::abs(height[x] - height[x + 1]);
+        }
+
+        bool above = false;
+        int depth = 0;
+        for ( int y = 0; y <= H; ++y ) {
+            bool taken = board.occupied(x, y);
+            f[FeatureBatch::COLUMN_TRANSITIONS] += taken != above;
+            above = taken;
+
+            if ( y >= H ) break;
+            if ( y >= H - height[x] ) {
+                f[FeatureBatch::HOLES] += !taken;
+            } else if ( board.occupied(x - 1, y) &&
+                        board.occupied(x + 1, y) ) {
+                f[FeatureBatch::WELLS] += ++depth;
+            } else {
+                depth = 0;
+            }
+        }
+    }
+
+    for ( int y = 0; y < H; ++y ) {
+        bool left = true;
+        for ( int x = 0; x <= W; ++x ) {
+            bool taken = board.occupied(x, y);
+            f[FeatureBatch::ROW_TRANSITIONS] += taken != left;
+            left = taken;
+        }
+    }
+}
+
+/**
+ * @brief makeCandidates
+ * @param f: fixture
+ * @return BATCH_BOARDS boards a placement search could score
+ * Every rotation and column of the fixture's tetromino comes
+ * first. The rest drop a few more random tetrominos after one
+ * of those, so that no two lanes of a batch are alike.
+ */
+std::vector< Board > makeCandidates(const Fixture& f) {
+    std::mt19937 random(99);
+    std::vector< Board > boards;
+    const int placements = 4 * Engine::COLUMNS;
+
+    for ( int b = 0; b < BATCH_BOARDS; ++b ) {
+        Engine work = f.engine;
+        for ( int drop = 0; drop <= b / placements; ++drop ) {
+            int rotations = drop == 0 ? b % 4 : int(random() % 4);
+            int shift = drop == 0 ? b / 4 % Engine::COLUMNS
+                                  : int(random() % Engine::COLUMNS);
+            shift -= Engine::COLUMNS / 2;
+
+            for ( int i = 0; i < rotations; ++i ) {
+                work.step(Engine::ROTATE);
+            }
+            for ( int i = 0; i < std::abs(shift); ++i ) {
+                work.step(shift < 0 ? Engine::LEFT : Engine::RIGHT);
+            }
+            work.step(Engine::DROP);
+            work.step(Engine::TICK);
+            if ( work.gameOver() ) break;
+        }
+        boards.push_back(work.board());
+    }
+
+    return boards;
+}
+
+/**
+ * @brief checkFeatures
+ * @param batch: evaluated batch
+ * @param boards: the boards added to the batch, in order
+ * @param kernel: kernel name for the message
+ * @param fixture: fixture name for the message
+ * A fast kernel that disagrees with the reference makes
+ * its timing meaningless, say so loudly
+ */
+void checkFeatures(const FeatureBatch& batch,
+                   const std::vector< Board >& boards,
+                   const char* kernel, const std::string& fixture) {
+    int expected[FeatureBatch::NUMBER_OF_FEATURES];
+    for ( int b = 0; b < batch.size(); ++b ) {
+        naiveFeatures(boards.at(size_t(b)), expected);
+        for ( int i = 0; i < FeatureBatch::NUMBER_OF_FEATURES; ++i ) {
+            if ( batch.feature(i, b) != expected[i] ) {
+                std::cerr << kernel << " features differ on " << fixture
+                          << std::endl;
+                return;
+            }
+        }
+    }
+}
+
+/**
+ * @brief measure
+ * @param body: operation to time, called repeatedly
+ * @param iterations: filled with the number of calls made
+ * @param allocs: filled with the allocations made
+ * @return seconds taken
+ */
+template< typename F >
+double measure(F body, long& iterations, long& allocs) {
+    using Clock = std::chrono::steady_clock;
+
+    // Calibrate the iteration count
+    iterations = 1000;
+    for ( ;; ) {
+        auto start = Clock::now();
+        for ( long i = 0; i < iterations; ++i ) {
+            body();
+        }
+        std::chrono::duration< double > d = Clock::now() - start;
+        if ( d.count() > TARGET_SECONDS / 10 ) break;
+        iterations *= 4;
+    }
+    iterations *= 10;
+
+    long before = allocations.load(std::memory_order_relaxed);
+    auto start = Clock::now();
+    for ( long i = 0; i < iterations; ++i ) {
+        body();
+    }
+    std::chrono::duration< double > d = Clock::now() - start;
+    allocs = allocations.load(std::memory_order_relaxed) - before;
+
+    return d.count();
+}
+
+/**
+ * @brief report
+ * @param op: operation name
+ * @param fixture: fixture name
+ * @param body: operation to time
+ * @param baseline: ns/op spent on setup inside 'body', subtracted
+ * @return measured ns/op before subtracting the baseline
+ */
+template< typename F >
+double report(const std::string& op, const std::string& fixture, F body,
+              double baseline = 0) {
+    long iterations = 0;
+    long allocs = 0;
+    double s = measure(body, iterations, allocs);
+
+    double ns = s * 1e9 / iterations;
+    double net = ns - baseline > 0 ? ns - baseline : 0;
+
+    std::cout << op << ','
+              << fixture << ','
+              << iterations << ','
+              << net << ','
+              << double(allocs) / iterations << ','
+              << (net > 0 ? 1e9 / net : 0) << '\n';
+
+    return ns;
+}
+
+/**
+ * @brief checkWideFits
+ * @param board: board to test, its cells are changed
+ * Compare WideBoard::fits with a cell by cell test for every
+ * orientation along the right wall and the floor, where the
+ * tetromino rows end in the last word of the row
+ */
+void checkWideFits(WideBoard& board) {
+    std::mt19937 random(1234);
+    board.clear();
+    for ( int y = board.rows() - 6; y < board.rows(); ++y ) {
+        for ( int x = board.columns() - 8; x < board.columns(); ++x ) {
+            if ( random() % 3 == 0 ) board.set(x, y);
+        }
+    }
+
+    for ( int kind = 0; kind < Tetrominos::NUMBER_OF_TETROMINOS; ++kind ) {
+        for ( int rotation = 0; rotation < 4; ++rotation ) {
+            const Tetrominos::Orientation& o =
+                    Tetrominos::orientation(kind, rotation);
+            for ( int y = board.rows() - 7; y < board.rows(); ++y ) {
+                for ( int x = board.columns() - 8; x < board.columns(); ++x ) {
+                    bool expected = true;
+                    for ( int py = 0; py < 4; ++py ) {
+                        for ( int px = 0; px < 4; ++px ) {
+                            if ( Tetrominos::filled(o, px, py) &&
+                                 board.occupied(x + px, y + py) ) {
+                                expected = false;
+                            }
+                        }
+                    }
+                    if ( board.fits(o, x, y) != expected ) {
+                        std::cerr << "wide fits differs at the right wall of "
+                                  << board.columns() << "x" << board.rows()
+                                  << std::endl;
+                        return;
+                    }
+                }
+            }
+        }
+    }
+}
+
+/**
+ * @brief benchWide
+ * @param columns: board width
+ * @param rows: board height
+ * Row operations of the stress test board, with every row
+ * one cell short of full. Each is timed with the scalar
+ * loops and with AVX2 if the CPU has it.
+ */
+void benchWide(int columns, int rows) {
+    std::mt19937 random(4321);
+    WideBoard board(columns, rows);
+    checkWideFits(board);
+    for ( int y = 0; y < rows; ++y ) {
+        board.fillRow(y, int(random() % unsigned(columns)));
+    }
+
+    // Sparse mask over the whole width
+    std::vector< uint64_t > mask(size_t(board.words()), 0);
+    for ( int x = 0; x < columns; x += 1 + int(random() % 7) ) {
+        mask[size_t(x / 64)] |= uint64_t(1) << (x % 64);
+    }
+
+    std::string fixture = std::to_string(columns) + "x" +
+                          std::to_string(rows);
+    const Tetrominos::Orientation& o =
+            Tetrominos::orientation(Engine::PYRAMID, 0);
+    int bottom = rows - 4;
+
+    for ( int avx2 = 0; avx2 < 2; ++avx2 ) {
+        if ( board.setAvx2(avx2 != 0) != (avx2 != 0) ) break;
+        std::string kernel = avx2 ? "_avx2" : "_scalar";
+
+        int y = 0;
+        report("wide_is_full" + kernel, fixture, [&]() {
+            sink = sink + board.isFull(y);
+            y = y + 1 < rows ? y + 1 : 0;
+        });
+
+        report("wide_collide" + kernel, fixture, [&]() {
+            sink = sink + board.collides(mask.data(), y);
+            y = y + 1 < rows ? y + 1 : 0;
+        });
+
+        // Refilling the four bottom rows is part of clearing them,
+        // its cost is subtracted
+        double fill = report("wide_fill_4" + kernel, fixture, [&]() {
+            for ( int r = bottom; r < rows; ++r ) {
+                board.fillRow(r);
+            }
+            sink = sink + board.row(rows - 1)[0];
+        });
+
+        report("wide_clear_4" + kernel, fixture, [&]() {
+            for ( int r = bottom; r < rows; ++r ) {
+                board.fillRow(r);
+            }
+            sink = sink + board.clearFullRows(bottom, rows - 1);
+        }, fill);
+    }
+
+    int x = 0;
+    report("wide_fits", fixture, [&]() {
+        sink = sink + board.fits(o, x, bottom);
+        x = x + 4 < columns ? x + 1 : 0;
+    });
+}
+
+}
+
+void* operator new(std::size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if ( void* p = std::malloc(size ? size : 1) ) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+int main() {
+    std::vector< Fixture > fixtures = makeFixtures();
+
+    std::cout << "op,fixture,iterations,ns_per_op,allocs_per_op,ops_per_sec\n";
+
+    for ( const Fixture& f : fixtures ) {
+        Engine work;
+
+        // Restoring the fixture is part of every mutating operation,
+        // its cost is subtracted from those rows
+        double copy = report("copy_fixture", f.name, [&]() {
+            work = f.engine;
+            sink = sink + work.piece().x;
+        });
+
+        report("check_space", f.name, [&]() {
+            const Engine::Pose& p = f.engine.piece();
+            sink = sink + Tetrominos::fits(f.engine.board(),
+                                           *f.engine.current(),
+                                           p.x + (sink & 1), p.y + 1);
+        });
+
+        report("move_block", f.name, [&]() {
+            work = f.engine;
+            sink = sink + work.step((sink & 1) ? Engine::LEFT
+                                               : Engine::RIGHT).moved;
+        }, copy);
+
+        report("rotate_tetromino", f.name, [&]() {
+            work = f.engine;
+            sink = sink + work.step(Engine::ROTATE).moved;
+        }, copy);
+
+        report("drop_distance", f.name, [&]() {
+            sink = sink + f.engine.dropDistance();
+        });
+
+        report("move_to_bottom", f.name, [&]() {
+            work = f.engine;
+            sink = sink + work.step(Engine::DROP).moved;
+        }, copy);
+
+        report("finish_tetromino", f.name, [&]() {
+            work = f.dropped;
+            sink = sink + work.step(Engine::TICK).lines;
+        }, copy);
+
+        Board board;
+        double board_copy = report("copy_board", f.name, [&]() {
+            board = f.dropped.board();
+            sink = sink + board.row(Board::ROWS - 1);
+        });
+
+        report("clear_rows", f.name, [&]() {
+            board = f.dropped.board();
+            sink = sink + board.clearFullRows(0, Board::ROWS - 1);
+        }, board_copy);
+
+        // The cell walk draw() does before handing squares to Qt
+        report("draw_cells", f.name, [&]() {
+            const Board& field = f.engine.board();
+            long cells = 0;
+            for ( int y = 0; y < Board::ROWS; ++y ) {
+                if ( field.row(y) == 0 ) continue;
+                for ( int x = 0; x < Board::COLUMNS; ++x ) {
+                    cells += field.colour(x, y) != Board::EMPTY;
+                }
+            }
+            sink = sink + cells;
+        });
+
+        // Features of a placement search worth of boards, one by one
+        // and in batches
+        std::vector< Board > candidates = makeCandidates(f);
+        report("features_naive_x256", f.name, [&]() {
+            int values[FeatureBatch::NUMBER_OF_FEATURES];
+            for ( const Board& candidate : candidates ) {
+                naiveFeatures(candidate, values);
+                sink = sink + values[FeatureBatch::HOLES];
+            }
+        });
+
+        FeatureBatch batch;
+        for ( const Board& candidate : candidates ) {
+            batch.add(candidate);
+        }
+
+        report("features_scalar_x256", f.name, [&]() {
+            batch.evaluateScalar();
+            sink = sink + batch.feature(FeatureBatch::HOLES, 0);
+        });
+        checkFeatures(batch, candidates, "scalar", f.name);
+
+        if ( FeatureBatch::hasAvx2() ) {
+            report("features_avx2_x256", f.name, [&]() {
+                batch.evaluateAvx2();
+                sink = sink + batch.feature(FeatureBatch::HOLES, 0);
+            });
+            checkFeatures(batch, candidates, "avx2", f.name);
+        }
+    }
+
+    // Stress test boards from the game's size up to the largest
+    benchWide(Board::COLUMNS, Board::ROWS);
+    benchWide(64, 256);
+    benchWide(128, 1024);
+    benchWide(256, 2048);
+    benchWide(WideBoard::MAX_COLUMNS, WideBoard::MAX_ROWS);
+
+    std::cout.flush();
+    return 0;
+}
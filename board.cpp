@@ -0,0 +1,153 @@
+/*
+ * Tetris -game
+ * Bitboard that holds the finished
+ * tetrominos of the game field
+ *
+ * Timi Rautamäki, 284032
+ *
+ */
+
+#include "board.hh"
+#include <cstring>
+
+template< int WIDTH, int HEIGHT >
+BasicBoard< WIDTH, HEIGHT >::BasicBoard() {
+    clear();
+}
+
+template< int WIDTH, int HEIGHT >
+void BasicBoard< WIDTH, HEIGHT >::clear() {
+    std::memset(rows_, 0, sizeof(rows_));
+    std::memset(surface_, ROWS, sizeof(surface_));
+}
+
+template< int WIDTH, int HEIGHT >
+bool BasicBoard< WIDTH, HEIGHT >::occupied(int x, int y) const {
+    if ( x < 0 || x >= COLUMNS || y >= ROWS ) return true;
+    if ( y < 0 ) return false;
+
+    return (rows_[y].mask >> x) & 1;
+}
+
+template< int WIDTH, int HEIGHT >
+int BasicBoard< WIDTH, HEIGHT >::colour(int x, int y) const {
+    if ( x < 0 || x >= COLUMNS || y < 0 || y >= ROWS ) return EMPTY;
+    if ( !occupied(x, y) ) return EMPTY;
+
+    const Row& r = rows_[y];
+    return  ((r.colour[0] >> x) & 1)
+          | ((r.colour[1] >> x) & 1) << 1
+          | ((r.colour[2] >> x) & 1) << 2;
+}
+
+template< int WIDTH, int HEIGHT >
+void BasicBoard< WIDTH, HEIGHT >::set(int x, int y, int colour) {
+    if ( x < 0 || x >= COLUMNS || y < 0 || y >= ROWS ) return;
+
+    Row& r = rows_[y];
+    RowMask bit = RowMask(RowMask(1) << x);
+
+    r.mask |= bit;
+    if ( y < surface_[x] ) {
+        surface_[x] = uint8_t(y);
+    }
+
+    for ( int plane = 0; plane < 3; ++plane ) {
+        if ( (colour >> plane) & 1 ) {
+            r.colour[plane] |= bit;
+        } else {
+            r.colour[plane] &= RowMask(~bit);
+        }
+    }
+}
+
+template< int WIDTH, int HEIGHT >
+int BasicBoard< WIDTH, HEIGHT >::clearFullRows(int top, int bottom) {
+    if ( top < 0 ) top = 0;
+    if ( bottom >= ROWS ) bottom = ROWS - 1;
+
+    // Compact the checked range from the bottom up,
+    // skipping the full rows
+    int cleared = 0;
+    int write = bottom;
+    for ( int y = bottom; y >= top; --y ) {
+        if ( rows_[y].mask == FULL_ROW ) {
+            ++cleared;
+            continue;
+        }
+        if ( write != y ) {
+            rows_[write] = rows_[y];
+        }
+        --write;
+    }
+
+    if ( cleared == 0 ) return 0;
+
+    // Everything above the range slides down in a single copy
+    std::memmove(&rows_[cleared], &rows_[0], top * sizeof(Row));
+    std::memset(&rows_[0], 0, cleared * sizeof(Row));
+
+    for ( int x = 0; x < COLUMNS; ++x ) {
+        if ( surface_[x] < top ) {
+            // Top cell was above the cleared rows and moved with them
+            surface_[x] = uint8_t(surface_[x] + cleared);
+        } else if ( surface_[x] <= bottom ) {
+            // Top cell was inside the range, find the new one
+            RowMask bit = RowMask(RowMask(1) << x);
+            int y = top + cleared;
+            while ( y < ROWS && !(rows_[y].mask & bit) ) {
+                ++y;
+            }
+            surface_[x] = uint8_t(y);
+        }
+    }
+
+    return cleared;
+}
+
+template< int WIDTH, int HEIGHT >
+bool BasicBoard< WIDTH, HEIGHT >::pushUp(int lines, int hole) {
+    if ( lines <= 0 ) return true;
+    if ( lines > ROWS ) lines = ROWS;
+
+    bool overflow = false;
+    for ( int y = 0; y < lines; ++y ) {
+        overflow = overflow || rows_[y].mask != 0;
+    }
+
+    std::memmove(&rows_[0], &rows_[lines], (ROWS - lines) * sizeof(Row));
+
+    RowMask mask = FULL_ROW;
+    if ( hole >= 0 && hole < COLUMNS ) {
+        mask = RowMask(mask & ~(RowMask(1) << hole));
+    }
+    for ( int y = ROWS - lines; y < ROWS; ++y ) {
+        Row& r = rows_[y];
+        r.mask = mask;
+        for ( int plane = 0; plane < 3; ++plane ) {
+            r.colour[plane] = ((GARBAGE >> plane) & 1) ? mask : RowMask(0);
+        }
+    }
+
+    for ( int x = 0; x < COLUMNS; ++x ) {
+        if ( surface_[x] < ROWS ) {
+            // Cells pushed over the top leave the top row taken
+            int y = surface_[x] - lines;
+            surface_[x] = uint8_t(y > 0 ? y : 0);
+        } else if ( (mask >> x) & 1 ) {
+            surface_[x] = uint8_t(ROWS - lines);
+        }
+    }
+
+    return !overflow;
+}
+
+// The standard field and the field of this game, plus the
+// field of the build if it is neither
+template class BasicBoard< 10, 20 >;
+template class BasicBoard< 12, 24 >;
+
+#if !(BOARD_WIDTH == 10 && BOARD_HEIGHT == 20) && \
+    !(BOARD_WIDTH == 12 && BOARD_HEIGHT == 24)
+template class BasicBoard< BOARD_WIDTH, BOARD_HEIGHT >;
+#endif
@@ -0,0 +1,159 @@
+/*
+ * Tetris -game
+ * Bitboard that holds the finished
+ * tetrominos of the game field
+ *
+ * Timi Rautamäki, 284032
+ *
+ */
+
+#ifndef BOARD_HH
+#define BOARD_HH
+
+#include <cstdint>
+#include <type_traits>
+
+// Size of the game field. Every size is a separate build,
+// e.g. DEFINES += BOARD_WIDTH=10 BOARD_HEIGHT=20
+#ifndef BOARD_WIDTH
+#define BOARD_WIDTH 12
+#endif
+#ifndef BOARD_HEIGHT
+#define BOARD_HEIGHT 24
+#endif
+
+/**
+ * @brief RowMaskFor
+ * Narrowest unsigned type with at least 'BITS' bits
+ */
+template< int BITS >
+using RowMaskFor =
+    typename std::conditional< (BITS <= 8), uint8_t,
+    typename std::conditional< (BITS <= 16), uint16_t,
+    typename std::conditional< (BITS <= 32), uint32_t,
+                               uint64_t >::type >::type >::type;
+
+template< int WIDTH, int HEIGHT >
+class BasicBoard {
+public:
+    static_assert(WIDTH >= 4 && WIDTH <= 64, "a row must fit 64 bits");
+    static_assert(HEIGHT >= 4 && HEIGHT < 255, "rows are counted in bytes");
+
+    static const int COLUMNS = WIDTH;
+    static const int ROWS = HEIGHT;
+
+    // One bit per column, bit 0 is the leftmost column
+    using RowMask = RowMaskFor< WIDTH >;
+    static const RowMask FULL_ROW =
+            RowMask(RowMask(~RowMask(0)) >> (8 * sizeof(RowMask) - WIDTH));
+
+    // Colour value returned for empty cells
+    static const int EMPTY = -1;
+    // Colour of garbage rows, after the tetrominos
+    static const int GARBAGE = 7;
+
+    BasicBoard();
+
+    /**
+     * @brief clear
+     * Empty the whole board
+     */
+    void clear();
+    /**
+     * @brief occupied
+     * @param x: column
+     * @param y: row
+     * @return true if the cell is taken. Cells outside the
+     *         walls and floor count as taken, cells above
+     *         the top of the field count as free
+     */
+    bool occupied(int x, int y) const;
+    /**
+     * @brief colour
+     * @param x: column
+     * @param y: row
+     * @return tetromino kind of the cell or EMPTY
+     */
+    int colour(int x, int y) const;
+    /**
+     * @brief set
+     * @param x: column
+     * @param y: row
+     * @param colour: tetromino kind (0..7)
+     * Mark a cell as taken with given colour
+     */
+    void set(int x, int y, int colour);
+    /**
+     * @brief row
+     * @param y: row
+     * @return occupancy mask of the row
+     */
+    RowMask row(int y) const { return rows_[y].mask; }
+    /**
+     * @brief isFull
+     * @param y: row
+     * @return true if every column of the row is taken
+     */
+    bool isFull(int y) const { return rows_[y].mask == FULL_ROW; }
+    /**
+     * @brief plane
+     * @param y: row
+     * @param bit: 0..2
+     * @return bit 'bit' of the colour of every cell in the row
+     */
+    RowMask plane(int y, int bit) const { return rows_[y].colour[bit]; }
+    /**
+     * @brief columnEmpty
+     * @param x: column
+     * @return true if no cell of the column is taken
+     */
+    bool columnEmpty(int x) const { return surface_[x] == ROWS; }
+    /**
+     * @brief surface
+     * @param x: column
+     * @return row of the topmost taken cell of the column,
+     *         ROWS if the column is empty
+     */
+    int surface(int x) const { return surface_[x]; }
+    /**
+     * @brief clearFullRows
+     * @param top: first row to check
+     * @param bottom: last row to check
+     * @return number of rows cleared
+     * Remove every full row between 'top' and 'bottom' and
+     * compact the rows above them down in a single pass
+     */
+    int clearFullRows(int top, int bottom);
+    /**
+     * @brief pushUp
+     * @param lines: rows to add at the floor
+     * @param hole: column left free in the added rows
+     * @return false if taken cells were pushed over the top
+     * Lift everything up and fill the bottom rows with
+     * GARBAGE cells except for 'hole'
+     */
+    bool pushUp(int lines, int hole);
+
+private:
+    // Occupancy and a 3-bit colour index split into bit planes,
+    // on 12*24 a row is 8 bytes and the whole board 3 cache lines
+    struct Row {
+        RowMask mask;
+        RowMask colour[3];
+    };
+
+    Row rows_[ROWS];
+
+    // Topmost taken row per column, kept up to date
+    // by set() and clearFullRows()
+    uint8_t surface_[COLUMNS];
+};
+
+// Sizes compiled into board.cpp
+extern template class BasicBoard< 10, 20 >;
+extern template class BasicBoard< 12, 24 >;
+
+// Board of this build
+using Board = BasicBoard< BOARD_WIDTH, BOARD_HEIGHT >;
+
+#endif // BOARD_HH
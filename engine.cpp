@@ -0,0 +1,415 @@
+/*
+ * Tetris -game
+ * Game rules without any UI. Advanced one
+ * input at a time with step()
+ *
+ * Timi Rautamäki, 284032
+ *
+ */
+
+#include "engine.hh"
+#include "trace.hh"
+#include <cstring>
+
+const Engine::DIFFICULTY_CONSTANTS
+Engine::DIFFICULTIES[Engine::NUMBER_OF_DIFFICULTIES] = {
+    { EASY, 10, 800 },
+    { MEDIUM, 15, 400 },
+    { INSANE, 25, 150 },
+};
+
+Engine::Engine() :
+    distr(0, NUMBER_OF_TETROMINOS - 1) {
+}
+
+void Engine::reset(unsigned seed, int points_per_row) {
+    field_.clear();
+    current_ = nullptr;
+    fast_ = false;
+    game_over_ = false;
+    points_per_row_ = points_per_row;
+    points_ = 0;
+    pieces_ = 0;
+    lines_ = 0;
+
+    // Setting random engine ready for the first real call.
+    randomEng.seed(seed);
+    distr.reset();
+    distr(randomEng);
+
+    next_shape_ = distr(randomEng);
+    createBlock(distr(randomEng));
+}
+
+void Engine::save(State& state) const {
+    // Zeroed padding keeps the bytes of equal states equal
+    std::memset(&state, 0, sizeof(state));
+
+    for ( int y = 0; y < ROWS; ++y ) {
+        for ( int x = 0; x < COLUMNS; ++x ) {
+            state.cells[y][x] = int8_t(field_.colour(x, y));
+        }
+    }
+    state.x = piece_.x;
+    state.y = piece_.y;
+    state.rotation = piece_.rotation;
+    state.current_shape = current_ ? current_shape_ : -1;
+    state.next_shape = next_shape_;
+    state.points_per_row = points_per_row_;
+    state.points = points_;
+    state.pieces = int32_t(pieces_);
+    state.lines = int32_t(lines_);
+    state.fast = fast_;
+    state.game_over = game_over_;
+    // The distribution keeps nothing between calls for this range
+    state.random = randomEng.state;
+}
+
+bool Engine::restore(const State& state) {
+    if ( state.current_shape < -1 ||
+         state.current_shape >= NUMBER_OF_TETROMINOS ||
+         state.next_shape < 0 || state.next_shape >= NUMBER_OF_TETROMINOS ||
+         state.rotation < 0 || state.rotation >= Tetrominos::ORIENTATIONS ||
+         state.random == 0 || state.random >= Random::MODULUS ||
+         state.points_per_row < 0 || state.points < 0 ||
+         state.pieces < 0 || state.lines < 0 ) {
+        return false;
+    }
+
+    // The 4*4 box may only stick out as far as a tetromino can
+    if ( state.x < -4 || state.x >= COLUMNS ||
+         state.y < -4 || state.y >= ROWS ) {
+        return false;
+    }
+
+    Board field;
+    for ( int y = 0; y < ROWS; ++y ) {
+        for ( int x = 0; x < COLUMNS; ++x ) {
+            int colour = state.cells[y][x];
+            if ( colour < Board::EMPTY || colour > Board::GARBAGE ) {
+                return false;
+            }
+            if ( colour != Board::EMPTY ) {
+                field.set(x, y, colour);
+            }
+        }
+    }
+
+    // The active tetromino can't overlap the field, the walls or
+    // the floor. One spawned into a blocked spawn zone does until
+    // the next tick ends the game.
+    if ( state.current_shape >= 0 && !spawnBlocked(field) &&
+         !Tetrominos::fits(field,
+                           Tetrominos::orientation(state.current_shape,
+                                                   state.rotation),
+                           state.x, state.y) ) {
+        return false;
+    }
+
+    field_ = field;
+    piece_ = { state.x, state.y, state.rotation };
+    current_shape_ = state.current_shape < 0 ? 0 : state.current_shape;
+    current_ = state.current_shape < 0
+            ? nullptr
+            : &Tetrominos::orientation(current_shape_, piece_.rotation);
+    next_shape_ = state.next_shape;
+    points_per_row_ = state.points_per_row;
+    points_ = state.points;
+    pieces_ = state.pieces;
+    lines_ = state.lines;
+    fast_ = state.fast != 0;
+    game_over_ = state.game_over != 0;
+
+    randomEng.state = state.random;
+    distr.reset();
+    return true;
+}
+
+Engine::Events Engine::step(int input) {
+    Events events;
+    if ( game_over_ ) {
+        events.game_over = true;
+        return events;
+    }
+
+    switch ( input ) {
+    case TICK:
+        // Finished tetrominos in the spawn zone end the game
+        if ( spawnBlocked(field_) ) {
+            Trace::record< Trace::ENGINE >(Trace::GAME_OVER, points_, pieces_);
+            game_over_ = true;
+            events.game_over = true;
+            return events;
+        }
+        moveBlock(DOWN, events);
+        break;
+    case LEFT:
+    case RIGHT:
+        moveBlock(input, events);
+        break;
+    case DOWN:
+        fast_ = true;
+        moveBlock(DOWN, events);
+        break;
+    case DOWN_RELEASE:
+        fast_ = false;
+        break;
+    case ROTATE:
+        events.moved = rotateTetromino();
+        break;
+    case DROP:
+        if ( current_ != nullptr ) {
+            int y = piece_.y;
+            moveToBottom();
+            events.moved = piece_.y != y;
+        }
+        break;
+    }
+
+    return events;
+}
+
+Engine::Events Engine::addGarbage(int lines, int hole) {
+    Events events;
+    if ( game_over_ || lines <= 0 ) {
+        events.game_over = game_over_;
+        return events;
+    }
+
+    if ( !field_.pushUp(lines, hole) ) {
+        Trace::record< Trace::ENGINE >(Trace::GAME_OVER, points_, pieces_);
+        game_over_ = true;
+        events.game_over = true;
+        return events;
+    }
+
+    // The field moved up by 'lines' under the tetromino,
+    // so at most that much lift makes it fit again
+    if ( current_ != nullptr ) {
+        for ( int i = 0; i < lines &&
+              !Tetrominos::fits(field_, *current_, piece_.x, piece_.y); ++i ) {
+            --piece_.y;
+            events.moved = true;
+        }
+    }
+
+    return events;
+}
+
+int Engine::dropDistance() const {
+    if ( current_ == nullptr ) return 0;
+
+    return Tetrominos::dropDistance(field_, *current_, piece_.x, piece_.y);
+}
+
+int Engine::checkSpace(int dx, int dy) const {
+    int x = piece_.x + dx;
+    int y = piece_.y + dy;
+
+    // Check for walls
+    if ( x + current_->min_x < 0 ||             // Left wall
+         x + current_->max_x >= COLUMNS ) {     // Right wall
+        return WALL;
+    }
+
+    if ( y + current_->max_y >= ROWS ) {
+        return FLOOR;
+    }
+
+    // Check for other blocks
+    if ( !Tetrominos::fits(field_, *current_, x, y) ) {
+        return TETROMINO;
+    }
+
+    return NONE;
+}
+
+bool Engine::placePiece(const Pose& pose) {
+    const Tetrominos::Orientation& o =
+            Tetrominos::orientation(current_shape_, pose.rotation);
+
+    if ( !Tetrominos::fits(field_, o, pose.x, pose.y) ) {
+        return false;
+    }
+
+    current_ = &o;
+    piece_ = pose;
+
+    return true;
+}
+
+void Engine::moveBlock(int d, Events& events) {
+    if ( current_ == nullptr ) return;
+
+    // Default delta x and delta y
+    int dx = 0;
+    int dy = 0;
+
+    switch ( d ) {
+    case LEFT:
+        dx = -LATERAL_SPEED;
+        break;
+    case RIGHT:
+        dx = LATERAL_SPEED;
+        break;
+    case DOWN:
+        dy = fast_ ? KEYPRESS_SPEED : SPEED;
+        break;
+    }
+
+    int obstacle = checkSpace(dx, dy);
+    if ( obstacle != NONE ) {
+        Trace::record< Trace::ENGINE >(Trace::BLOCKED, obstacle, d);
+    }
+
+    switch ( obstacle ) {
+    case TETROMINO:
+    case FLOOR:
+        if ( d != DOWN ) {
+            return;
+        }
+        if ( fast_ ) {
+            moveToBottom();
+        }
+        finishTetromino(events);
+        return;
+    case WALL:
+        return;
+    }
+
+    events.moved = placePiece({ piece_.x + dx, piece_.y + dy,
+                                piece_.rotation });
+}
+
+void Engine::moveToBottom() {
+    if ( current_ == nullptr ) return;
+
+    Pose pose = piece_;
+    pose.y += dropDistance();
+
+    placePiece(pose);
+}
+
+bool Engine::rotateTetromino() {
+    if ( current_ == nullptr ) return false;
+
+    Pose pose = piece_;
+    if ( !rotated(field_, current_shape_, pose) ) {
+        return false;
+    }
+
+    current_ = &Tetrominos::orientation(current_shape_, pose.rotation);
+    piece_ = pose;
+
+    return true;
+}
+
+bool Engine::rotated(const Board& board, int shape, Pose& pose) {
+    if ( shape == SQUARE ) return false;
+
+    int rotation = (pose.rotation + 1) % Tetrominos::ORIENTATIONS;
+    const Tetrominos::Orientation& next =
+            Tetrominos::orientation(shape, rotation);
+    const Tetrominos::KickList& kicks = Tetrominos::kicks(shape, rotation);
+
+    // Try the kick offsets in order, first free one wins.
+    // Rotating over the ceiling is not allowed.
+    for ( int k = 0; k < kicks.count; ++k ) {
+        int x = pose.x + kicks.kicks[k].dx;
+        int y = pose.y + kicks.kicks[k].dy;
+
+        if ( y + next.min_y < 0 ) continue;
+
+        if ( Tetrominos::fits(board, next, x, y) ) {
+            pose = { x, y, rotation };
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void Engine::finishTetromino(Events& events) {
+    bool above_top = piece_.y + current_->min_y < 0;
+    for ( int py = current_->min_y; py <= current_->max_y; ++py ) {
+        for ( int px = current_->min_x; px <= current_->max_x; ++px ) {
+            if ( Tetrominos::filled(*current_, px, py) ) {
+                field_.set(piece_.x + px, piece_.y + py, current_shape_);
+            }
+        }
+    }
+
+    // Only the rows the tetromino landed on can be full
+    int lines = field_.clearFullRows(piece_.y + current_->min_y,
+                                     piece_.y + current_->max_y);
+    points_ += lines * points_per_row_;
+    lines_ += lines;
+
+    Trace::record< Trace::ENGINE >(Trace::LOCK, piece_.x, piece_.y);
+    if ( lines > 0 ) {
+        Trace::record< Trace::ENGINE >(Trace::LINES, lines, points_);
+    }
+
+    events.locked = true;
+    events.lines = lines;
+
+    // Randomize next tetromino
+    current_ = nullptr;
+    createBlock(next_shape_);
+    next_shape_ = distr(randomEng);
+
+    // Cells locked above the top are lost, the game ends with them
+    if ( above_top ) {
+        Trace::record< Trace::ENGINE >(Trace::GAME_OVER, points_, pieces_);
+        game_over_ = true;
+        events.game_over = true;
+    }
+}
+
+void Engine::createBlock(int tetromino) {
+    current_ = &Tetrominos::orientation(tetromino, 0);
+    current_shape_ = tetromino;
+    ++pieces_;
+
+    piece_ = spawnPose(tetromino);
+    Trace::record< Trace::ENGINE >(Trace::SPAWN, tetromino, pieces_);
+}
+
+Engine::Pose Engine::spawnPose(int shape) {
+    // The 4*4 box is centred, x = 4 on the 12 wide field
+    int start_x = (COLUMNS - 4) / 2;
+    int start_y = 0;
+
+    switch ( shape ) {
+    case HORIZONTAL:
+        start_y = -3;
+        break;
+    case SQUARE:
+        start_y = -1;
+        break;
+    case STEP_UP_RIGHT:
+    case STEP_UP_LEFT:
+    case LEFT_CORNER:
+    case RIGHT_CORNER:
+    case PYRAMID:
+        start_y = -2;
+        break;
+    }
+
+    // The 4*4 is allowed to go over the top
+    return { start_x, start_y, 0 };
+}
+
+bool Engine::spawnBlocked(const Board& board) {
+    // Six middle columns of the three top rows, 3..8 on 12 columns
+    const Board::RowMask SPAWN_ZONE =
+            Board::RowMask(Board::RowMask(0x3f) << ((COLUMNS - 6) / 2));
+
+    for ( int y = 0; y < 3; ++y ) {
+        if ( board.row(y) & SPAWN_ZONE ) {
+            return true;
+        }
+    }
+
+    return false;
+}
@@ -0,0 +1,290 @@
+/*
+ * Tetris -game
+ * Game rules without any UI. Advanced one
+ * input at a time with step()
+ *
+ * Timi Rautamäki, 284032
+ *
+ */
+
+#ifndef ENGINE_HH
+#define ENGINE_HH
+
+#include "board.hh"
+#include "tetromino.hh"
+#include <random>
+
+class Engine {
+public:
+    static const int COLUMNS = Board::COLUMNS;
+    static const int ROWS = Board::ROWS;
+
+    // Constants for different tetrominos and the number of them
+    enum TETROMINO_KIND { HORIZONTAL,
+                          LEFT_CORNER,
+                          RIGHT_CORNER,
+                          SQUARE,
+                          STEP_UP_RIGHT,
+                          PYRAMID,
+                          STEP_UP_LEFT,
+                          NUMBER_OF_TETROMINOS };
+
+    // Inputs accepted by step(). TICK is one step of gravity,
+    // DOWN_RELEASE ends the fast gravity started by DOWN.
+    enum INPUT { TICK,
+                 LEFT,
+                 RIGHT,
+                 DOWN,
+                 DOWN_RELEASE,
+                 ROTATE,
+                 DROP,
+                 NUMBER_OF_INPUTS };
+
+    enum OBSTACLE { NONE, WALL, FLOOR, TETROMINO };
+
+    // Difficulty defines the rate at which
+    // tetrominos fall (clock tick delay).
+    enum DIFFICULTY { EASY,
+                      MEDIUM,
+                      INSANE,
+                      NUMBER_OF_DIFFICULTIES };
+
+    struct DIFFICULTY_CONSTANTS {
+        int difficulty;
+        int points;
+        int speed;
+    };
+
+    static const DIFFICULTY_CONSTANTS DIFFICULTIES[NUMBER_OF_DIFFICULTIES];
+
+    // How often to increase difficulty in seconds
+    static const int DIFFICULTY_INTERVAL = 30;
+    // Maximum difficulty. Lower is harder
+    static const int MAX_DIFFICULTY = 70;
+    // How much to increase difficulty per DIFFICULTY_INTERVAL
+    static const int DIFFICULTY_STEP = 20;
+
+    // Position of the active tetromino's 4*4 box and its orientation
+    struct Pose {
+        int x;
+        int y;
+        int rotation;
+    };
+
+    // What happened during one step
+    struct Events {
+        bool moved = false;
+        bool locked = false;
+        int lines = 0;
+        bool game_over = false;
+    };
+
+    // Everything needed to continue a game, fixed layout so it
+    // can be copied to a file as is. See save() and restore().
+    struct State {
+        // Tetromino kind of each cell, -1 for free
+        int8_t cells[ROWS][COLUMNS];
+        int32_t x;
+        int32_t y;
+        int32_t rotation;
+        // Active tetromino, -1 between tetrominos
+        int32_t current_shape;
+        int32_t next_shape;
+        int32_t points_per_row;
+        int32_t points;
+        int32_t pieces;
+        int32_t lines;
+        // Tetromino generator
+        uint32_t random;
+        uint8_t fast;
+        uint8_t game_over;
+    };
+
+    Engine();
+
+    /**
+     * @brief reset
+     * @param seed: seed for the tetromino sequence
+     * @param points_per_row: points for each cleared row
+     * Start a new game and spawn the first tetromino
+     */
+    void reset(unsigned seed, int points_per_row);
+    /**
+     * @brief save
+     * @param state: filled with the game
+     */
+    void save(State& state) const;
+    /**
+     * @brief restore
+     * @param state: game saved with save()
+     * @return false if the state is not a valid game,
+     *         the engine is left unchanged then
+     */
+    bool restore(const State& state);
+    /**
+     * @brief step
+     * @param input: one of INPUT
+     * @return events caused by the input
+     */
+    Events step(int input);
+    /**
+     * @brief setBoard
+     * @param board: finished cells to play on
+     * Replace the finished cells of the field,
+     * used to set up fixtures
+     */
+    void setBoard(const Board& board) { field_ = board; }
+    /**
+     * @brief addGarbage
+     * @param lines: garbage rows sent by the opponent
+     * @param hole: column left free in them
+     * @return events, game over if cells went over the top
+     * Push the field up from the floor. The active tetromino
+     * moves up with it if it would overlap.
+     */
+    Events addGarbage(int lines, int hole);
+
+    const Board& board() const { return field_; }
+    const Pose& piece() const { return piece_; }
+    // Active orientation, nullptr between tetrominos
+    const Tetrominos::Orientation* current() const { return current_; }
+    int currentShape() const { return current_shape_; }
+    int nextShape() const { return next_shape_; }
+    bool fast() const { return fast_; }
+    bool gameOver() const { return game_over_; }
+    int points() const { return points_; }
+    long pieces() const { return pieces_; }
+    long lines() const { return lines_; }
+    /**
+     * @brief dropDistance
+     * @return rows the active tetromino can fall
+     */
+    int dropDistance() const;
+
+    /*
+     *  Rules shared with players that search ahead
+     */
+
+    /**
+     * @brief spawnPose
+     * @param shape: one of TETROMINO_KIND
+     * @return where a new tetromino of the kind appears
+     */
+    static Pose spawnPose(int shape);
+    /**
+     * @brief rotated
+     * @param board: finished cells
+     * @param shape: one of TETROMINO_KIND
+     * @param pose: turned to the next orientation on success
+     * @return false if no kick offset fits
+     */
+    static bool rotated(const Board& board, int shape, Pose& pose);
+    /**
+     * @brief spawnBlocked
+     * @param board: finished cells
+     * @return true if a finished tetromino reaches the spawn zone
+     */
+    static bool spawnBlocked(const Board& board);
+
+private:
+    /**
+     * @brief checkSpace
+     * @param dx: delta x
+     * @param dy: delta y
+     * @return what blocks the active tetromino from moving
+     */
+    int checkSpace(int dx, int dy) const;
+    /**
+     * @brief placePiece
+     * @param pose: position and orientation to go to
+     * @return false if the tetromino does not fit there
+     */
+    bool placePiece(const Pose& pose);
+    /**
+     * @brief moveBlock
+     * @param d: LEFT, RIGHT or DOWN
+     * @param events: filled with what happened
+     */
+    void moveBlock(int d, Events& events);
+    /**
+     * @brief moveToBottom
+     * Move tetromino as low as possible
+     */
+    void moveToBottom();
+    /**
+     * @brief rotateTetromino
+     * Turn the active tetromino to its next
+     * orientation, kicking it off walls and
+     * blocks if needed
+     */
+    bool rotateTetromino();
+    /**
+     * @brief finishTetromino
+     * @param events: filled with what happened
+     * Move a tetromino to be part of the floor,
+     * clear rows and spawn the next one. Locking
+     * above the top ends the game.
+     */
+    void finishTetromino(Events& events);
+    /**
+     * @brief createBlock
+     * @param tetromino: kind to spawn
+     */
+    void createBlock(int tetromino);
+
+    Board field_;
+
+    Pose piece_ = { 0, 0, 0 };
+    const Tetrominos::Orientation* current_ = nullptr;
+    int current_shape_ = 0;
+    int next_shape_ = 0;
+
+    // Fast gravity while 'Down' is held
+    bool fast_ = false;
+    bool game_over_ = false;
+
+    int points_per_row_ = 0;
+    int points_ = 0;
+    long pieces_ = 0;
+    long lines_ = 0;
+
+    // Park-Miller generator, the same sequence as std::minstd_rand0
+    // but with its state in the open so save() can copy it
+    struct Random {
+        using result_type = uint32_t;
+        static const uint32_t MULTIPLIER = 16807;
+        static const uint32_t MODULUS = 2147483647;
+
+        static constexpr result_type min() { return 1; }
+        static constexpr result_type max() { return MODULUS - 1; }
+
+        /**
+         * @brief seed
+         * @param seed: any value, 0 and multiples of MODULUS
+         *        seed like 1 does
+         */
+        void seed(uint32_t seed) {
+            state = seed % MODULUS;
+            if ( state == 0 ) state = 1;
+        }
+        result_type operator()() {
+            state = uint32_t(uint64_t(state) * MULTIPLIER % MODULUS);
+            return state;
+        }
+
+        uint32_t state = 1;
+    };
+
+    // For randomly selecting the next dropping tetromino
+    Random randomEng;
+    std::uniform_int_distribution<int> distr;
+
+    // How much to move a block per tick
+    static const int SPEED = 1;
+    // How much to move a block per tick with fast gravity
+    static const int KEYPRESS_SPEED = 2 * SPEED;
+    // How much to move a block sideways on keypress
+    static const int LATERAL_SPEED = 1;
+};
+
+#endif // ENGINE_HH
@@ -0,0 +1,248 @@
+/*
+ * Tetris -game
+ * Computes the features of many candidate
+ * boards at once, with AVX2 where available
+ *
+ * Timi Rautamäki, 284032
+ *
+ */
+
+#include "featurebatch.hh"
+#include <bitset>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define FEATUREBATCH_AVX2
+#include <immintrin.h>
+#endif
+
+// Row transitions pad a row with a wall on both sides
+static_assert(Board::COLUMNS + 2 <= 16, "rows must fit 16-bit lanes");
+// Well depths are counted in 5 bit planes
+static_assert(Board::ROWS < 32, "well depth must fit 5 bits");
+
+namespace {
+
+const int WELL_PLANES = 5;
+
+const uint16_t FULL_ROW = Board::FULL_ROW;
+const uint16_t LEFT_WALL = 1;
+const uint16_t RIGHT_WALL = 1 << (Board::COLUMNS - 1);
+// Row shifted one to the right with both walls added
+const uint16_t PADDED_WALLS = 1 | (1 << (Board::COLUMNS + 1));
+const uint16_t PADDED_ROW = (1 << (Board::COLUMNS + 1)) - 1;
+
+int popcount(uint16_t mask) {
+    return int(std::bitset< 16 >(mask).count());
+}
+
+}
+
+int FeatureBatch::add(const Board& board) {
+    if ( count_ == capacity_ ) {
+        grow();
+    }
+
+    for ( int y = 0; y < Board::ROWS; ++y ) {
+        rows_[size_t(y) * capacity_ + count_] = board.row(y);
+    }
+
+    return count_++;
+}
+
+void FeatureBatch::grow() {
+    int capacity = capacity_ == 0 ? 4 * LANES : 2 * capacity_;
+
+    // Padding boards stay empty
+    std::vector< uint16_t > rows(size_t(Board::ROWS) * capacity, 0);
+    for ( int y = 0; y < Board::ROWS; ++y ) {
+        for ( int b = 0; b < count_; ++b ) {
+            rows[size_t(y) * capacity + b] = rows_[size_t(y) * capacity_ + b];
+        }
+    }
+
+    rows_.swap(rows);
+    features_.assign(size_t(NUMBER_OF_FEATURES) * capacity, 0);
+    capacity_ = capacity;
+}
+
+void FeatureBatch::evaluate() {
+    if ( !evaluateAvx2() ) {
+        evaluateScalar();
+    }
+}
+
+void FeatureBatch::evaluateScalar() {
+    for ( int b = 0; b < count_; ++b ) {
+        int f[NUMBER_OF_FEATURES] = {};
+
+        // Columns that have had a taken cell so far, top down
+        uint16_t seen = 0;
+        uint16_t previous = 0;
+        // Depth of the open well of each column, bit sliced
+        uint16_t depth[WELL_PLANES] = {};
+
+        for ( int y = 0; y < Board::ROWS; ++y ) {
+            uint16_t row = rows_[size_t(y) * capacity_ + b];
+
+            f[HOLES] += popcount(uint16_t(seen & ~row));
+            f[COLUMN_TRANSITIONS] += popcount(uint16_t(row ^ previous));
+
+            uint16_t padded = uint16_t((row << 1) | PADDED_WALLS);
+            f[ROW_TRANSITIONS] +=
+                    popcount(uint16_t((padded ^ (padded >> 1)) & PADDED_ROW));
+
+            // Free cells between two taken ones with nothing above
+            uint16_t well = uint16_t(~row & ~seen & FULL_ROW &
+                                     ((row << 1) | LEFT_WALL) &
+                                     ((row >> 1) | RIGHT_WALL));
+            uint16_t carry = well;
+            for ( int p = 0; p < WELL_PLANES; ++p ) {
+                uint16_t next = depth[p] & carry;
+                depth[p] = (depth[p] ^ carry) & well;
+                carry = next;
+                f[WELLS] += popcount(depth[p]) << p;
+            }
+
+            seen |= row;
+            previous = row;
+
+            // A column counts every row from its top to the floor
+            f[HEIGHT] += popcount(seen);
+            f[BUMPINESS] +=
+                    popcount(uint16_t((seen ^ (seen >> 1)) & (FULL_ROW >> 1)));
+        }
+
+        // The floor counts as taken
+        f[COLUMN_TRANSITIONS] += popcount(uint16_t(previous ^ FULL_ROW));
+
+        for ( int i = 0; i < NUMBER_OF_FEATURES; ++i ) {
+            features_[size_t(i) * capacity_ + b] = uint16_t(f[i]);
+        }
+    }
+}
+
+#ifdef FEATUREBATCH_AVX2
+
+namespace {
+
+// Bit count of each 16-bit lane, from a nibble lookup table
+__attribute__((target("avx2")))
+__m256i popcount16(__m256i v) {
+    const __m256i table = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3,
+                                           1, 2, 2, 3, 2, 3, 3, 4,
+                                           0, 1, 1, 2, 1, 2, 2, 3,
+                                           1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i nibble = _mm256_set1_epi8(0x0f);
+
+    __m256i low = _mm256_shuffle_epi8(table, _mm256_and_si256(v, nibble));
+    __m256i high = _mm256_shuffle_epi8(
+                table, _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble));
+    __m256i bytes = _mm256_add_epi8(low, high);
+
+    return _mm256_add_epi16(_mm256_and_si256(bytes, _mm256_set1_epi16(0xff)),
+                            _mm256_srli_epi16(bytes, 8));
+}
+
+}
+
+bool FeatureBatch::hasAvx2() {
+    return __builtin_cpu_supports("avx2");
+}
+
+__attribute__((target("avx2")))
+bool FeatureBatch::evaluateAvx2() {
+    if ( !hasAvx2() ) return false;
+
+    const __m256i full = _mm256_set1_epi16(short(FULL_ROW));
+    const __m256i inner = _mm256_set1_epi16(short(FULL_ROW >> 1));
+    const __m256i left_wall = _mm256_set1_epi16(short(LEFT_WALL));
+    const __m256i right_wall = _mm256_set1_epi16(short(RIGHT_WALL));
+    const __m256i padded_walls = _mm256_set1_epi16(short(PADDED_WALLS));
+    const __m256i padded_row = _mm256_set1_epi16(short(PADDED_ROW));
+
+    // Same as evaluateScalar() with 16 boards in the lanes
+    for ( int b = 0; b < count_; b += LANES ) {
+        __m256i f[NUMBER_OF_FEATURES];
+        for ( __m256i& v : f ) {
+            v = _mm256_setzero_si256();
+        }
+
+        __m256i seen = _mm256_setzero_si256();
+        __m256i previous = _mm256_setzero_si256();
+        __m256i depth[WELL_PLANES];
+        for ( __m256i& v : depth ) {
+            v = _mm256_setzero_si256();
+        }
+
+        for ( int y = 0; y < Board::ROWS; ++y ) {
+            __m256i row = _mm256_loadu_si256(reinterpret_cast< const __m256i* >(
+                                                 &rows_[size_t(y) * capacity_ + b]));
+
+            f[HOLES] = _mm256_add_epi16(
+                        f[HOLES], popcount16(_mm256_andnot_si256(row, seen)));
+            f[COLUMN_TRANSITIONS] = _mm256_add_epi16(
+                        f[COLUMN_TRANSITIONS],
+                        popcount16(_mm256_xor_si256(row, previous)));
+
+            __m256i padded = _mm256_or_si256(_mm256_slli_epi16(row, 1),
+                                             padded_walls);
+            __m256i changes = _mm256_and_si256(
+                        _mm256_xor_si256(padded, _mm256_srli_epi16(padded, 1)),
+                        padded_row);
+            f[ROW_TRANSITIONS] = _mm256_add_epi16(f[ROW_TRANSITIONS],
+                                                  popcount16(changes));
+
+            __m256i open = _mm256_andnot_si256(_mm256_or_si256(row, seen),
+                                               full);
+            __m256i well = _mm256_and_si256(
+                        open,
+                        _mm256_and_si256(
+                            _mm256_or_si256(_mm256_slli_epi16(row, 1),
+                                            left_wall),
+                            _mm256_or_si256(_mm256_srli_epi16(row, 1),
+                                            right_wall)));
+            __m256i carry = well;
+            for ( int p = 0; p < WELL_PLANES; ++p ) {
+                __m256i next = _mm256_and_si256(depth[p], carry);
+                depth[p] = _mm256_and_si256(_mm256_xor_si256(depth[p], carry),
+                                            well);
+                carry = next;
+                f[WELLS] = _mm256_add_epi16(
+                            f[WELLS], _mm256_slli_epi16(popcount16(depth[p]), p));
+            }
+
+            seen = _mm256_or_si256(seen, row);
+            previous = row;
+
+            f[HEIGHT] = _mm256_add_epi16(f[HEIGHT], popcount16(seen));
+            __m256i steps = _mm256_and_si256(
+                        _mm256_xor_si256(seen, _mm256_srli_epi16(seen, 1)),
+                        inner);
+            f[BUMPINESS] = _mm256_add_epi16(f[BUMPINESS], popcount16(steps));
+        }
+
+        f[COLUMN_TRANSITIONS] = _mm256_add_epi16(
+                    f[COLUMN_TRANSITIONS],
+                    popcount16(_mm256_xor_si256(previous, full)));
+
+        for ( int i = 0; i < NUMBER_OF_FEATURES; ++i ) {
+            _mm256_storeu_si256(reinterpret_cast< __m256i* >(
+                                    &features_[size_t(i) * capacity_ + b]),
+                                f[i]);
+        }
+    }
+
+    return true;
+}
+
+#else
+
+bool FeatureBatch::hasAvx2() {
+    return false;
+}
+
+bool FeatureBatch::evaluateAvx2() {
+    return false;
+}
+
+#endif
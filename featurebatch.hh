@@ -0,0 +1,103 @@
+/*
+ * Tetris -game
+ * Computes the features of many candidate
+ * boards at once, with AVX2 where available
+ *
+ * Timi Rautamäki, 284032
+ *
+ */
+
+#ifndef FEATUREBATCH_HH
+#define FEATUREBATCH_HH
+
+#include "board.hh"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class FeatureBatch {
+public:
+    // Features computed for every board
+    enum FEATURE { HEIGHT,              // Sum of the column heights
+                   HOLES,               // Free cells under a taken one
+                   BUMPINESS,           // Sum of neighbour height gaps
+                   ROW_TRANSITIONS,     // Taken/free changes along rows
+                   COLUMN_TRANSITIONS,  // Taken/free changes down columns
+                   WELLS,               // Cumulative depth of open wells
+                   NUMBER_OF_FEATURES };
+
+    // Boards handled by one vector, the batch is padded to this
+    static const int LANES = 16;
+
+    /**
+     * @brief clear
+     * Forget the boards but keep the memory
+     */
+    void clear() { count_ = 0; }
+    /**
+     * @brief add
+     * @param board: candidate board
+     * @return index of the board in the batch
+     */
+    int add(const Board& board);
+    int size() const { return count_; }
+
+    /**
+     * @brief evaluate
+     * Compute the features of every board with the
+     * fastest kernel the CPU supports
+     */
+    void evaluate();
+    /**
+     * @brief evaluateScalar
+     * Compute the features one board at a time
+     */
+    void evaluateScalar();
+    /**
+     * @brief evaluateAvx2
+     * @return false if the CPU or the build lacks AVX2
+     * Compute the features of 16 boards per step
+     */
+    bool evaluateAvx2();
+    /**
+     * @brief hasAvx2
+     * @return true if evaluateAvx2() can run
+     */
+    static bool hasAvx2();
+
+    /**
+     * @brief feature
+     * @param feature: one of FEATURE
+     * @param board: index from add()
+     * @return value from the last evaluation
+     */
+    int feature(int feature, int board) const {
+        return features_[size_t(feature) * capacity_ + board];
+    }
+    /**
+     * @brief features
+     * @param feature: one of FEATURE
+     * @return values of one feature for every board
+     */
+    const uint16_t* features(int feature) const {
+        return features_.data() + size_t(feature) * capacity_;
+    }
+
+private:
+    /**
+     * @brief grow
+     * Double the capacity, moving the rows over
+     */
+    void grow();
+
+    int count_ = 0;
+    int capacity_ = 0;
+
+    // Structure of arrays: row y of board b is at y * capacity_ + b,
+    // so one load brings the same row of 16 boards
+    std::vector< uint16_t > rows_;
+    // Feature f of board b is at f * capacity_ + b
+    std::vector< uint16_t > features_;
+};
+
+#endif // FEATUREBATCH_HH
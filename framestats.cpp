@@ -0,0 +1,139 @@
+/*
+ * Tetris -game
+ * Frame timing statistics. Durations go into
+ * fixed size log-linear histograms that can be
+ * summarized on screen and saved as CSV
+ *
+ * Timi Rautamäki, 284032
+ *
+ */
+
+#include "framestats.hh"
+#include <cstdio>
+#include <fstream>
+
+namespace {
+
+const char* NAMES[FrameStats::NUMBER_OF_METRICS] = {
+    "simulation", "scene", "paint", "frame_lateness", "tick_lateness"
+};
+
+// Position of the highest set bit, 'value' is not 0
+int highestBit(uint32_t value) {
+#if defined(__GNUC__)
+    return 31 - __builtin_clz(value);
+#else
+    int bit = 0;
+    while ( value >>= 1 ) {
+        ++bit;
+    }
+    return bit;
+#endif
+}
+
+}
+
+void FrameStats::Histogram::record(uint32_t value) {
+    ++buckets_[bucketOf(value)];
+    ++count_;
+    if ( value > max_ ) max_ = value;
+}
+
+void FrameStats::Histogram::clear() {
+    *this = Histogram();
+}
+
+int FrameStats::Histogram::bucketOf(uint32_t value) {
+    if ( value < uint32_t(LINEAR) ) {
+        return int(value);
+    }
+
+    // Keep the top SUB_BITS + 1 bits, the first of them is always set
+    int shift = highestBit(value) - SUB_BITS;
+    int sub = int(value >> shift) - SUB_BUCKETS;
+
+    return LINEAR + (shift - 1) * SUB_BUCKETS + sub;
+}
+
+uint32_t FrameStats::Histogram::lowest(int bucket) {
+    if ( bucket < LINEAR ) {
+        return uint32_t(bucket);
+    }
+
+    int shift = (bucket - LINEAR) / SUB_BUCKETS + 1;
+    int sub = (bucket - LINEAR) % SUB_BUCKETS;
+
+    return uint32_t(SUB_BUCKETS + sub) << shift;
+}
+
+uint32_t FrameStats::Histogram::highest(int bucket) {
+    if ( bucket + 1 == BUCKETS ) {
+        return UINT32_MAX;
+    }
+
+    return lowest(bucket + 1) - 1;
+}
+
+uint32_t FrameStats::Histogram::percentile(double p) const {
+    if ( count_ == 0 ) return 0;
+
+    // Rank of the wanted value, 1-based
+    uint64_t rank = uint64_t(p / 100.0 * double(count_) + 0.5);
+    if ( rank < 1 ) rank = 1;
+    if ( rank > count_ ) rank = count_;
+
+    uint64_t seen = 0;
+    for ( int b = 0; b < BUCKETS; ++b ) {
+        seen += buckets_[b];
+        if ( seen >= rank ) {
+            uint32_t high = highest(b);
+            return high < max_ ? high : max_;
+        }
+    }
+
+    return max_;
+}
+
+const char* FrameStats::name(int metric) {
+    return NAMES[metric];
+}
+
+void FrameStats::clear() {
+    for ( Histogram& h : histograms_ ) {
+        h.clear();
+    }
+}
+
+std::string FrameStats::summary() const {
+    std::string text = "ms                 p50    p99    max\n";
+    char line[96];
+
+    for ( int m = 0; m < NUMBER_OF_METRICS; ++m ) {
+        const Histogram& h = histograms_[m];
+        std::snprintf(line, sizeof(line),
+                      "%-15s%7.2f%7.2f%7.2f\n",
+                      NAMES[m], h.percentile(50) / 1000.0,
+                      h.percentile(99) / 1000.0, h.max() / 1000.0);
+        text += line;
+    }
+
+    return text;
+}
+
+bool FrameStats::writeCsv(const std::string& filename) const {
+    std::ofstream file(filename);
+    if ( !file ) return false;
+
+    file << "metric,low_us,high_us,count\n";
+    for ( int m = 0; m < NUMBER_OF_METRICS; ++m ) {
+        const Histogram& h = histograms_[m];
+        for ( int b = 0; b < Histogram::BUCKETS; ++b ) {
+            if ( h.bucketCount(b) == 0 ) continue;
+
+            file << NAMES[m] << ',' << Histogram::lowest(b) << ','
+                 << Histogram::highest(b) << ',' << h.bucketCount(b) << '\n';
+        }
+    }
+
+    return bool(file);
+}
@@ -0,0 +1,89 @@
+/*
+ * Tetris -game
+ * Frame timing statistics. Durations go into
+ * fixed size log-linear histograms that can be
+ * summarized on screen and saved as CSV
+ *
+ * Timi Rautamäki, 284032
+ *
+ */
+
+#ifndef FRAMESTATS_HH
+#define FRAMESTATS_HH
+
+#include <cstdint>
+#include <string>
+
+class FrameStats {
+public:
+    // What is measured, all in microseconds
+    enum METRIC { SIMULATION,       // Inputs and gravity of one frame
+                  SCENE,            // Updating the scene items
+                  PAINT,            // Painting the game view
+                  FRAME_LATENESS,   // Frame timer behind its interval
+                  TICK_LATENESS,    // Gravity step behind its due time
+                  NUMBER_OF_METRICS };
+
+    // Values are bucketed by their highest bit and the next
+    // SUB_BITS bits, so a bucket is at most 1/16 of its value wide.
+    // Values below 2^(SUB_BITS+1) get a bucket each.
+    class Histogram {
+    public:
+        static const int SUB_BITS = 4;
+        static const int SUB_BUCKETS = 1 << SUB_BITS;
+        static const int LINEAR = 2 * SUB_BUCKETS;
+        static const int BUCKETS = LINEAR + (32 - SUB_BITS - 1) * SUB_BUCKETS;
+
+        void record(uint32_t value);
+        void clear();
+
+        uint64_t count() const { return count_; }
+        uint32_t max() const { return max_; }
+        /**
+         * @brief percentile
+         * @param p: 0..100
+         * @return upper end of the bucket holding the p:th
+         *         percentile, at most the largest value seen
+         */
+        uint32_t percentile(double p) const;
+
+        uint64_t bucketCount(int bucket) const { return buckets_[bucket]; }
+        static int bucketOf(uint32_t value);
+        // Smallest and largest value of a bucket
+        static uint32_t lowest(int bucket);
+        static uint32_t highest(int bucket);
+
+    private:
+        uint64_t buckets_[BUCKETS] = {};
+        uint64_t count_ = 0;
+        uint32_t max_ = 0;
+    };
+
+    static const char* name(int metric);
+
+    void record(int metric, uint32_t micros) {
+        histograms_[metric].record(micros);
+    }
+    const Histogram& histogram(int metric) const {
+        return histograms_[metric];
+    }
+    void clear();
+
+    /**
+     * @brief summary
+     * @return p50, p99 and max of every metric in ms, one per line
+     */
+    std::string summary() const;
+    /**
+     * @brief writeCsv
+     * @param filename: file to write
+     * @return false on write errors
+     * One metric,low_us,high_us,count row per non-empty bucket
+     */
+    bool writeCsv(const std::string& filename) const;
+
+private:
+    Histogram histograms_[NUMBER_OF_METRICS];
+};
+
+#endif // FRAMESTATS_HH
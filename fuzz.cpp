@@ -0,0 +1,587 @@
+/*
+ * Tetris -game
+ * Fuzz target for the game engine. Drives the
+ * engine with random or coverage guided inputs
+ * and checks its invariants after every step.
+ * Failures are shrunk to the shortest input
+ * that still breaks the same invariant.
+ *
+ * Timi Rautamäki, 284032
+ *
+ */
+
+#include "engine.hh"
+#include "replay.hh"
+#include <algorithm>
+#include <atomic>
+#include <bitset>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Input layout: the seed as 4 little endian bytes, then one byte
+// per action. The low 3 bits are an Engine::INPUT, or GARBAGE
+// which pushes up 1..4 rows by bits 3..4 and takes the next byte
+// for the hole.
+const size_t SEED_BYTES = 4;
+const int GARBAGE = Engine::NUMBER_OF_INPUTS;
+const int POINTS_PER_ROW = 10;
+
+// Steps checked after the game is over, it must stay over
+const int STEPS_AFTER_GAME_OVER = 4;
+
+// What went wrong and at which action
+struct Failure {
+    const char* what = nullptr;
+    size_t action = 0;
+};
+
+int cellCount(const Board& board) {
+    int cells = 0;
+    for ( int y = 0; y < Board::ROWS; ++y ) {
+        cells += int(std::bitset< Board::COLUMNS >(board.row(y)).count());
+    }
+    return cells;
+}
+
+// Invariants of the engine between two steps
+class Checker {
+public:
+    void start(const Engine& engine) {
+        points_ = engine.points();
+        lines_ = engine.lines();
+        pieces_ = engine.pieces();
+        cells_ = cellCount(engine.board());
+        game_over_ = engine.gameOver();
+        blocked_ = Engine::spawnBlocked(engine.board());
+    }
+
+    /**
+     * @brief check
+     * @param engine: engine after the step
+     * @param events: what the step reported
+     * @param garbage: the step was addGarbage()
+     * @return broken invariant or nullptr
+     */
+    const char* check(const Engine& engine, const Engine::Events& events,
+                      bool garbage) {
+        const Board& board = engine.board();
+
+        for ( int y = 0; y < Board::ROWS; ++y ) {
+            if ( board.row(y) & Board::RowMask(~Board::FULL_ROW) ) {
+                return "finished cell outside the walls";
+            }
+            if ( board.isFull(y) ) {
+                return "full row left on the field";
+            }
+        }
+
+        if ( game_over_ ) {
+            if ( !engine.gameOver() || engine.points() != points_ ||
+                 cellCount(board) != cells_ ) {
+                return "game changed after game over";
+            }
+            return nullptr;
+        }
+
+        if ( !engine.gameOver() ) {
+            const char* piece = checkPiece(engine);
+            if ( piece != nullptr ) return piece;
+        }
+
+        if ( engine.points() < points_ ) {
+            return "points went down";
+        }
+        if ( engine.lines() < lines_ || engine.pieces() < pieces_ ) {
+            return "line or tetromino count went down";
+        }
+        if ( engine.points() != engine.lines() * POINTS_PER_ROW ) {
+            return "points don't match the cleared rows";
+        }
+        if ( events.lines != engine.lines() - lines_ ) {
+            return "reported rows don't match the cleared rows";
+        }
+
+        // A lock adds the four cells of the tetromino and every
+        // cleared row takes a full row away. Garbage pushes cells
+        // over the top, those are not counted. Once the spawn zone
+        // is blocked the game only ends on the next tick, until then
+        // the tetromino may lock on top of finished cells.
+        int cells = cellCount(board);
+        if ( !garbage && !blocked_ ) {
+            int expected = cells_;
+            if ( events.locked ) {
+                expected += 4 - events.lines * Board::COLUMNS;
+            }
+            // Cells locked above the top are lost, that lock
+            // ends the game
+            bool above_top = events.locked && cells < expected &&
+                    cells >= expected - 4 && engine.gameOver();
+            if ( cells != expected && !above_top ) {
+                return "cells appeared or vanished";
+            }
+            if ( events.locked != (engine.pieces() != pieces_) ) {
+                return "lock without a new tetromino";
+            }
+        }
+
+        points_ = engine.points();
+        lines_ = engine.lines();
+        pieces_ = engine.pieces();
+        cells_ = cells;
+        game_over_ = engine.gameOver();
+        blocked_ = Engine::spawnBlocked(board);
+        return nullptr;
+    }
+
+private:
+    static const char* checkPiece(const Engine& engine) {
+        const Tetrominos::Orientation* current = engine.current();
+        if ( current == nullptr ) {
+            return "no active tetromino";
+        }
+
+        // Every translation unit has its own copy of the
+        // tetromino table, compare the contents
+        const Engine::Pose& pose = engine.piece();
+        if ( std::memcmp(current,
+                         &Tetrominos::orientation(engine.currentShape(),
+                                                  pose.rotation),
+                         sizeof(*current)) != 0 ) {
+            return "orientation doesn't match the rotation";
+        }
+
+        int cells = 0;
+        for ( int y = 0; y < 4; ++y ) {
+            for ( int x = 0; x < 4; ++x ) {
+                if ( !Tetrominos::filled(*current, x, y) ) continue;
+                ++cells;
+
+                int fx = pose.x + x;
+                int fy = pose.y + y;
+                if ( fx < 0 || fx >= Board::COLUMNS || fy >= Board::ROWS ) {
+                    return "active tetromino outside the field";
+                }
+                // A tetromino spawned into a blocked spawn zone
+                // overlaps until the next tick ends the game
+                if ( engine.board().occupied(fx, fy) &&
+                     !Engine::spawnBlocked(engine.board()) ) {
+                    return "active tetromino overlaps finished cells";
+                }
+            }
+        }
+
+        return cells == 4 ? nullptr : "active tetromino hasn't four cells";
+    }
+
+    long points_ = 0;
+    long lines_ = 0;
+    long pieces_ = 0;
+    int cells_ = 0;
+    bool game_over_ = false;
+    // Spawn zone blocked, the game ends on the next tick
+    bool blocked_ = false;
+};
+
+// Engine and checker of one run, reused between runs
+struct Runner {
+    Engine engine;
+    Checker checker;
+    long steps = 0;
+
+    /**
+     * @brief run
+     * @param data: fuzz input, see SEED_BYTES
+     * @param size: its length
+     * @return first broken invariant, what is nullptr if none
+     */
+    Failure run(const uint8_t* data, size_t size) {
+        Failure failure;
+        if ( size < SEED_BYTES ) return failure;
+
+        uint32_t seed = 0;
+        for ( size_t i = 0; i < SEED_BYTES; ++i ) {
+            seed |= uint32_t(data[i]) << (8 * i);
+        }
+        engine.reset(seed, POINTS_PER_ROW);
+        checker.start(engine);
+
+        int over = 0;
+        for ( size_t i = SEED_BYTES; i < size; ++i ) {
+            size_t action = i;
+            int input = data[i] & 7;
+            Engine::Events events;
+            if ( input == GARBAGE ) {
+                int lines = ((data[i] >> 3) & 3) + 1;
+                int hole = i + 1 < size ? data[++i] % Board::COLUMNS : 0;
+                events = engine.addGarbage(lines, hole);
+            } else {
+                events = engine.step(input);
+            }
+            ++steps;
+
+            failure.what = checker.check(engine, events, input == GARBAGE);
+            if ( failure.what != nullptr ) {
+                failure.action = action;
+                return failure;
+            }
+            if ( engine.gameOver() && ++over > STEPS_AFTER_GAME_OVER ) {
+                break;
+            }
+        }
+        return failure;
+    }
+
+    Failure run(const std::string& data) {
+        return run(reinterpret_cast< const uint8_t* >(data.data()),
+                   data.size());
+    }
+};
+
+/**
+ * @brief split
+ * @param data: fuzz input
+ * @return its actions, a garbage action keeps its hole byte
+ */
+std::vector< std::string > split(const std::string& data) {
+    std::vector< std::string > actions;
+    for ( size_t i = SEED_BYTES; i < data.size(); ++i ) {
+        size_t length = (data[i] & 7) == GARBAGE && i + 1 < data.size()
+                ? 2 : 1;
+        actions.push_back(data.substr(i, length));
+        i += length - 1;
+    }
+    return actions;
+}
+
+std::string join(const std::string& seed,
+                 const std::vector< std::string >& actions) {
+    std::string data = seed;
+    for ( const std::string& action : actions ) {
+        data += action;
+    }
+    return data;
+}
+
+/**
+ * @brief minimize
+ * @param data: input breaking an invariant
+ * @param what: the invariant
+ * @return shortest input found that breaks the same invariant
+ * Cut everything after the failing action, then delta debugging:
+ * drop ever smaller chunks of actions while the failure stays.
+ */
+std::string minimize(const std::string& data, const char* what) {
+    Runner runner;
+    std::string seed = data.substr(0, SEED_BYTES);
+
+    Failure first = runner.run(data);
+    std::vector< std::string > actions =
+            split(data.substr(0, first.action + 2));
+
+    auto fails = [&](const std::vector< std::string >& candidate) {
+        Failure f = runner.run(join(seed, candidate));
+        return f.what != nullptr && std::strcmp(f.what, what) == 0;
+    };
+
+    size_t chunks = 2;
+    while ( actions.size() >= 2 ) {
+        size_t chunk = (actions.size() + chunks - 1) / chunks;
+        bool reduced = false;
+
+        for ( size_t start = 0; start < actions.size(); start += chunk ) {
+            std::vector< std::string > candidate(actions.begin(),
+                                                 actions.begin() + long(start));
+            candidate.insert(candidate.end(),
+                             actions.begin() + long(std::min(start + chunk,
+                                                             actions.size())),
+                             actions.end());
+            if ( fails(candidate) ) {
+                actions.swap(candidate);
+                chunks = std::max< size_t >(chunks - 1, 2);
+                reduced = true;
+                break;
+            }
+        }
+
+        if ( !reduced ) {
+            if ( chunks >= actions.size() ) break;
+            chunks = std::min(actions.size(), chunks * 2);
+        }
+    }
+
+    return join(seed, actions);
+}
+
+const char* INPUT_NAMES[] = { "tick", "left", "right", "down",
+                              "down_release", "rotate", "drop",
+                              "garbage" };
+
+/**
+ * @brief report
+ * @param data: minimized input
+ * @param out: base name of the files to write
+ * Print the actions and the field where the invariant broke,
+ * save the input and, without garbage, a replay of it
+ */
+void report(const std::string& data, const std::string& out) {
+    Runner runner;
+    Failure failure = runner.run(data);
+    const Engine& engine = runner.engine;
+
+    std::cout << "failure:        " << failure.what << "\n"
+              << "actions:       ";
+    bool garbage = false;
+    for ( const std::string& action : split(data) ) {
+        int input = action[0] & 7;
+        garbage = garbage || input == GARBAGE;
+        std::cout << " " << INPUT_NAMES[input];
+    }
+    std::cout << "\n";
+
+    for ( int y = 0; y < Board::ROWS; ++y ) {
+        std::string row;
+        for ( int x = 0; x < Board::COLUMNS; ++x ) {
+            bool active = false;
+            const Tetrominos::Orientation* current = engine.current();
+            int bx = x - engine.piece().x;
+            int by = y - engine.piece().y;
+            if ( current != nullptr && bx >= 0 && bx < 4 &&
+                 by >= 0 && by < 4 ) {
+                active = Tetrominos::filled(*current, bx, by);
+            }
+            bool taken = engine.board().occupied(x, y);
+            row += active ? (taken ? 'X' : '@') : (taken ? '#' : '.');
+        }
+        std::cout << "  |" << row << "|\n";
+    }
+
+    std::ofstream file(out + ".bin", std::ios_base::binary);
+    file.write(data.data(), std::streamsize(data.size()));
+    std::cout << "input:          " << out << ".bin\n";
+
+    // Replays hold engine inputs only, one per ms
+    if ( !garbage ) {
+        uint32_t seed = 0;
+        for ( size_t i = 0; i < SEED_BYTES; ++i ) {
+            seed |= uint32_t(uint8_t(data[i])) << (8 * i);
+        }
+        Replay replay;
+        Engine engine;
+        replay.begin(seed, POINTS_PER_ROW);
+        engine.reset(seed, POINTS_PER_ROW);
+        long time = 0;
+        for ( const std::string& action : split(data) ) {
+            replay.record(time++, action[0] & 7);
+            engine.step(action[0] & 7);
+        }
+        replay.finish(engine);
+        if ( replay.save(out + ".rpl") ) {
+            std::cout << "replay:         " << out << ".rpl\n";
+        }
+    }
+    std::cout << std::flush;
+}
+
+/**
+ * @brief randomInput
+ * @param rng: generator of the thread
+ * @param length: actions wanted
+ * @return input leaning on gravity and sideways moves like real
+ *         play, so games get deep enough to clear rows
+ */
+std::string randomInput(std::mt19937& rng, size_t length) {
+    // tick left right down down_release rotate drop garbage
+    static const int WEIGHTS[] = { 30, 15, 15, 4, 4, 15, 12, 5 };
+    std::discrete_distribution< int > pick(std::begin(WEIGHTS),
+                                           std::end(WEIGHTS));
+
+    std::string data(SEED_BYTES, '\0');
+    uint32_t seed = uint32_t(rng());
+    for ( size_t i = 0; i < SEED_BYTES; ++i ) {
+        data[i] = char(seed >> (8 * i));
+    }
+    for ( size_t i = 0; i < length; ++i ) {
+        int input = pick(rng);
+        data.push_back(char(input | (rng() & 0xf8)));
+        if ( input == GARBAGE ) {
+            data.push_back(char(rng()));
+        }
+    }
+    return data;
+}
+
+int usage() {
+    std::cerr << "usage: tetris-fuzz [--seconds s] [--threads n] [--seed s]"
+                 " [--out name]\n"
+              << "       tetris-fuzz [--out name] file..." << std::endl;
+    return 1;
+}
+
+/**
+ * @brief runFiles
+ * @param files: fuzz inputs, e.g. a libFuzzer corpus
+ * @param out: base name for a minimized failure
+ * @return process exit code
+ */
+int runFiles(const std::vector< std::string >& files, const std::string& out) {
+    Runner runner;
+    for ( const std::string& name : files ) {
+        std::ifstream file(name, std::ios_base::binary);
+        if ( !file ) {
+            std::cerr << "Error reading " << name << std::endl;
+            return 1;
+        }
+        std::stringstream data;
+        data << file.rdbuf();
+
+        Failure failure = runner.run(data.str());
+        if ( failure.what != nullptr ) {
+            std::cout << "file:           " << name << "\n";
+            report(minimize(data.str(), failure.what), out);
+            return 2;
+        }
+    }
+    std::cout << "files:          " << files.size() << "\n"
+              << "steps:          " << runner.steps << "\n"
+              << "failures:       0" << std::endl;
+    return 0;
+}
+
+/**
+ * @brief runRandom
+ * @return process exit code
+ * Random inputs on every thread until time is up or
+ * an invariant breaks
+ */
+int runRandom(double seconds, int threads, unsigned seed,
+              const std::string& out) {
+    if ( threads <= 0 ) {
+        threads = int(std::max(1u, std::thread::hardware_concurrency()));
+    }
+
+    std::atomic< bool > stop(false);
+    std::atomic< long > steps(0);
+    std::atomic< long > runs(0);
+    std::mutex found_mutex;
+    std::string found;
+    const char* what = nullptr;
+
+    auto start = std::chrono::steady_clock::now();
+    auto end = start + std::chrono::duration_cast<
+            std::chrono::steady_clock::duration >(
+                std::chrono::duration< double >(seconds));
+
+    std::vector< std::thread > workers;
+    for ( int t = 0; t < threads; ++t ) {
+        workers.emplace_back([&, t]() {
+            std::mt19937 rng(seed + unsigned(t) * 7919u);
+            Runner runner;
+            long count = 0;
+            while ( !stop ) {
+                std::string data = randomInput(rng, 256);
+                Failure failure = runner.run(data);
+                ++count;
+                if ( failure.what != nullptr ) {
+                    std::lock_guard< std::mutex > lock(found_mutex);
+                    if ( what == nullptr ) {
+                        what = failure.what;
+                        found = data;
+                    }
+                    stop = true;
+                }
+                // The clock is slower than a run
+                if ( count % 64 == 0 &&
+                     std::chrono::steady_clock::now() >= end ) {
+                    stop = true;
+                }
+            }
+            steps += runner.steps;
+            runs += count;
+        });
+    }
+    for ( std::thread& worker : workers ) {
+        worker.join();
+    }
+
+    std::chrono::duration< double > elapsed =
+            std::chrono::steady_clock::now() - start;
+    double s = elapsed.count();
+    std::cout << "threads:        " << threads << "\n"
+              << "runs:           " << runs << "\n"
+              << "steps:          " << steps << "\n"
+              << "seconds:        " << s << "\n"
+              << "steps/second:   " << steps / s << "\n";
+
+    if ( what != nullptr ) {
+        report(minimize(found, what), out);
+        return 2;
+    }
+    std::cout << "failures:       0" << std::endl;
+    return 0;
+}
+
+}
+
+#ifdef TETRIS_LIBFUZZER
+
+// Built with -fsanitize=fuzzer, libFuzzer provides main()
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    static Runner runner;
+    Failure failure = runner.run(data, size);
+    if ( failure.what != nullptr ) {
+        std::cerr << "invariant broken at byte " << failure.action << ": "
+                  << failure.what << std::endl;
+        std::abort();
+    }
+    return 0;
+}
+
+#else
+
+int main(int argc, char* argv[]) {
+    double seconds = 10;
+    int threads = 0;
+    unsigned seed = 1;
+    std::string out = "fuzz-failure";
+    std::vector< std::string > files;
+
+    for ( int i = 1; i < argc; ++i ) {
+        std::string arg = argv[i];
+
+        if ( arg == "--seconds" && i + 1 < argc ) {
+            seconds = std::atof(argv[++i]);
+        } else if ( arg == "--threads" && i + 1 < argc ) {
+            threads = std::atoi(argv[++i]);
+        } else if ( arg == "--seed" && i + 1 < argc ) {
+            seed = unsigned(std::atol(argv[++i]));
+        } else if ( arg == "--out" && i + 1 < argc ) {
+            out = argv[++i];
+        } else if ( arg.compare(0, 2, "--") == 0 ) {
+            return usage();
+        } else {
+            files.push_back(arg);
+        }
+    }
+
+    if ( seconds <= 0 || threads < 0 ) {
+        return usage();
+    }
+    if ( !files.empty() ) {
+        return runFiles(files, out);
+    }
+    return runRandom(seconds, threads, seed, out);
+}
+
+#endif
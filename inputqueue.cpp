@@ -0,0 +1,126 @@
+/*
+ * Tetris -game
+ * Timestamped key presses and releases turned
+ * into engine inputs, with delayed auto shift
+ * and auto repeat evaluated at exact times
+ *
+ * Timi Rautamäki, 284032
+ *
+ */
+
+#include "inputqueue.hh"
+#include <limits>
+
+namespace {
+
+const long NEVER = std::numeric_limits< long >::max();
+
+}
+
+void InputQueue::setAutoRepeat(int das_ms, int arr_ms) {
+    das_ms_ = das_ms < 0 ? 0 : das_ms;
+    arr_ms_ = arr_ms < 0 ? 0 : arr_ms;
+}
+
+void InputQueue::press(int input, long time_ms) {
+    if ( time_ms < last_time_ ) time_ms = last_time_;
+    last_time_ = time_ms;
+
+    events_.push_back({ time_ms, input, true });
+}
+
+void InputQueue::release(int input, long time_ms) {
+    if ( time_ms < last_time_ ) time_ms = last_time_;
+    last_time_ = time_ms;
+
+    events_.push_back({ time_ms, input, false });
+}
+
+void InputQueue::clear() {
+    events_.clear();
+    last_time_ = 0;
+    left_held_ = false;
+    right_held_ = false;
+    down_held_ = false;
+    repeating_ = -1;
+}
+
+void InputQueue::releaseAll(long time_ms, const Step& step) {
+    bool down_held = down_held_;
+    clear();
+
+    if ( down_held ) {
+        step(time_ms, Engine::DOWN_RELEASE);
+    }
+}
+
+void InputQueue::advance(long until_ms, const Step& step) {
+    for ( ;; ) {
+        long event_time = events_.empty() ? NEVER : events_.front().time_ms;
+        long repeat_time = repeating_ < 0 ? NEVER : next_repeat_;
+
+        if ( event_time > until_ms && repeat_time > until_ms ) {
+            return;
+        }
+
+        // A repeat that is due goes before an event at the same time
+        if ( repeat_time <= event_time ) {
+            shift(repeat_time, step);
+
+            // With ARR 0 the first repeat already hit the wall
+            next_repeat_ = arr_ms_ > 0 ? repeat_time + arr_ms_ : NEVER;
+            continue;
+        }
+
+        KeyEvent event = events_.front();
+        events_.pop_front();
+        handle(event, step);
+    }
+}
+
+void InputQueue::handle(const KeyEvent& event, const Step& step) {
+    switch ( event.input ) {
+    case Engine::LEFT:
+    case Engine::RIGHT:
+        (event.input == Engine::LEFT ? left_held_ : right_held_) =
+                event.pressed;
+
+        if ( event.pressed ) {
+            // The first move is immediate, repeats start after DAS
+            repeating_ = event.input;
+            step(event.time_ms, event.input);
+            next_repeat_ = event.time_ms + das_ms_;
+        } else if ( repeating_ == event.input ) {
+            // Fall back to the other direction if it is still held
+            int other = event.input == Engine::LEFT ? Engine::RIGHT
+                                                    : Engine::LEFT;
+            bool other_held = other == Engine::LEFT ? left_held_
+                                                    : right_held_;
+            repeating_ = other_held ? other : -1;
+            next_repeat_ = event.time_ms + das_ms_;
+        }
+        break;
+    case Engine::DOWN:
+        down_held_ = event.pressed;
+        step(event.time_ms, event.pressed ? Engine::DOWN
+                                          : Engine::DOWN_RELEASE);
+        break;
+    case Engine::ROTATE:
+    case Engine::DROP:
+        if ( event.pressed ) {
+            step(event.time_ms, event.input);
+        }
+        break;
+    }
+}
+
+void InputQueue::shift(long time_ms, const Step& step) {
+    if ( arr_ms_ > 0 ) {
+        step(time_ms, repeating_);
+        return;
+    }
+
+    for ( int i = 0; i < Engine::COLUMNS; ++i ) {
+        if ( !step(time_ms, repeating_).moved ) break;
+    }
+}
@@ -0,0 +1,106 @@
+/*
+ * Tetris -game
+ * Timestamped key presses and releases turned
+ * into engine inputs, with delayed auto shift
+ * and auto repeat evaluated at exact times
+ *
+ * Timi Rautamäki, 284032
+ *
+ */
+
+#ifndef INPUTQUEUE_HH
+#define INPUTQUEUE_HH
+
+#include "engine.hh"
+#include <deque>
+#include <functional>
+
+class InputQueue {
+public:
+    // Feeds one input to the engine at the given game time
+    using Step = std::function< Engine::Events(long time_ms, int input) >;
+
+    /**
+     * @brief setAutoRepeat
+     * @param das_ms: delay from pressing left or right to the
+     *        first repeat
+     * @param arr_ms: time between repeats, 0 moves straight
+     *        to the wall
+     */
+    void setAutoRepeat(int das_ms, int arr_ms);
+
+    /**
+     * @brief press
+     * @param input: LEFT, RIGHT, DOWN, ROTATE or DROP
+     * @param time_ms: game time of the press
+     */
+    void press(int input, long time_ms);
+    /**
+     * @brief release
+     * @param input: LEFT, RIGHT or DOWN
+     * @param time_ms: game time of the release
+     */
+    void release(int input, long time_ms);
+    /**
+     * @brief clear
+     * Drop queued events and let go of held keys. Game
+     * time may start over from zero after this.
+     */
+    void clear();
+    /**
+     * @brief releaseAll
+     * @param time_ms: game time of the release
+     * @param step: receives the inputs
+     * Like clear(), but a soft drop the engine was given
+     * is released in it too
+     */
+    void releaseAll(long time_ms, const Step& step);
+
+    /**
+     * @brief advance
+     * @param until_ms: game time to process up to
+     * @param step: receives the inputs in time order
+     * Handle the queued events and the auto repeats due
+     * by 'until_ms'. Call before every gravity step with
+     * its time so inputs and gravity interleave exactly.
+     */
+    void advance(long until_ms, const Step& step);
+
+private:
+    struct KeyEvent {
+        long time_ms;
+        int input;
+        bool pressed;
+    };
+
+    /**
+     * @brief handle
+     * @param event: event to act on
+     * @param step: receives the inputs
+     */
+    void handle(const KeyEvent& event, const Step& step);
+    /**
+     * @brief shift
+     * @param time_ms: time of the move
+     * @param step: receives the inputs
+     * Move the held direction once, or to the wall with ARR 0
+     */
+    void shift(long time_ms, const Step& step);
+
+    std::deque< KeyEvent > events_;
+    // Events never go back in time
+    long last_time_ = 0;
+
+    bool left_held_ = false;
+    bool right_held_ = false;
+    // DOWN was stepped and not released yet
+    bool down_held_ = false;
+    // Direction being repeated, the latest pressed wins
+    int repeating_ = -1;
+    long next_repeat_ = 0;
+
+    int das_ms_ = 167;
+    int arr_ms_ = 33;
+};
+
+#endif // INPUTQUEUE_HH
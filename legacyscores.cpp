@@ -0,0 +1,192 @@
+/*
+ * Tetris -game
+ * Reader for the old colon separated
+ * scoreboard file, name:min:s:points
+ *
+ * Timi Rautamäki, 284032
+ *
+ */
+
+#include "legacyscores.hh"
+#include <charconv>
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// Read only mapping of a whole file, empty if mapping fails
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& filename);
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool isOpen() const { return open_; }
+    std::string_view data() const { return { data_, size_ }; }
+
+private:
+    bool open_ = false;
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+#ifdef _WIN32
+    HANDLE file_ = INVALID_HANDLE_VALUE;
+    HANDLE mapping_ = nullptr;
+#endif
+};
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const std::string& filename) {
+    file_ = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                        nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN,
+                        nullptr);
+    if ( file_ == INVALID_HANDLE_VALUE ) return;
+
+    LARGE_INTEGER size;
+    if ( !GetFileSizeEx(file_, &size) ) return;
+    open_ = true;
+    if ( size.QuadPart == 0 ) return;
+
+    mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if ( mapping_ == nullptr ) {
+        open_ = false;
+        return;
+    }
+
+    data_ = static_cast< const char* >(
+                MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+    if ( data_ == nullptr ) {
+        open_ = false;
+        return;
+    }
+    size_ = size_t(size.QuadPart);
+}
+
+MappedFile::~MappedFile() {
+    if ( data_ != nullptr ) UnmapViewOfFile(data_);
+    if ( mapping_ != nullptr ) CloseHandle(mapping_);
+    if ( file_ != INVALID_HANDLE_VALUE ) CloseHandle(file_);
+}
+
+#else
+
+MappedFile::MappedFile(const std::string& filename) {
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if ( fd < 0 ) return;
+
+    struct stat info;
+    if ( fstat(fd, &info) == 0 ) {
+        open_ = true;
+        size_ = size_t(info.st_size);
+    }
+
+    if ( open_ && size_ > 0 ) {
+        void* p = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if ( p == MAP_FAILED ) {
+            open_ = false;
+            size_ = 0;
+        } else {
+            madvise(p, size_, MADV_SEQUENTIAL);
+            data_ = static_cast< const char* >(p);
+        }
+    }
+
+    // The mapping stays valid after the descriptor is closed
+    ::close(fd);
+}
+
+MappedFile::~MappedFile() {
+    if ( data_ != nullptr ) {
+        munmap(const_cast< char* >(data_), size_);
+    }
+}
+
+#endif
+
+bool parseNumber(std::string_view text, int& value) {
+    const char* end = text.data() + text.size();
+    std::from_chars_result result = std::from_chars(text.data(), end, value);
+
+    return !text.empty() && result.ec == std::errc() &&
+           result.ptr == end && value >= 0;
+}
+
+}
+
+bool LegacyScores::parseLine(std::string_view line, ScoreStore::Score& score) {
+    size_t third = line.rfind(':');
+    if ( third == std::string_view::npos || third == 0 ) return false;
+    size_t second = line.rfind(':', third - 1);
+    if ( second == std::string_view::npos || second == 0 ) return false;
+    size_t first = line.rfind(':', second - 1);
+    if ( first == std::string_view::npos ) return false;
+
+    int minutes = 0;
+    int seconds = 0;
+    if ( !parseNumber(line.substr(first + 1, second - first - 1), minutes) ||
+         !parseNumber(line.substr(second + 1, third - second - 1), seconds) ||
+         !parseNumber(line.substr(third + 1), score.points) ) {
+        return false;
+    }
+
+    score.name.assign(line.data(), first);
+    score.seconds = minutes * 60 + seconds;
+    score.difficulty = ScoreStore::UNKNOWN_DIFFICULTY;
+    return true;
+}
+
+long LegacyScores::read(const std::string& filename, const Batch& batch,
+                        long* malformed) {
+    MappedFile file(filename);
+    if ( !file.isOpen() ) {
+        return -1;
+    }
+
+    std::string_view data = file.data();
+    std::vector< ScoreStore::Score > scores;
+    scores.reserve(BATCH_SIZE);
+
+    long count = 0;
+    long skipped = 0;
+    ScoreStore::Score score = { std::string(), 0, 0, 0, 0 };
+
+    while ( !data.empty() ) {
+        size_t end = data.find('\n');
+        std::string_view line = data.substr(0, end);
+        data.remove_prefix(end == std::string_view::npos ? data.size()
+                                                         : end + 1);
+
+        if ( !line.empty() && line.back() == '\r' ) line.remove_suffix(1);
+        if ( line.empty() ) continue;
+
+        if ( !parseLine(line, score) ) {
+            ++skipped;
+            continue;
+        }
+
+        // Ids follow the file order, older scores win ties
+        score.id = uint32_t(count++);
+        scores.push_back(score);
+
+        if ( scores.size() == BATCH_SIZE ) {
+            if ( !batch(scores) ) break;
+            scores.clear();
+        }
+    }
+
+    if ( !scores.empty() ) {
+        batch(scores);
+    }
+
+    if ( malformed != nullptr ) *malformed = skipped;
+    return count;
+}
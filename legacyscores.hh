@@ -0,0 +1,52 @@
+/*
+ * Tetris -game
+ * Reader for the old colon separated
+ * scoreboard file, name:min:s:points
+ *
+ * Timi Rautamäki, 284032
+ *
+ */
+
+#ifndef LEGACYSCORES_HH
+#define LEGACYSCORES_HH
+
+#include "scorestore.hh"
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace LegacyScores {
+
+// Receives the scores in file order a batch at a time,
+// returning false stops the reading
+using Batch = std::function< bool(const std::vector< ScoreStore::Score >&) >;
+
+// Scores handed over per call of a Batch
+const size_t BATCH_SIZE = 4096;
+
+/**
+ * @brief parseLine
+ * @param line: one line without the line feed
+ * @param score: filled on success, difficulty is unknown
+ * @return false if the line is malformed
+ * The name may contain colons, the last three fields
+ * are the numbers
+ */
+bool parseLine(std::string_view line, ScoreStore::Score& score);
+
+/**
+ * @brief read
+ * @param filename: scoreboard file
+ * @param batch: receives the scores
+ * @param malformed: filled with the number of skipped lines
+ * @return number of scores read, -1 if the file can't be read
+ * The file is memory mapped and tokenized in place,
+ * nothing but the names is copied
+ */
+long read(const std::string& filename, const Batch& batch,
+          long* malformed = nullptr);
+
+}
+
+#endif // LEGACYSCORES_HH
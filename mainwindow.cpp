@@ -10,14 +10,21 @@
 #include "mainwindow.hh"
 #include "ui_mainwindow.h"
 #include "scoreboard.hh"
-#include <fstream>
+#include "versuswindow.hh"
+#include <algorithm>
+#include <cstring>
 #include <iostream>
 #include <QColor>
+#include <QCoreApplication>
+#include <QFont>
 #include <QKeyEvent>
 #include <QGraphicsRectItem>
 #include <QMessageBox>
 #include <QTimer>
 #include <QDebug>
+#include <QDir>
+#include <QGuiApplication>
+#include <QScreen>
 
 MainWindow::MainWindow(QWidget *parent) :
     QMainWindow(parent),
@@ -43,12 +50,6 @@ MainWindow::MainWindow(QWidget *parent) :
 
     scene_->setSceneRect(0, 0, BORDER_RIGHT - 1, BORDER_DOWN - 1);
 
-    // Setting random engine ready for the first real call.
-    int seed = time(0); // You can change seed value for testing purposes
-    randomEng.seed(seed);
-    distr = std::uniform_int_distribution<int>(0, NUMBER_OF_TETROMINOS - 1);
-    distr(randomEng);
-
     connect(ui->pauseButton, &QPushButton::clicked,
             this, &MainWindow::pauseGame);
 
@@ -66,30 +67,106 @@ MainWindow::MainWindow(QWidget *parent) :
 
     // Set selected default difficulty
     switch (difficulty_) {
-    case EASY:
+    case Engine::EASY:
         ui->easyRadio->setChecked(true);
         break;
-    case MEDIUM:
+    case Engine::MEDIUM:
         ui->mediumRadio->setChecked(true);
         break;
-    case INSANE:
+    case Engine::INSANE:
         ui->insaneRadio->setChecked(true);
         break;
     }
 
+    // Only the writer thread touches the store. Scores of the text
+    // scoreboard move into it on first run, big files take a while.
+    // An import that fails is tried again on the next start.
+    writer_.start([this](ScoreStore& store) {
+        if ( !store.open() ) {
+            qDebug() << "Error opening leaderboard";
+            return;
+        }
+        if ( store.imported() ) return;
+
+        long malformed = 0;
+        long imported = store.importLegacy(FILENAME, &malformed);
+        if ( imported < 0 ) {
+            qDebug() << "Error importing the old scoreboard";
+        }
+        Trace::record< Trace::STORE >(Trace::IMPORT, imported, malformed);
+    });
+
+    if ( !Trace::installCrashHandler(CRASH_TRACE_FILE) ) {
+        qDebug() << "Crash traces are not supported";
+    }
+
+    QByteArray spectate = qgetenv(SPECTATOR_ENV);
+    std::string target = spectate.isEmpty() ? SPECTATOR_STREAM
+                                            : spectate.toStdString();
+    if ( !target.empty() && !spectators_.open(target) ) {
+        qDebug() << "Error opening spectator stream"
+                 << QString::fromStdString(target);
+    }
+
     timer_.setSingleShot(false);
+    timer_.setTimerType(Qt::PreciseTimer);
     connect(&timer_, &QTimer::timeout, this, &MainWindow::gameloop);
 
     drawGrid();
+
+    // Squares of the active tetromino are created once
+    // and only moved around after that
+    QPen blackPen(Qt::black);
+    blackPen.setWidth(2);
+
+    for ( int i = 0; i < 4; ++i ) {
+        QGraphicsRectItem* square =
+                scene_->addRect(0, 0, SQUARE_SIDE, SQUARE_SIDE, blackPen);
+        square->setZValue(1);
+        square->setVisible(false);
+        active_graphics_.push_back(square);
+        active_cells_.push_back({ 0, 0 });
+
+        // Ghost shows where the active tetromino would land
+        QGraphicsRectItem* ghost =
+                scene_->addRect(0, 0, SQUARE_SIDE, SQUARE_SIDE,
+                                QPen(Qt::gray));
+        ghost->setVisible(false);
+        ghost_graphics_.push_back(ghost);
+        ghost_cells_.push_back({ 0, 0 });
+    }
+
+    // Timing overlay in the top left corner of the field
+    QFont font("Monospace", 7);
+    font.setStyleHint(QFont::TypeWriter);
+    stats_item_ = scene_->addSimpleText("", font);
+    stats_item_->setBrush(QBrush(Qt::darkGray));
+    stats_item_->setZValue(2);
+    stats_item_->setVisible(false);
+
+    stats_timer_.start();
+    ui->graphicsView->viewport()->installEventFilter(this);
+
+    if ( !snapshot_.open() ) {
+        qDebug() << "Snapshots are not supported";
+    } else {
+        resume();
+    }
 }
 
 MainWindow::~MainWindow() {
+    if ( !writer_.flush() ) {
+        qDebug() << "Error saving scores";
+    }
+    if ( !stats_.writeCsv(STATS_FILE) ) {
+        qDebug() << "Error saving frame times";
+    }
     delete clock_;
     delete ui;
 }
 
 void MainWindow::updateUI() {
-    ui->pointsLabel->setText(QString::number(points_));
+    ui->pointsLabel->setText(QString::number(engine_.points()));
 }
 
 void MainWindow::updateTime() {
@@ -98,10 +175,11 @@ void MainWindow::updateTime() {
     // Decrease interval by DIFFICULTY_STEP
     // every DIFFICULTY_INTERVAL seconds to
     // increase difficulty
-    if ( seconds_ % DIFFICULTY_INTERVAL == 0 && difficulty_ > MAX_DIFFICULTY ) {
-        difficulty_ -= DIFFICULTY_STEP;
-        timer_.setInterval(difficulty_);
-        if ( DEBUG ) qDebug() << "Change speed to " << difficulty_;
+    if ( seconds_ % Engine::DIFFICULTY_INTERVAL == 0 &&
+         difficulty_ > Engine::MAX_DIFFICULTY ) {
+        difficulty_ -= Engine::DIFFICULTY_STEP;
+        Trace::record< Trace::TIMING >(Trace::SPEED, difficulty_,
+                                       minutes_ * 60 + seconds_);
     }
 
     if ( seconds_ == 60 ) {
@@ -114,52 +192,87 @@ void MainWindow::updateTime() {
 }
 
 void MainWindow::pauseGame() {
-    qDebug() << timer_.interval();
+    if ( !pause_ ) {
+        // Keys held over the pause would repeat for all of it,
+        // a held soft drop is let go of in the engine too
+        inputs_.releaseAll(keyTime(), [this](long time, int input) {
+            return this->input(input, time);
+        });
+    }
+
     pause_ = !pause_;
+    Trace::record< Trace::GAME >(Trace::PAUSE, pause_);
     if ( pause_ ) {
         clock_->stop();
     } else {
         clock_->start();
+        // Its keys were let go of at the pause, e.g. of a resumed game
+        playAi();
     }
     ui->pauseButton->setText(pause_ ? "Resume" : "Pause");
 }
 
 void MainWindow::keyPressEvent(QKeyEvent* event) {
 
-    if ( current_ == nullptr ) return;
-
-    if ( event->key() == KEY_DOWN ) {
-        fast_ = true;
-        moveBlock(DOWN);
+    if ( event->key() == KEY_STATS && !event->isAutoRepeat() ) {
+        show_stats_ = !show_stats_;
+        stats_item_->setVisible(show_stats_);
+        stats_shown_ = 0;
+        showStats();
+        return;
     }
 
-    if ( event->key() == KEY_LEFT ) {
-        moveBlock(LEFT);
+    if ( event->key() == KEY_TRACE && !event->isAutoRepeat() ) {
+        if ( !Trace::dump(TRACE_FILE) ) {
+            qDebug() << "Error saving trace";
+        }
+        return;
     }
 
-    if ( event->key() == KEY_RIGHT ) {
-        moveBlock(RIGHT);
-    }
+    if ( engine_.current() == nullptr ) return;
+    if ( pause_ ) return;
 
-    if ( event->key() == KEY_ROTATE ) {
-        rotateTetromino();
-        draw();
+    // Held keys repeat on game time, not on the desktop's settings
+    if ( event->isAutoRepeat() ) return;
+
+    int input = keyInput(event->key());
+    if ( input >= 0 ) {
+        inputs_.press(input, keyTime());
     }
 
-    if ( event->key() == KEY_DROP ) {
-        moveToBottom();
+    if ( event->key() == KEY_AI ) {
+        ai_ = !ai_;
+        playAi();
     }
 }
 
 void MainWindow::keyReleaseEvent(QKeyEvent* event) {
-    if ( event->key() == Qt::Key_Down || event->key() == Qt::Key_S ) {
-        fast_ = false;
+    if ( engine_.current() == nullptr ) return;
+    if ( event->isAutoRepeat() ) return;
+
+    int input = keyInput(event->key());
+    if ( input >= 0 ) {
+        inputs_.release(input, keyTime());
     }
 }
 
-void MainWindow::draw() {
-    if ( field_.empty() ) return;
+int MainWindow::keyInput(int key) const {
+    if ( key == KEY_DOWN ) return Engine::DOWN;
+    if ( key == KEY_LEFT ) return Engine::LEFT;
+    if ( key == KEY_RIGHT ) return Engine::RIGHT;
+    if ( key == KEY_ROTATE ) return Engine::ROTATE;
+    if ( key == KEY_DROP ) return Engine::DROP;
+
+    return -1;
+}
+
+qint64 MainWindow::keyTime() const {
+    // Keys pressed while an input is applied, i.e. by the
+    // computer player, happen at the time of that input
+    return input_time_ >= 0 ? input_time_ : game_time_.elapsed();
+}
 
+void MainWindow::draw() {
     QPen blackPen(Qt::black);
     blackPen.setWidth(2);
 
@@ -170,513 +283,336 @@ void MainWindow::draw() {
 
     graphics_.clear();
 
-    // Draw the field
-    for ( int x = 0; x < COLUMNS; ++x ) {
-        for ( int y = 0; y < ROWS; ++y ) {
-            if ( field_.at(x).at(y) == 0 ) {
-                // Skip empty spots
-                continue;
-            } else if ( field_.at(x).at(y) == 1 ) {
-                // Draw the active tetromino
-                QGraphicsRectItem* square =
-                        scene_->addRect(x*SQUARE_SIDE,
-                                        y*SQUARE_SIDE,
-                                        SQUARE_SIDE,
-                                        SQUARE_SIDE,
-                                        blackPen,
-                                        colours_.at(current_shape_));
-
-                graphics_.push_back(square);
-            } else if ( field_.at(x).at(y) >= 2 ) {
-                // Draw the stable tetrominos
-                QGraphicsRectItem* square =
-                        scene_->addRect(x*SQUARE_SIDE,
-                                        y*SQUARE_SIDE,
-                                        SQUARE_SIDE,
-                                        SQUARE_SIDE,
-                                        blackPen,
-                                        colours_.at(field_.at(x).at(y) - 2));
-
-                graphics_.push_back(square);
-            }
-        }
-    }
-}
-
-void MainWindow::drawNext() {
-    QPen blackPen(Qt::black);
-    blackPen.setWidth(2);
-
-    next_scene_->clear();
-
-    std::vector< std::vector< int > >* shape = &types_.at(next_shape_);
-
-    for ( int x = 0; x < 4; ++x ) {
-        for ( int y = 0; y < 4; ++y ) {
-            if ( shape->at(x).at(y) != 1 ) continue;
-            next_scene_->addRect(x*SQUARE_SIDE, y*SQUARE_SIDE,
-                                 SQUARE_SIDE, SQUARE_SIDE,
-                                 blackPen, colours_.at(next_shape_));
-        }
-    }
-}
-
-// Helper to check if all values are false in vector< bool >
-bool allTrue(std::vector< bool >& vec) {
-    for ( bool b : vec ) {
-        if ( !b ) {
-            return false;
-        }
-    }
-    return true;
-}
+    const Board& field = engine_.board();
 
-bool MainWindow::allClearBelow(int col) {
+    // Draw the stable tetrominos
     for ( int y = 0; y < ROWS; ++y ) {
-        if ( field_.at(col).at(y) > 1 ) {
-            return false;
+        // Skip empty rows
+        if ( field.row(y) == 0 ) continue;
+
+        for ( int x = 0; x < COLUMNS; ++x ) {
+            int colour = field.colour(x, y);
+            if ( colour == Board::EMPTY ) continue;
+
+            QGraphicsRectItem* square =
+                    scene_->addRect(x*SQUARE_SIDE,
+                                    y*SQUARE_SIDE,
+                                    SQUARE_SIDE,
+                                    SQUARE_SIDE,
+                                    blackPen,
+                                    colours_.at(colour));
+
+            graphics_.push_back(square);
         }
     }
-
-    return true;
 }
 
-void MainWindow::moveToBottom() {
-    if ( pause_ ) return;
-
-    bool all_the_way = false;
-    int delta_y = 0;
+void MainWindow::drawPiece() {
+    const Engine::Pose& piece = engine_.piece();
+    int drop = engine_.dropDistance();
 
-    std::vector< int > piece_delta_y;
-    std::vector< bool > piece_to_bottom(4, false);
-    std::vector< int > piece_to_bottom_y(4, ROWS + 1);
+    moveSquares(ghost_graphics_, ghost_cells_, piece.x, piece.y + drop);
+    moveSquares(active_graphics_, active_cells_, piece.x, piece.y);
+}
 
+void MainWindow::moveSquares(std::vector< QGraphicsRectItem* >& squares,
+                             std::vector< tetromino_pos >& cells,
+                             int x, int y) {
+    const Tetrominos::Orientation* current = engine_.current();
     int i = 0;
-    for ( int px = 0; px < 4; ++px ) {
-        for ( int py = 0; py < 4; ++py ) {
-            if ( current_->at(px).at(py) != 1 ) continue;
-
-            // Check if all pieces can go directly to floor
-            if ( allClearBelow(position_.at(px).at(py).x) ) {
-                piece_to_bottom_y.at(i) = ROWS - position_.at(px).at(py).y - 1;
-                piece_to_bottom.at(i) = true;
-            }
 
-            // No need to continue loop if all
-            // can go to the floor
-            all_the_way = allTrue(piece_to_bottom);
-            if ( all_the_way ) {
-                break;
-            }
-
-            // Calculate the possible delta y for each piece
-            int j = 0;
-            for ( int x = 0; x < COLUMNS; ++x ) {
-                for ( int y = 0; y < ROWS; ++y ) {
-                    if ( x == position_.at(px).at(py).x &&
-                         field_.at(x).at(y) > 1 ) {
-
-                        int candidate_y = y - position_.at(px).at(py).y - 1;
-                        piece_delta_y.push_back(candidate_y);
-                    }
+    if ( current != nullptr ) {
+        for ( int py = 0; py < 4; ++py ) {
+            for ( int px = 0; px < 4; ++px ) {
+                if ( !Tetrominos::filled(*current, px, py) ) continue;
+
+                tetromino_pos cell = { x + px, y + py };
+                QGraphicsRectItem* square = squares.at(i);
+
+                // Only touch the squares that actually moved
+                if ( cell.x != cells.at(i).x ||
+                     cell.y != cells.at(i).y ||
+                     !square->isVisible() ) {
+
+                    square->setRect(cell.x*SQUARE_SIDE,
+                                    cell.y*SQUARE_SIDE,
+                                    SQUARE_SIDE,
+                                    SQUARE_SIDE);
+                    square->setVisible(true);
+                    cells.at(i) = cell;
                 }
-                ++j;
+                ++i;
             }
-            ++i;
         }
     }
 
-    // Choose the smallest delta y from all pieces
-    // to only move as little as possible
-    delta_y = all_the_way ? *std::min_element(piece_to_bottom_y.begin(),
-                                              piece_to_bottom_y.end())
-                          : *std::min_element(piece_delta_y.begin(),
-                                              piece_delta_y.end());
-
-    for( int i = 0; i < 4; i++ ) {
-        for( int j = 0; j < 4; j++ ) {
-            setAbsolutePosition(i, j, position_.at(i).at(j).x,
-                                      position_.at(i).at(j).y + delta_y);
-        }
+    for ( ; i < 4; ++i ) {
+        squares.at(i)->setVisible(false);
     }
 }
 
-void MainWindow::rotateTetromino() {
-    if ( current_ == nullptr || current_shape_ == SQUARE ) return;
-    if ( pause_ ) return;
-
-    // Copy the current tetromino to a temporary variable
-    std::vector< std::vector< int > >* temp =
-            new std::vector< std::vector< int > >;
-    *temp = *current_;
+void MainWindow::drawNext() {
+    QPen blackPen(Qt::black);
+    blackPen.setWidth(2);
 
-    // Rotation algorithm
-    for( int i = 0; i < 4; i++ ) {
-        for( int j = 0; j < 4; j++ ) {
-            temp->at(j).at(4 - i - 1) = current_->at(i).at(j);
-        }
-    }
+    next_scene_->clear();
 
-    // Move to right/left if wall is in way
-    int r = 0;
-    int l = 0;
-    for( int i = 0; i < 4; i++ ) {
-        for( int j = 0; j < 4; j++ ) {
-            if ( temp->at(i).at(j) != 1 ) continue;
+    int next_shape = engine_.nextShape();
+    const Tetrominos::Orientation& shape =
+            Tetrominos::orientation(next_shape, 0);
 
-            if ( position_.at(i).at(j).x < 0 ) {
-                r++;
-                if ( checkSpace(RIGHT, r) != 0 ) {
-                    delete temp;
-                    return;
-                }
-            } else if ( position_.at(i).at(j).x > COLUMNS - 1 ) {
-                l++;
-                if ( checkSpace(LEFT, l) != 0 ) {
-                    delete temp;
-                    return;
-                }
-            } else if ( position_.at(i).at(j).y < 0 ||
-                        position_.at(i).at(j).y >= ROWS ||
-                        field_.at(position_.at(i).at(j).x)
-                              .at(position_.at(i).at(j).y) > 1) {
-
-                // Real block, ceiling or floor in the way. Do nothing
-                delete temp;
-                return;
-            }
+    for ( int x = 0; x < 4; ++x ) {
+        for ( int y = 0; y < 4; ++y ) {
+            if ( !Tetrominos::filled(shape, x, y) ) continue;
+            next_scene_->addRect(x*SQUARE_SIDE, y*SQUARE_SIDE,
+                                 SQUARE_SIDE, SQUARE_SIDE,
+                                 blackPen, colours_.at(next_shape));
         }
     }
+}
 
-    // Move tetrommino if needed
-    for ( int i = 0; i < r; ++i ) {
-        moveBlock(RIGHT);
+Engine::Events MainWindow::input(int input, qint64 time) {
+    Trace::record< Trace::INPUT >(Trace::STEP, input, int32_t(time));
+    if ( RECORD_REPLAYS ) {
+        replay_.record(time, input);
     }
 
-    for ( int i = 0; i < l; ++i ) {
-        moveBlock(LEFT);
-    }
+    Engine::Events events = engine_.step(input);
 
-    current_ = temp;
+    input_time_ = time;
+    applyEvents(events);
+    input_time_ = -1;
 
-    // Reset tetromino position and redraw
-    for ( int px = 0; px < 4; ++px ) {
-        for ( int py = 0; py < 4; ++py ) {
-            setAbsolutePosition(px, py, position_.at(px).at(py).x,
-                                        position_.at(px).at(py).y);
-        }
-    }
+    return events;
 }
 
-void MainWindow::clearRow(int row) {
-    if ( DEBUG ) qDebug() << "Clearing row " << row;
-
-    // Clear the row
-    for ( int x = 0; x < COLUMNS; ++x ) {
-        if ( field_.at(x).at(row) < 2 ) {
-            field_.at(x).at(row) = 0;
-        }
+void MainWindow::applyEvents(const Engine::Events& events) {
+    if ( events.game_over ) {
+        gameOver();
+        return;
     }
 
-    // Move rows above 'row' 1 step down
-    for ( int x = 0; x < COLUMNS; ++x ) {
-        for ( int y = ROWS; y > 0; --y ) {
-            if ( y < row && y > 1 ) {
-                field_.at(x).at(y+1) = field_.at(x).at(y);
-                field_.at(x).at(y) = 0;
-            }
+    if ( events.locked ) {
+        if ( events.lines > 0 ) {
+            score_dirty_ = true;
+            emit linesCleared(events.lines);
         }
-    }
 
-    points_ += points_per_row_;
-    updateUI();
-}
+        // Finished cells only change here
+        board_dirty_ = true;
+    }
 
-bool MainWindow::checkRow(int row) {
-    for ( int x = 0; x < COLUMNS; ++x ) {
-        if ( field_.at(x).at(row) < 2 ) {
-            return false;
-        }
+    if ( events.moved || events.locked ) {
+        piece_dirty_ = true;
     }
 
-    return true;
+    if ( events.locked ) {
+        playAi();
+    }
 }
 
-void MainWindow::finishTetromino() {
-    for ( int px = 0; px < 4; ++px ) {
-        for ( int py = 0; py < 4; ++py ) {
-            if ( current_->at(px).at(py) == 0 ) {
-                continue;
-            }
-            field_.at(position_.at(px).at(py).x)
-                  .at(position_.at(px).at(py).y) = current_shape_ + 2;
+void MainWindow::playAi() {
+    if ( !ai_ || pause_ ) return;
+    if ( !ai_player_.plan(engine_, ai_inputs_) ) return;
+
+    // The tetromino is left resting, gravity locks it
+    for ( int input : ai_inputs_ ) {
+        Qt::Key key = KEY_DROP;
+        switch ( input ) {
+        case Engine::LEFT:
+            key = KEY_LEFT;
+            break;
+        case Engine::RIGHT:
+            key = KEY_RIGHT;
+            break;
+        case Engine::ROTATE:
+            key = KEY_ROTATE;
+            break;
         }
-    }
-
-    // Randomize next tetromino and show
-    // in the box next to game field
-    current_ = nullptr;
-    createBlock(next_shape_);
-    next_shape_ = distr(randomEng);
-    drawNext();
-    if ( DEBUG ) qDebug() << "Tetromino finished " << current_shape_;
 
-    for ( int y = 0; y < ROWS; ++y ) {
-        if ( checkRow(y) ) {
-            clearRow(y);
-        }
+        // Tapped, so nothing auto repeats
+        QKeyEvent press(QEvent::KeyPress, key, Qt::NoModifier);
+        keyPressEvent(&press);
+        QKeyEvent release(QEvent::KeyRelease, key, Qt::NoModifier);
+        keyReleaseEvent(&release);
     }
 }
 
-int MainWindow::checkSpace(int d, int r = 1) {
-    // Default delta x and delta y
-    int dx = 0;
-    int dy = 0;
+void MainWindow::colourPiece() {
+    const QBrush& colour = colours_.at(engine_.currentShape());
 
-    switch ( d ) {
-    case LEFT:
-        dx = -r;
-        break;
-    case RIGHT:
-        dx = r;
-        break;
-    case DOWN:
-        dy = r;
-        break;
+    for ( QGraphicsRectItem* square : active_graphics_ ) {
+        square->setBrush(colour);
     }
 
-    for ( int px = 0; px < 4; ++px ) {
-        for ( int py = 0; py < 4; ++py ) {
-            if ( current_->at(px).at(py) != 1 ) continue;
-
-
-            // Check for walls
-            if ( (position_.at(px).at(py).x + dx >= COLUMNS || // Right wall
-                  position_.at(px).at(py).x + dx < 0) ) {      // Left wall
-
-                if ( DEBUG ) qDebug() << "Movement blocked: wall";
-                return WALL;
-            }
-
-            if ( position_.at(px).at(py).y + dy >= ROWS ) {
-                if ( DEBUG ) qDebug() << "Movement blocked: floor";
-                return FLOOR;
-            }
-
-            // Check for other blocks
-            if ( (position_.at(px).at(py).x + dx >= 0 &&
-                  position_.at(px).at(py).x + dx < COLUMNS) &&
-
-                 (position_.at(px).at(py).y + dy < ROWS) &&
-
-                 (field_.at(position_.at(px).at(py).x + dx)
-                        .at(position_.at(px).at(py).y + dy) > 1 ) ) {
-
-                if ( DEBUG ) qDebug() << "Movement blocked: tetromino";
-                return TETROMINO;
-            }
-        }
+    QColor ghost_colour = colour.color();
+    ghost_colour.setAlpha(60);
+    for ( QGraphicsRectItem* square : ghost_graphics_ ) {
+        square->setBrush(ghost_colour);
     }
-
-    return NONE;
 }
 
-void MainWindow::setAbsolutePosition(int p_x, int p_y, int x, int y) {
-    // Move piece's coordinates
-    position_.at(p_x).at(p_y) = { x, y };
+void MainWindow::gameOver() {
+    Trace::record< Trace::GAME >(Trace::GAME_END, engine_.points(),
+                                 minutes_ * 60 + seconds_);
 
-    // Clear the field
-    for ( int x = 0; x < COLUMNS; ++x ) {
-        for ( int y = 0; y < ROWS; ++y ) {
-            if ( field_.at(x).at(y) != 1 ) {
-                continue;
-            } else if ( field_.at(x).at(y) == 1 ) {
-                field_.at(x).at(y) = 0;
-            }
+    pause_ = true;
+    clock_->stop();
+    snapshot_.clear();
+    spectators_.publish(engine_, minutes_ * 60 + seconds_);
+
+    // On the disk within ScoreWriter::MAX_DELAY_MS
+    writer_.submit({ username_, engine_.points(),
+                     minutes_ * 60 + seconds_, level_, 0 });
+
+    // Keep the recording so the game can be reproduced
+    if ( RECORD_REPLAYS && !resumed_ ) {
+        replay_.finish(engine_);
+
+        std::string replay_file = REPLAY_DIR + "/" + username_ + "-"
+                                + std::to_string(seed_) + ".rpl";
+        if ( !QDir().mkpath(QString::fromStdString(REPLAY_DIR)) ||
+             !replay_.save(replay_file) ) {
+            qDebug() << "Error saving replay";
         }
     }
 
-    // Re-assign '1' to the new position
-    for ( int x = 0; x < COLUMNS; ++x ) {
-        for ( int y = 0; y < ROWS; ++y ) {
-            for ( int px = 0; px < 4; ++px ) {
-                for ( int py = 0; py < 4; ++py ) {
-                    if ( (x == position_.at(px).at(py).x &&
-                          y == position_.at(px).at(py).y) &&
-                         current_->at(px).at(py) == 1 ) {
+    // Show player game stats and ask to play again
+    QMessageBox::StandardButton replay;
+    QString message = QString("You got %1 points. Time %2 min and %3 s. "
+                              "Play again?")
+            .arg(engine_.points()).arg(minutes_).arg(seconds_);
 
-                        field_.at(x).at(y) = 1;
-                    }
-                }
-            }
-        }
+    replay = QMessageBox::question(this, "Game over",
+                                   message,
+                                   QMessageBox::Yes | QMessageBox::No);
+
+    if ( replay == QMessageBox::No ) {
+        qApp->exit();
     }
 
-    // Redraw the field after movement
-    draw();
+    // Re-enable game setup to start new game
+    if ( replay == QMessageBox::Yes ) {
+        ui->gameSetupGroupBox->setEnabled(true);
+    }
 }
 
-void MainWindow::moveBlock(int d) {
-    if ( current_ == nullptr ) return;
-    if ( pause_ ) return;
-
-    // Default delta x and delta y
-    int dx = 0;
-    int dy = 0;
+void MainWindow::gameloop() {
+    qint64 frame_start = micros();
+    if ( next_frame_us_ >= 0 && frame_start > next_frame_us_ ) {
+        stats_.record(FrameStats::FRAME_LATENESS,
+                      uint32_t(frame_start - next_frame_us_));
+    }
+    next_frame_us_ = frame_start + timer_.interval() * 1000;
 
-    int r = 1;
+    qint64 now = game_time_.elapsed();
+    qint64 elapsed = now - last_frame_;
+    last_frame_ = now;
 
-    switch ( d ) {
-    case LEFT:
-        dx = -LATERAL_SPEED;
-        break;
-    case RIGHT:
-        dx = LATERAL_SPEED;
-        break;
-    case DOWN:
-        fast_ ? dy = KEYPRESS_SPEED : dy = SPEED;
-        r = dy;
-        break;
-    }
+    // Time spent paused is never simulated
+    if ( pause_ ) return;
 
-    int status = checkSpace(d, r);
-    switch ( status ) {
-    case TETROMINO:
-        if ( d != DOWN ) {
-            return;
-        }
-        if ( fast_ ) {
-            moveToBottom();
-        }
-        finishTetromino();
-        break;
-    case WALL:
-        return;
-        break;
-    case FLOOR:
-        if ( fast_ ) {
-            moveToBottom();
+    InputQueue::Step step = [this](long time, int input) {
+        // Keys queued behind the end of the game are dropped
+        if ( pause_ ) return Engine::Events();
+        return this->input(input, time);
+    };
+
+    // Gravity steps every 'difficulty_' ms of game time however
+    // early or late the frame comes, the rest carries over
+    accumulator_ += elapsed;
+    int ticks = 0;
+    while ( accumulator_ >= difficulty_ && !pause_ ) {
+        accumulator_ -= difficulty_;
+
+        // Keys and repeats due before this gravity step go first
+        qint64 due = now - accumulator_;
+        inputs_.advance(due, step);
+        if ( pause_ ) break;
+        input(Engine::TICK, due);
+        stats_.record(FrameStats::TICK_LATENESS,
+                      uint32_t((now - due) * 1000));
+
+        // Far behind, e.g. after a stall. Drop the backlog
+        // rather than dropping the tetromino through it.
+        if ( ++ticks == MAX_TICKS_PER_FRAME ) {
+            Trace::record< Trace::TIMING >(Trace::BACKLOG,
+                                           int32_t(accumulator_));
+            accumulator_ = 0;
+            break;
         }
-        finishTetromino();
-        break;
     }
 
-    // Move each piece's coordinates
-    for ( int px = 0; px < 4; ++px ) {
-        for ( int py = 0; py < 4; ++py ) {
-            setAbsolutePosition(px, py, position_.at(px).at(py).x + dx,
-                                        position_.at(px).at(py).y + dy);
-        }
+    if ( !pause_ ) {
+        inputs_.advance(now, step);
     }
-}
 
-void MainWindow::createBlock(int tetromino) {
-    int start_x = 4;
-    int start_y = 0;
-
-    switch ( tetromino ) {
-    case HORIZONTAL:
-        start_x = 4;
-        start_y = -3;
-        break;
-    case SQUARE:
-        start_x = 4;
-        start_y = -1;
-        break;
-    case STEP_UP_RIGHT:
-    case STEP_UP_LEFT:
-    case LEFT_CORNER:
-    case RIGHT_CORNER:
-    case PYRAMID:
-        start_x = 4;
-        start_y = -2;
-        break;
+    // Not paused means the game goes on, an ended game
+    // has already been cleared from the snapshot
+    if ( !pause_ ) {
+        saveSnapshot();
     }
+    spectators_.publish(engine_, minutes_ * 60 + seconds_);
 
-    if ( DEBUG ) qDebug() << "Create block " << tetromino;
-
-    current_ = &types_.at(tetromino);
-    current_shape_ = tetromino;
-
-    for ( int x = 0; x < 4; ++x ) {
-        for ( int y = 0; y < 4; ++y ) {
-            position_.at(x).at(y) = { start_x + x, start_y + y };
+    qint64 simulated = micros();
+    stats_.record(FrameStats::SIMULATION, uint32_t(simulated - frame_start));
 
-            // To allow the 4*4 to go over the top
-            if ( start_y + y < 0 ) continue;
+    render();
+    stats_.record(FrameStats::SCENE, uint32_t(micros() - simulated));
 
-            field_.at(start_x + x).at(start_y + y) = current_->at(x).at(y);
-        }
-    }
+    showStats();
 }
 
-void MainWindow::gameOver() {
-    if ( DEBUG ) qDebug() << "Game over";
-
-    pause_ = true;
-    clock_->stop();
-
-    // Save score to file 'FILENAME'
-    std::string score =
-              username_ + ":"
-            + std::to_string(minutes_) + ":"
-            + std::to_string(seconds_) + ":"
-            + std::to_string(points_) + "\n";
-
-    std::ofstream outfile(FILENAME, std::ios_base::app | std::ios_base::out);
-
-    if ( !outfile ) {
-        qDebug() << "Error opening scoreboard";
+bool MainWindow::eventFilter(QObject* watched, QEvent* event) {
+    if ( event->type() != QEvent::Paint || painting_ ) {
+        return QMainWindow::eventFilter(watched, event);
     }
 
-    outfile << score;
-    outfile.close();
+    // Deliver the paint event again, this time past the
+    // filter, to see how long the view takes to paint
+    qint64 start = micros();
+    painting_ = true;
+    QCoreApplication::sendEvent(watched, event);
+    painting_ = false;
+    stats_.record(FrameStats::PAINT, uint32_t(micros() - start));
 
-    // Show player game stats and ask to play again
-    QMessageBox::StandardButton replay;
-    QString message = QString("You got %1 points. Time %2 min and %3 s. "
-                              "Play again?")
-            .arg(points_).arg(minutes_).arg(seconds_);
+    return true;
+}
 
-    replay = QMessageBox::question(this, "Game over",
-                                   message,
-                                   QMessageBox::Yes | QMessageBox::No);
+void MainWindow::showStats() {
+    if ( !show_stats_ ) return;
 
-    if ( replay == QMessageBox::No ) {
-        qApp->exit();
+    qint64 now = stats_timer_.elapsed();
+    if ( stats_shown_ != 0 && now - stats_shown_ < STATS_REFRESH_MS ) {
+        return;
     }
+    stats_shown_ = now;
 
-    // Re-enable game setup to start new game
-    if ( replay == QMessageBox::Yes ) {
-        ui->gameSetupGroupBox->setEnabled(true);
-    }
+    stats_item_->setText(QString::fromStdString(stats_.summary()));
 }
 
-void MainWindow::gameloop() {
-    if ( !pause_ ) {
-        // Create the first shape
-        if ( create_ ) {
-            create_ = !create_;
-            next_shape_ = distr(randomEng);
-            drawNext();
-            createBlock(distr(randomEng));
-        }
-
-        for ( int x = 0; x < 6; ++x ) {
-            for ( int y = 0; y < 3; ++y ) {
-                // Check if spawn zone is occupied
-                //      -> game over
+qint64 MainWindow::micros() const {
+    return stats_timer_.nsecsElapsed() / 1000;
+}
 
-                if ( field_.at(3 + x).at(0 + y) > 1 ) {
-                    gameOver();
-                    return;
-                }
-            }
-        }
+void MainWindow::render() {
+    if ( score_dirty_ ) {
+        updateUI();
+    }
 
+    if ( board_dirty_ ) {
         draw();
-        moveBlock(DOWN);
+        drawNext();
+        colourPiece();
     }
+
+    if ( piece_dirty_ ) {
+        drawPiece();
+    }
+
+    score_dirty_ = false;
+    board_dirty_ = false;
+    piece_dirty_ = false;
 }
 
 void MainWindow::drawGrid() {
@@ -689,7 +625,7 @@ void MainWindow::drawGrid() {
                         blackPen);
     }
 
-    for ( int j = 0; j < ROWS; ++j ) {
+    for ( int j = 0; j < COLUMNS; ++j ) {
         scene_->addLine(j * SQUARE_SIDE, 0,
                         j * SQUARE_SIDE, BORDER_DOWN,
                         blackPen);
@@ -698,38 +634,135 @@ void MainWindow::drawGrid() {
 
 void MainWindow::game() {
     // Reset all game stats
-    create_ = true;
     minutes_ = 0;
     seconds_ = 0;
-    points_ = 0;
-    field_.clear();
-    position_.clear();
-    current_ = nullptr;
     pause_ = false;
-    updateUI();
-    draw();
 
-    field_ = std::vector< std::vector< int > >
-            (COLUMNS, std::vector< int >(ROWS, 0));
+    seed_ = time(0); // You can change seed value for testing purposes
+    engine_.reset(seed_, points_per_row_);
+    Trace::record< Trace::GAME >(Trace::GAME_START, int32_t(seed_), level_);
+    replay_.begin(seed_, points_per_row_);
+    resumed_ = false;
+    accumulator_ = 0;
 
-    position_ = std::vector< std::vector< tetromino_pos > >
-            (4, std::vector< tetromino_pos >(4, { 0, 0 }));
+    startLoop();
+}
 
-    // Set up timer and start game loop
-    timer_.start(difficulty_);
+void MainWindow::startLoop() {
+    spectators_.keyframe();
+    game_time_.start();
+    inputs_.clear();
+    inputs_.setAutoRepeat(DAS_MS, ARR_MS);
+    last_frame_ = 0;
+
+    score_dirty_ = true;
+    board_dirty_ = true;
+    piece_dirty_ = true;
+    render();
+    playAi();
+
+    // Frames come at the display refresh rate, gravity
+    // is independent of it
+    QScreen* screen = QGuiApplication::primaryScreen();
+    double refresh = screen != nullptr ? screen->refreshRate() : 60.0;
+    timer_.start(qMax(1, qRound(1000.0 / refresh)));
     clock_->start(1000);
 }
 
+void MainWindow::saveSnapshot() {
+    Snapshot::Game game;
+    // Zeroed padding, the snapshot checksums every byte
+    std::memset(&game, 0, sizeof(game));
+
+    engine_.save(game.engine);
+    game.seed = seed_;
+    game.level = level_;
+    game.difficulty = difficulty_;
+    game.seconds = minutes_ * 60 + seconds_;
+    game.accumulator = int32_t(accumulator_);
+    game.ai = ai_;
+    game.name_length = uint8_t(std::min(username_.size(),
+                                        size_t(Snapshot::NAME_LENGTH)));
+    std::memcpy(game.name, username_.data(), game.name_length);
+
+    snapshot_.save(game);
+}
+
+bool MainWindow::resume() {
+    Snapshot::Game game;
+    if ( !snapshot_.load(game) ) {
+        return false;
+    }
+
+    // A snapshot that doesn't make sense is dropped,
+    // the player starts a new game instead
+    bool valid = game.level >= 0 &&
+                 game.level < Engine::NUMBER_OF_DIFFICULTIES;
+    if ( valid ) {
+        const Engine::DIFFICULTY_CONSTANTS& constants =
+                Engine::DIFFICULTIES[game.level];
+        // Gravity speeds up in steps from the level's speed until
+        // MAX_DIFFICULTY is passed, the speed is one of those steps
+        valid = game.difficulty > Engine::MAX_DIFFICULTY -
+                                  Engine::DIFFICULTY_STEP &&
+                game.difficulty <= constants.speed &&
+                (constants.speed - game.difficulty) %
+                Engine::DIFFICULTY_STEP == 0 &&
+                game.engine.points_per_row == constants.points &&
+                game.seconds >= 0 && game.accumulator >= 0 &&
+                !game.engine.game_over && engine_.restore(game.engine);
+    }
+    if ( !valid ) {
+        snapshot_.clear();
+        return false;
+    }
+
+    seed_ = game.seed;
+    level_ = game.level;
+    difficulty_ = game.difficulty;
+    points_per_row_ = game.engine.points_per_row;
+    minutes_ = game.seconds / 60;
+    seconds_ = game.seconds % 60;
+    accumulator_ = game.accumulator;
+    ai_ = game.ai != 0;
+    username_.assign(game.name, std::min(int(game.name_length),
+                                         int(Snapshot::NAME_LENGTH)));
+    Trace::record< Trace::GAME >(Trace::RESUME, int32_t(seed_),
+                                 game.seconds);
+
+    // Replays start from an empty field, this one is kept
+    // only so that input() has somewhere to record to
+    replay_.begin(seed_, points_per_row_);
+    resumed_ = true;
+
+    ui->usernameLineEdit->setText(QString::fromStdString(username_));
+    ui->lcdTimerS->display(seconds_);
+    ui->lcdTimerM->display(minutes_);
+    ui->gameSetupGroupBox->setEnabled(false);
+    ui->pauseButton->setEnabled(true);
+    ui->endGameButton->setEnabled(true);
+    ui->graphicsView->setFocus();
+
+    // The player may not be at the keyboard yet
+    pause_ = false;
+    startLoop();
+    pauseGame();
+    return true;
+}
+
 void MainWindow::on_startButton_clicked() {
     if ( ui->easyRadio->isChecked() ) {
-        difficulty_ = difficulties.at(EASY).speed;
-        points_per_row_ = difficulties.at(EASY).points;
+        difficulty_ = Engine::DIFFICULTIES[Engine::EASY].speed;
+        points_per_row_ = Engine::DIFFICULTIES[Engine::EASY].points;
+        level_ = Engine::EASY;
     } else if ( ui->mediumRadio->isChecked() ) {
-        difficulty_ = difficulties.at(MEDIUM).speed;
-        points_per_row_ = difficulties.at(MEDIUM).points;
+        difficulty_ = Engine::DIFFICULTIES[Engine::MEDIUM].speed;
+        points_per_row_ = Engine::DIFFICULTIES[Engine::MEDIUM].points;
+        level_ = Engine::MEDIUM;
     } else if ( ui->insaneRadio->isChecked() ) {
-        difficulty_ = difficulties.at(INSANE).speed;
-        points_per_row_ = difficulties.at(INSANE).points;
+        difficulty_ = Engine::DIFFICULTIES[Engine::INSANE].speed;
+        points_per_row_ = Engine::DIFFICULTIES[Engine::INSANE].points;
+        level_ = Engine::INSANE;
     }
 
     if ( ui->usernameLineEdit->text().toStdString() != "" ) {
@@ -745,7 +778,7 @@ void MainWindow::on_startButton_clicked() {
 }
 
 void MainWindow::on_scoreBoardButton_clicked() {
-    ScoreBoard* scoreBoard = new ScoreBoard(FILENAME);
+    ScoreBoard* scoreBoard = new ScoreBoard(STORE, FILENAME);
     scoreBoard->show();
 }
 
@@ -754,3 +787,21 @@ void MainWindow::on_endGameButton_clicked() {
     ui->pauseButton->setEnabled(false);
     ui->endGameButton->setEnabled(false);
 }
+
+void MainWindow::on_versusButton_clicked() {
+    // Keys go to the versus window, the game here would run on alone
+    if ( ui->pauseButton->isEnabled() && !pause_ ) {
+        pauseGame();
+    }
+
+    int level = Engine::MEDIUM;
+    if ( ui->easyRadio->isChecked() ) {
+        level = Engine::EASY;
+    } else if ( ui->insaneRadio->isChecked() ) {
+        level = Engine::INSANE;
+    }
+
+    VersusWindow* versus = new VersusWindow(level, this);
+    versus->setAttribute(Qt::WA_DeleteOnClose);
+    versus->show();
+}
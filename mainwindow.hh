@@ -10,12 +10,21 @@
 #ifndef MAINWINDOW_HH
 #define MAINWINDOW_HH
 
+#include "aiplayer.hh"
+#include "engine.hh"
+#include "framestats.hh"
+#include "inputqueue.hh"
+#include "replay.hh"
+#include "scorestore.hh"
+#include "scorewriter.hh"
+#include "snapshot.hh"
+#include "spectator.hh"
+#include "trace.hh"
 #include <QMainWindow>
+#include <QElapsedTimer>
 #include <QGraphicsScene>
+#include <QGraphicsSimpleTextItem>
 #include <QTimer>
-#include <random>
-
-using Tetromino = std::vector< std::vector< int > >;
 
 namespace Ui {
     class MainWindow;
@@ -28,6 +37,13 @@ public:
     explicit MainWindow(QWidget *parent = 0);
     ~MainWindow();
 
+signals:
+    /**
+     * @brief linesCleared
+     * @param lines: number of rows cleared by one lock
+     */
+    void linesCleared(int lines);
+
 private slots:
     /**
      * @brief updateTime
@@ -41,43 +57,94 @@ private slots:
 
     void on_endGameButton_clicked();
 
+    void on_versusButton_clicked();
+
+protected:
+    /**
+     * @brief eventFilter
+     * @param watched: object the event is for
+     * @param event
+     * @return true if the event was handled here
+     * Times the paint events of the game view
+     */
+    bool eventFilter(QObject* watched, QEvent* event) override;
+
 private:
-    bool DEBUG = true;
     Ui::MainWindow *ui;
 
     QGraphicsScene* scene_;
     QGraphicsScene* next_scene_;
 
-    // Constants describing scene coordinates
-    const int BORDER_UP = 0;
-    const int BORDER_DOWN = 480;
-    const int BORDER_LEFT = 0;
-    const int BORDER_RIGHT = 240;
-
-    const int SQUARE_SIDE = 20;
-    const int COLUMNS = BORDER_RIGHT / SQUARE_SIDE;
-    const int ROWS = BORDER_DOWN / SQUARE_SIDE;
-
-    // Constants for different tetrominos and the number of them
-    enum TETROMINO_KIND { HORIZONTAL,
-                          LEFT_CORNER,
-                          RIGHT_CORNER,
-                          SQUARE,
-                          STEP_UP_RIGHT,
-                          PYRAMID,
-                          STEP_UP_LEFT,
-                          NUMBER_OF_TETROMINOS };
-
-    enum DIRECTIONS { LEFT, RIGHT, DOWN };
-    enum OBSTACLE { NONE, WALL, FLOOR, TETROMINO };
-
-    // For randomly selecting the next dropping tetromino
-    std::default_random_engine randomEng;
-    std::uniform_int_distribution<int> distr;
+    // Constants describing scene coordinates, the
+    // field size comes from the board of the build
+    static const int SQUARE_SIDE = 20;
+    static const int COLUMNS = Board::COLUMNS;
+    static const int ROWS = Board::ROWS;
 
-    // Game timer
+    static const int BORDER_UP = 0;
+    static const int BORDER_DOWN = ROWS * SQUARE_SIDE;
+    static const int BORDER_LEFT = 0;
+    static const int BORDER_RIGHT = COLUMNS * SQUARE_SIDE;
+
+    struct tetromino_pos {
+        int x;
+        int y;
+    };
+
+    // Game rules and state
+    Engine engine_;
+    // Seed of the current game
+    unsigned seed_ = 0;
+
+    // Recording of the current game and its clock
+    Replay replay_;
+    QElapsedTimer game_time_;
+    // A resumed game is recorded from the middle,
+    // its replay can't be played back and isn't saved
+    bool resumed_ = false;
+
+    // Key presses and releases waiting for the engine
+    InputQueue inputs_;
+    // Game time of the input being applied, -1 between inputs
+    qint64 input_time_ = -1;
+
+    // Computer player and whether it is playing
+    AiPlayer ai_player_;
+    bool ai_ = false;
+    std::vector< int > ai_inputs_;
+
+    // Frame timer, runs at the display refresh rate
     QTimer timer_;
 
+    // Fixed timestep: game time not simulated yet and the
+    // time of the last frame, in ms
+    qint64 accumulator_ = 0;
+    qint64 last_frame_ = 0;
+    // Gravity steps one frame may catch up on
+    const int MAX_TICKS_PER_FRAME = 4;
+
+    // Live stream of the game for spectators, if one was asked for
+    SpectatorStream spectators_;
+
+    // Timing of every frame, see FrameStats::METRIC
+    FrameStats stats_;
+    QElapsedTimer stats_timer_;
+    // When the next frame should start, in us
+    qint64 next_frame_us_ = -1;
+    // Paint event being timed
+    bool painting_ = false;
+
+    // Timing overlay and when it was last updated
+    QGraphicsSimpleTextItem* stats_item_;
+    bool show_stats_ = false;
+    qint64 stats_shown_ = 0;
+    const int STATS_REFRESH_MS = 250;
+
+    // What changed since the last frame was rendered
+    bool score_dirty_ = false;
+    bool board_dirty_ = false;
+    bool piece_dirty_ = false;
+
     /**
      * @brief updateUI
      * Update the UI elements (points)
@@ -101,87 +168,72 @@ private:
      */
     void keyReleaseEvent(QKeyEvent* event);
     /**
-     * @brief paintEvent
-     * @param event
-     * Draw the whole field
+     * @brief draw
+     * Draw the finished tetrominos of the field
      */
     void draw();
     /**
-     * @brief drawNext
-     * Draw the next tetromino next to
-     * the play field
-     */
-    void drawNext();
-    /**
-     * @brief allClearBelow
-     * @param col
-     * @return true if there are no
-     *         obstacles below given row
-     */
-    bool allClearBelow(int col);
-    /**
-     * @brief moveToBottom
-     * Move tetromino as low as possible
-     * in one tick
-     */
-    void moveToBottom();
-    /**
-     * @brief rotateTetromino
+     * @brief drawPiece
+     * Move the squares of the active tetromino
+     * and its ghost to their current positions
      */
-    void rotateTetromino();
+    void drawPiece();
     /**
-     * @brief clearRow
-     * @param row
-     * Clear a row and shift all above
+     * @brief moveSquares
+     * @param squares: 4 squares to move
+     * @param cells: cells the squares currently cover
+     * @param x: x coordinate of the 4*4 box
+     * @param y: y coordinate of the 4*4 box
+     * Lay the squares out in the active tetromino's shape,
+     * touching only the ones whose cell changed
      */
-    void clearRow(int row);
+    void moveSquares(std::vector< QGraphicsRectItem* >& squares,
+                     std::vector< tetromino_pos >& cells,
+                     int x, int y);
     /**
-     * @brief checkRow
-     * @param row
-     * Check if a row could be cleared
+     * @brief drawNext
+     * Draw the next tetromino next to
+     * the play field
      */
-    bool checkRow(int row);
+    void drawNext();
     /**
-     * @brief finishTetromino
-     * Move a tetromino to be part of the floor
+     * @brief keyInput
+     * @param key: pressed or released key
+     * @return Engine::INPUT of the key, -1 if it has none
      */
-    void finishTetromino();
+    int keyInput(int key) const;
     /**
-     * @brief checkSpace
-     * @param d: direction
-     * @param r: range
-     * @return 0: free
-     *         1: wall
-     *         2: floor
-     *         3: tetromino
+     * @brief keyTime
+     * @return game time to stamp a key event with
      */
-    int checkSpace(int d, int r);
+    qint64 keyTime() const;
     /**
-     * @brief setAbsolutePosition
-     * @param p_x: x coordinate in the tetromino 4x4
-     * @param p_y: y coordinate in the tetromino 4x4
-     * @param x: x coordinate to go to
-     * @param y: y coordinate to go to
+     * @brief input
+     * @param input: Engine::INPUT
+     * @param time: game time of the input
+     * @return result of the engine step
+     * Feed an input to the engine, record it
+     * and update the UI
      */
-    void setAbsolutePosition(int p_x, int p_y, int x, int y);
+    Engine::Events input(int input, qint64 time);
     /**
-     * @brief moveBlock
-     * @param d: direction
-     * Move tetromino left/right/down
+     * @brief applyEvents
+     * @param events: result of an engine step
+     * Update the UI after the engine has moved on
      */
-    void moveBlock(int d);
+    void applyEvents(const Engine::Events& events);
     /**
-     * @brief gravity
-     * Move tetrommino 1 step down
-     * at each tick
+     * @brief playAi
+     * Let the computer player move the active tetromino
+     * by pressing the same keys as a human would
      */
-    void gravity();
+    void playAi();
     /**
-     * @brief createBlock
-     * @param block_id
-     * Create a block with given id
+     * @brief colourPiece
+     * Give the active tetromino and its ghost
+     * the colour of the current shape
      */
-    void createBlock(int tetromino);
+    void colourPiece();
     /**
      * @brief drawGrid
      */
@@ -193,131 +245,74 @@ private:
     void gameOver();
     /**
      * @brief gameloop
-     * Main loop of the game
+     * Main loop of the game, runs once per frame.
+     * Steps gravity on a fixed timestep and
+     * renders what changed
      */
     void gameloop();
+    /**
+     * @brief render
+     * Update the scene items of whatever the
+     * engine changed since the last frame
+     */
+    void render();
+    /**
+     * @brief showStats
+     * Refresh the timing overlay if it is on
+     */
+    void showStats();
+    /**
+     * @brief micros
+     * @return time since the window was created in us
+     */
+    qint64 micros() const;
     /**
      * @brief game
      * Set up variables to begin gameloop
      */
     void game();
-
-    // Holds the address of the active tetromino shape
-    std::vector< std::vector< int > >* current_;
-    // Current shape id
-    int current_shape_;
-    // Next shape id
-    int next_shape_;
-
-    // Wheter to create a tetromino
-    bool create_ = true;
-
-    // Fast gravity when 'Down'-key is pressed
-    bool fast_ = false;
+    /**
+     * @brief startLoop
+     * Start the frame timer and the game clock,
+     * game time starts from zero
+     */
+    void startLoop();
+    /**
+     * @brief saveSnapshot
+     * Copy the game to the snapshot file
+     */
+    void saveSnapshot();
+    /**
+     * @brief resume
+     * @return false if there is no game to resume
+     * Continue the game of the snapshot file, paused
+     */
+    bool resume();
 
     bool pause_ = false;
-    int points_ = 0;
 
     // Game timer
     QTimer* clock_;
     int seconds_ = 0;
     int minutes_ = 0;
 
-    int points_per_row_ = EASY;
-
-    struct tetromino_pos {
-        int x;
-        int y;
-    };
-
-    // 4*4 that holds the information of each piece in the tetromino
-    std::vector< std::vector< tetromino_pos > > position_;
-
-    // Whole game field, initialized with size COLUMNS*ROWS
-    // values:
-    //  0: empty
-    //  1: active tetromino
-    //  2..9: finished tetromino
-    std::vector< std::vector< int > > field_;
-
-    // ####
-    std::vector< std::vector< int > > shape_1 = {
-        { 0, 0, 1, 0 },
-        { 0, 0, 1, 0 },
-        { 0, 0, 1, 0 },
-        { 0, 0, 1, 0 }
-    };
-
-    // #
-    // ###
-    std::vector< std::vector< int > > shape_2 = {
-        { 0, 1, 1, 0 },
-        { 0, 1, 0, 0 },
-        { 0, 1, 0, 0 },
-        { 0, 0, 0, 0 }
-    };
-
-    //   #
-    // ###
-    std::vector< std::vector< int > > shape_3 = {
-        { 0, 1, 1, 0 },
-        { 0, 0, 1, 0 },
-        { 0, 0, 1, 0 },
-        { 0, 0, 0, 0 }
-    };
-
-    // ##
-    // ##
-    std::vector< std::vector< int > > shape_4 = {
-        { 0, 0, 0, 0 },
-        { 1, 1, 0, 0 },
-        { 1, 1, 0, 0 },
-        { 0, 0, 0, 0 }
-    };
-
-    //  ##
-    // ##
-    std::vector< std::vector< int > > shape_5 = {
-        { 0, 1, 0, 0 },
-        { 0, 1, 1, 0 },
-        { 0, 0, 1, 0 },
-        { 0, 0, 0, 0 }
-    };
-
-    //  #
-    // ###
-    std::vector< std::vector< int > > shape_6 = {
-        { 0, 0, 1, 0 },
-        { 0, 1, 1, 0 },
-        { 0, 0, 1, 0 },
-        { 0, 0, 0, 0 }
-    };
-
-    // ##
-    //  ##
-    std::vector< std::vector< int > > shape_7 = {
-        { 0, 0, 1, 0 },
-        { 0, 1, 1, 0 },
-        { 0, 1, 0, 0 },
-        { 0, 0, 0, 0 }
-    };
-
-    std::vector< Tetromino > types_ = { shape_1, shape_2, shape_3,
-                                        shape_4, shape_5, shape_6, shape_7 };
+    int points_per_row_ = Engine::EASY;
 
     std::vector< QGraphicsRectItem* > graphics_;
 
-    struct DIFFICULTY_CONSTANTS {
-        int difficulty;
-        int points;
-        int speed;
-    };
+    // Squares of the active tetromino and the cells they cover
+    std::vector< QGraphicsRectItem* > active_graphics_;
+    std::vector< tetromino_pos > active_cells_;
+
+    // Squares of the landing preview and the cells they cover
+    std::vector< QGraphicsRectItem* > ghost_graphics_;
+    std::vector< tetromino_pos > ghost_cells_;
 
     /*
      *  Game tuneables
      */
 
-    // Brushes. Ordered by 'TETROMINO_KIND'
+    // Brushes. Ordered by 'Engine::TETROMINO_KIND', garbage last
     std::vector< QBrush > colours_ = {
         QBrush(Qt::cyan),
         QBrush(Qt::blue),
@@ -325,39 +320,18 @@ private:
         QBrush(Qt::yellow),
         QBrush(Qt::green),
         QBrush(Qt::magenta),
-        QBrush(Qt::red)
+        QBrush(Qt::red),
+        // Board::GARBAGE
+        QBrush(Qt::darkGray)
     };
 
     // Default username
     std::string username_ = "anonymous";
 
-    // Difficulty defines the rate at which
-    // tetrominos fall (clock tick delay).
-    enum DIFFICULTY { EASY,
-                      MEDIUM,
-                      INSANE };
-
-    std::vector< DIFFICULTY_CONSTANTS > difficulties = {
-        { EASY, 10, 800 },
-        { MEDIUM, 15, 400 },
-        { INSANE, 25, 150 },
-    };
-
-    // Default difficulty
-    int difficulty_ = MEDIUM;
-    // How often to increase difficulty in seconds
-    int DIFFICULTY_INTERVAL = 30;
-    // Maximum difficulty. Lower is harder
-    int MAX_DIFFICULTY = 70;
-    // How much to increase difficulty per DIFFICULTY_INTERVAL
-    int DIFFICULTY_STEP = 20;
-
-    // How much to move a block per frame
-    const int SPEED = 1;
-    // How much to move a block on keypress
-    const int KEYPRESS_SPEED = 2 * SPEED;
-    // How much to move a block sideways on keypress
-    const int LATERAL_SPEED = 1;
+    // Default difficulty, see Engine::DIFFICULTIES
+    int difficulty_ = Engine::MEDIUM;
+    // Difficulty the game was started on, saved with the score
+    int level_ = Engine::MEDIUM;
 
     // Key bindings
     Qt::Key KEY_DOWN = Qt::Key_S;
@@ -365,9 +339,47 @@ private:
     Qt::Key KEY_RIGHT = Qt::Key_D;
     Qt::Key KEY_ROTATE = Qt::Key_W;
     Qt::Key KEY_DROP = Qt::Key_Space;
-
-    // Scoreboard file name
+    // Toggles the computer player
+    Qt::Key KEY_AI = Qt::Key_I;
+    // Toggles the timing overlay
+    Qt::Key KEY_STATS = Qt::Key_F3;
+    // Dumps the event trace
+    Qt::Key KEY_TRACE = Qt::Key_F9;
+
+    // Auto repeat of held left and right keys: delay before the
+    // first repeat and time between repeats, 0 moves to the wall
+    int DAS_MS = 167;
+    int ARR_MS = 33;
+
+    // Old text scoreboard, imported into the store once
     std::string FILENAME = "leaders.txt";
+    // Score store base name and the store
+    std::string STORE = "leaders";
+    ScoreStore scores_ = ScoreStore(STORE);
+    // Appends scores to the store off the GUI thread
+    ScoreWriter writer_{ scores_ };
+
+    // Game in progress is kept here every frame and resumed
+    // on the next start, e.g. after a crash
+    std::string SNAPSHOT_FILE = "snapshot.bin";
+    Snapshot snapshot_{ SNAPSHOT_FILE };
+
+    // Whether to save a replay of every game and where
+    bool RECORD_REPLAYS = true;
+    std::string REPLAY_DIR = "replays";
+
+    // Frame timing histograms are saved here on exit
+    std::string STATS_FILE = "frametimes.csv";
+
+    // Event trace dumps, read them with tetris-trace
+    std::string TRACE_FILE = "trace.bin";
+    std::string CRASH_TRACE_FILE = "crash-trace.bin";
+
+    // Spectator stream target: a file, a FIFO or unix:path for a
+    // local relay. The environment variable overrides it, empty
+    // means no stream.
+    std::string SPECTATOR_STREAM = "";
+    const char* SPECTATOR_ENV = "TETRIS_SPECTATE";
 };
 
 #endif // MAINWINDOW_HH
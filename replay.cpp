@@ -0,0 +1,128 @@
+/*
+ * Tetris -game
+ * Compact recording of a game: the seed and
+ * every engine input with its time, enough to
+ * re-simulate the game exactly
+ *
+ * Timi Rautamäki, 284032
+ *
+ */
+
+#include "replay.hh"
+#include "varint.hh"
+#include <fstream>
+#include <iterator>
+
+namespace {
+
+const char MAGIC[] = "TRP";
+
+}
+
+void Replay::begin(unsigned seed, int points_per_row) {
+    seed_ = seed;
+    points_per_row_ = points_per_row;
+    last_time_ = 0;
+
+    data_.assign(MAGIC, 3);
+    data_.push_back(char(VERSION));
+    Varint::put(data_, seed);
+    Varint::put(data_, uint64_t(points_per_row));
+}
+
+void Replay::record(long time_ms, int input) {
+    // Time never runs backwards in a recording
+    long delta = time_ms > last_time_ ? time_ms - last_time_ : 0;
+    last_time_ += delta;
+
+    Varint::put(data_, (uint64_t(delta) << 3) | uint64_t(input));
+}
+
+void Replay::finish(const Engine& engine) {
+    Varint::put(data_, END);
+    Varint::put(data_, uint64_t(engine.points()));
+    Varint::put(data_, uint64_t(engine.pieces()));
+    Varint::put(data_, uint64_t(engine.lines()));
+}
+
+bool Replay::save(const std::string& filename) const {
+    std::ofstream file(filename, std::ios_base::binary | std::ios_base::out);
+    if ( !file ) {
+        return false;
+    }
+
+    file.write(data_.data(), std::streamsize(data_.size()));
+    return bool(file);
+}
+
+bool Replay::load(const std::string& filename) {
+    std::ifstream file(filename, std::ios_base::binary);
+    if ( !file ) {
+        return false;
+    }
+
+    data_.assign(std::istreambuf_iterator< char >(file),
+                 std::istreambuf_iterator< char >());
+
+    size_t pos = 0;
+    last_time_ = 0;
+    return readHeader(pos, seed_, points_per_row_);
+}
+
+bool Replay::readHeader(size_t& pos, unsigned& seed,
+                        int& points_per_row) const {
+    if ( data_.compare(0, 3, MAGIC) != 0 || data_.size() < 4 ||
+         uint8_t(data_[3]) != VERSION ) {
+        return false;
+    }
+
+    pos = 4;
+    uint64_t seed_value = 0;
+    uint64_t points_value = 0;
+    if ( !Varint::get(data_, pos, seed_value) ||
+         !Varint::get(data_, pos, points_value) ) {
+        return false;
+    }
+
+    seed = unsigned(seed_value);
+    points_per_row = int(points_value);
+    return true;
+}
+
+bool Replay::run(Engine& engine, long* inputs) const {
+    size_t pos = 0;
+    unsigned seed = 0;
+    int points_per_row = 0;
+    if ( !readHeader(pos, seed, points_per_row) ) {
+        return false;
+    }
+
+    engine.reset(seed, points_per_row);
+
+    long count = 0;
+    uint64_t value = 0;
+    while ( Varint::get(data_, pos, value) ) {
+        int input = int(value & 7);
+
+        if ( input == END ) {
+            uint64_t points = 0;
+            uint64_t pieces = 0;
+            uint64_t lines = 0;
+            if ( inputs != nullptr ) *inputs = count;
+
+            return Varint::get(data_, pos, points) &&
+                   Varint::get(data_, pos, pieces) &&
+                   Varint::get(data_, pos, lines) &&
+                   points == uint64_t(engine.points()) &&
+                   pieces == uint64_t(engine.pieces()) &&
+                   lines == uint64_t(engine.lines());
+        }
+
+        engine.step(input);
+        ++count;
+    }
+
+    // Recording was cut short, nothing to verify against
+    if ( inputs != nullptr ) *inputs = count;
+    return false;
+}
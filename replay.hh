@@ -0,0 +1,90 @@
+/*
+ * Tetris -game
+ * Compact recording of a game: the seed and
+ * every engine input with its time, enough to
+ * re-simulate the game exactly
+ *
+ * Timi Rautamäki, 284032
+ *
+ */
+
+#ifndef REPLAY_HH
+#define REPLAY_HH
+
+#include "engine.hh"
+#include <cstdint>
+#include <string>
+
+// File layout, all numbers are LEB128 varints:
+//   "TRP" version seed points_per_row
+//   ((delta_ms << 3) | input)...
+//   END points pieces lines
+class Replay {
+public:
+    static const uint8_t VERSION = 1;
+
+    // Marks the end of the inputs, followed by the final result
+    static const int END = Engine::NUMBER_OF_INPUTS;
+
+    /**
+     * @brief begin
+     * @param seed: seed the engine was reset with
+     * @param points_per_row: points the engine was reset with
+     * Start a new recording
+     */
+    void begin(unsigned seed, int points_per_row);
+    /**
+     * @brief record
+     * @param time_ms: milliseconds since the game started
+     * @param input: input given to Engine::step
+     */
+    void record(long time_ms, int input);
+    /**
+     * @brief finish
+     * @param engine: engine at the end of the game
+     * Store the final result so a replay can be verified
+     */
+    void finish(const Engine& engine);
+    /**
+     * @brief save
+     * @param filename
+     * @return false if the file could not be written
+     */
+    bool save(const std::string& filename) const;
+    /**
+     * @brief load
+     * @param filename
+     * @return false if the file could not be read
+     *         or is not a replay
+     */
+    bool load(const std::string& filename);
+    /**
+     * @brief run
+     * @param engine: engine to re-simulate on
+     * @param inputs: filled with the number of inputs replayed
+     * @return true if the replay ran to its end and the
+     *         result matches the recorded one
+     */
+    bool run(Engine& engine, long* inputs = nullptr) const;
+
+    const std::string& data() const { return data_; }
+    unsigned seed() const { return seed_; }
+    long duration() const { return last_time_; }
+
+private:
+    /**
+     * @brief readHeader
+     * @param pos: filled with the position of the first input
+     * @param seed: filled with the recorded seed
+     * @param points_per_row: filled with the recorded points
+     * @return false if the header is invalid
+     */
+    bool readHeader(size_t& pos, unsigned& seed, int& points_per_row) const;
+
+    std::string data_;
+    unsigned seed_ = 0;
+    int points_per_row_ = 0;
+    long last_time_ = 0;
+};
+
+#endif // REPLAY_HH
@@ -8,85 +8,99 @@
 
 #include "scoreboard.hh"
 #include "ui_scoreboard.h"
+#include "engine.hh"
+#include "legacyscores.hh"
 #include <algorithm>
-#include <fstream>
 #include <QDebug>
 
-ScoreBoard::ScoreBoard(std::string& filename, QWidget *parent) :
+ScoreBoard::ScoreBoard(const std::string& store, const std::string& legacy,
+                       QWidget *parent) :
     QDialog(parent),
     ui(new Ui::ScoreBoard),
-    filename_(filename) {
+    store_(store),
+    model_(new ScoreModel(store_, this)),
+    legacy_(legacy) {
 
     ui->setupUi(this);
+    ui->listView->setModel(model_);
+
+    // Item data is the difficulty to filter by
+    ui->difficultyComboBox->addItem("All", ScoreModel::ANY_DIFFICULTY);
+    ui->difficultyComboBox->addItem("Easy", Engine::EASY);
+    ui->difficultyComboBox->addItem("Medium", Engine::MEDIUM);
+    ui->difficultyComboBox->addItem("Insane", Engine::INSANE);
+
+    connect(ui->nameLineEdit, &QLineEdit::textChanged,
+            this, &ScoreBoard::applyFilter);
+    connect(ui->difficultyComboBox,
+            QOverload< int >::of(&QComboBox::currentIndexChanged),
+            this, &ScoreBoard::applyFilter);
+
     readFile();
 }
 
 ScoreBoard::~ScoreBoard() {
+    // Batches still queued for us are dropped with the object
+    closing_ = true;
+    if ( reader_.joinable() ) {
+        reader_.join();
+    }
     delete ui;
 }
 
-bool ScoreBoard::compareScores(const entry_  &a, const entry_ &b) {
-    return a.score > b.score;
-}
-
 void ScoreBoard::readFile() {
-    std::vector< entry_ > entries;
-    std::ifstream file(filename_);
-
-    // Create new leaderboard if not found
-    if ( !file ) {
+    // The game window's writer creates and writes the store
+    if ( !store_.openReadOnly() ) {
         qDebug() << "Error opening leaderboard";
     }
 
-    std::string row;
-
-    while ( getline(file, row) ) {
-        std::vector< std::string > parts = split(row, ':');
-
-        entries.push_back( { QString::fromStdString(parts.at(0)),
-                             std::stoi(parts.at(3)),
-                             std::stoi(parts.at(1)),
-                             std::stoi(parts.at(2)) } );
-    }
-
-    file.close();
-
-    std::sort(entries.begin(), entries.end(), compareScores);
-
-    int i = 1;
-    for ( entry_ e : entries ) {
-        QString entry = QString("%1. %2 %3 points in %4 min and %5 s.")
-                        .arg(QString::number(i))
-                        .arg(e.name.leftJustified(20, ' '))
-                        .arg(QString::number(e.score))
-                        .arg(QString::number(e.min))
-                        .arg(QString::number(e.s));
-
-        ui->listWidget->addItem(new QListWidgetItem(entry));
-
-        ++i;
+    // Until the old scores are imported they come from the text file
+    if ( !store_.imported() ) {
+        ui->nameLineEdit->setEnabled(false);
+        ui->difficultyComboBox->setEnabled(false);
+        readLegacy();
     }
 }
 
-std::vector< std::string > ScoreBoard::split(const std::string& s,
-                                             const char delimiter,
-                                             bool ignore_empty /* = false*/) {
+void ScoreBoard::applyFilter() {
+    model_->setFilter(ui->nameLineEdit->text().trimmed().toStdString(),
+                      ui->difficultyComboBox->currentData().toInt());
+}
 
-    std::vector< std::string > result;
-    std::string tmp = s;
+void ScoreBoard::readLegacy() {
+    reader_ = std::thread([this]() {
+        long malformed = 0;
+        long read = LegacyScores::read(legacy_,
+                                       [this](const std::vector<
+                                                ScoreStore::Score >& scores) {
+            QMetaObject::invokeMethod(this, [this, scores]() {
+                addScores(scores);
+            }, Qt::QueuedConnection);
+            return !closing_;
+        }, &malformed);
+
+        if ( read < 0 ) return;
+
+        QMetaObject::invokeMethod(this, [this, malformed]() {
+            if ( malformed > 0 ) {
+                setWindowTitle(QString("Scoreboard (%1 malformed lines "
+                                       "skipped)").arg(malformed));
+            }
+        }, Qt::QueuedConnection);
+    });
+}
 
-    while ( tmp.find(delimiter) != std::string::npos ) {
-        std::string new_part = tmp.substr(0, tmp.find(delimiter));
-        tmp = tmp.substr(tmp.find(delimiter)+1, tmp.size());
+void ScoreBoard::addScores(const std::vector< ScoreStore::Score >& scores) {
+    auto better = [](const ScoreStore::Score& a, const ScoreStore::Score& b) {
+        return a.points != b.points ? a.points > b.points : a.id < b.id;
+    };
 
-        if( !(ignore_empty && new_part.empty()) ) {
-            result.push_back(new_part);
-        }
-    }
+    best_.insert(best_.end(), scores.begin(), scores.end());
 
-    if( !(ignore_empty && tmp.empty()) ) {
-        result.push_back(tmp);
-    }
+    size_t keep = std::min(best_.size(), size_t(SCOREBOARD_SIZE));
+    std::partial_sort(best_.begin(), best_.begin() + long(keep), best_.end(),
+                      better);
+    best_.resize(keep);
 
-    return result;
+    model_->setScores(best_);
 }
@@ -9,6 +9,11 @@
 #ifndef SCOREBOARD_HH
 #define SCOREBOARD_HH
 
+#include "scoremodel.hh"
+#include "scorestore.hh"
+#include <atomic>
+#include <thread>
+#include <vector>
 #include <QDialog>
 
 namespace Ui {
@@ -19,43 +24,56 @@ class ScoreBoard : public QDialog {
     Q_OBJECT
 
 public:
-    explicit ScoreBoard(std::string& filename, QWidget *parent = 0);
+    /**
+     * @brief ScoreBoard
+     * @param store: base name of the score store
+     * @param legacy: old text scoreboard, read while
+     *        the store is still empty
+     * @param parent
+     */
+    ScoreBoard(const std::string& store, const std::string& legacy,
+               QWidget *parent = 0);
     ~ScoreBoard();
 
 private:
-    struct entry_ {
-        QString name;
-        int score;
-        int min;
-        int s;
-    };
-
     Ui::ScoreBoard *ui;
-    /**
-     * @brief compareScores
-     * @param a
-     * @param b
-     * @return true if a's score is larger than b's
-     */
-    static bool compareScores(const entry_ &a, const entry_ &b);
     /**
      * @brief readFile
-     * read file and fill scoreboard
+     * Point the list at the store, the model reads
+     * the scores as they are scrolled to
      */
     void readFile();
     /**
-     * @brief Splits a string to pieces by given delimeter
-     * @param string s: string to split
-     * @param char delimiter
-     * @param bool ignore_empty:  wheter to ignore empty
-     *        substring (default false)
-     * @return vector of the pieces
+     * @brief applyFilter
+     * Show only the scores matching the name
+     * and difficulty selected in the dialog
      */
-    std::vector< std::string > split(const std::string &s,
-                                     const char delimiter,
-                                     bool ignore_empty = false);
+    void applyFilter();
+    /**
+     * @brief readLegacy
+     * Parse the old text scoreboard on a worker
+     * thread, the list fills in as it goes
+     */
+    void readLegacy();
+    /**
+     * @brief addScores
+     * @param scores: next batch from the worker
+     * Keep the best of the scores so far and show them
+     */
+    void addScores(const std::vector< ScoreStore::Score >& scores);
+
+    ScoreStore store_;
+    ScoreModel* model_;
+    std::string legacy_;
+
+    // Legacy reader and a flag telling it to stop early
+    std::thread reader_;
+    std::atomic< bool > closing_{ false };
+    // Best legacy scores read so far
+    std::vector< ScoreStore::Score > best_;
 
-    std::string filename_;
+    // How many of the best scores to list
+    const int SCOREBOARD_SIZE = 100;
 };
 
 #endif // SCOREBOARD_HH
@@ -0,0 +1,148 @@
+/*
+ * Scoreboard -model
+ * Pages scores in from the score store as
+ * the view scrolls and formats only the
+ * rows that are shown
+ *
+ * Timi Rautamäki, 284032
+ *
+ */
+
+#include "scoremodel.hh"
+#include "engine.hh"
+
+namespace {
+
+const char* difficultyName(int difficulty) {
+    switch ( difficulty ) {
+    case Engine::EASY:
+        return "easy";
+    case Engine::MEDIUM:
+        return "medium";
+    case Engine::INSANE:
+        return "insane";
+    }
+    return nullptr;
+}
+
+}
+
+ScoreModel::ScoreModel(ScoreStore& store, QObject* parent) :
+    QAbstractListModel(parent),
+    store_(store) {
+}
+
+int ScoreModel::rowCount(const QModelIndex& parent) const {
+    if ( parent.isValid() ) return 0;
+
+    return int(rows_.size());
+}
+
+QVariant ScoreModel::data(const QModelIndex& index, int role) const {
+    if ( role != Qt::DisplayRole || !index.isValid() ||
+         index.row() >= int(rows_.size()) ) {
+        return QVariant();
+    }
+
+    const ScoreStore::Score& e = rows_.at(size_t(index.row()));
+    long rank = ranks_.at(size_t(index.row()));
+
+    QString entry = QString("%1. %2 %3 points in %4 min and %5 s.")
+                    .arg(QString::number(rank))
+                    .arg(QString::fromStdString(e.name).leftJustified(20, ' '))
+                    .arg(QString::number(e.points))
+                    .arg(QString::number(e.seconds / 60))
+                    .arg(QString::number(e.seconds % 60));
+
+    if ( const char* difficulty = difficultyName(e.difficulty) ) {
+        entry += QString(" (%1)").arg(difficulty);
+    }
+
+    return entry;
+}
+
+bool ScoreModel::canFetchMore(const QModelIndex& parent) const {
+    return !parent.isValid() && !exhausted_;
+}
+
+void ScoreModel::fetchMore(const QModelIndex& parent) {
+    if ( parent.isValid() || exhausted_ ) return;
+
+    std::vector< ScoreStore::Score > page;
+
+    if ( !name_.empty() ) {
+        // The name index finds one player's scores directly
+        for ( ScoreStore::Score& e : store_.byName(name_) ) {
+            if ( difficulty_ == ANY_DIFFICULTY || e.difficulty == difficulty_ ) {
+                page.push_back(std::move(e));
+            }
+        }
+        exhausted_ = true;
+    } else {
+        // Walk down the leaderboard until a page worth of matches
+        for ( int p = 0; p < MAX_PAGES_PER_FETCH &&
+                         int(page.size()) < PAGE_SIZE; ++p ) {
+            std::vector< ScoreStore::Score > scores =
+                    store_.top(PAGE_SIZE, scanned_);
+            scanned_ += long(scores.size());
+
+            if ( scores.empty() ) {
+                exhausted_ = true;
+                break;
+            }
+
+            for ( ScoreStore::Score& e : scores ) {
+                if ( difficulty_ == ANY_DIFFICULTY ||
+                     e.difficulty == difficulty_ ) {
+                    page.push_back(std::move(e));
+                }
+            }
+        }
+    }
+
+    if ( page.empty() ) return;
+
+    // Every row shows its place on the whole leaderboard and equal
+    // points share the place of the first of them. Unfiltered rows
+    // are the leaderboard itself, filtered ones look their place up.
+    bool filtered = !name_.empty() || difficulty_ != ANY_DIFFICULTY;
+    int first = int(rows_.size());
+    for ( size_t i = 0; i < page.size(); ++i ) {
+        const ScoreStore::Score* previous =
+                i > 0 ? &page[i - 1] : rows_.empty() ? nullptr : &rows_.back();
+        if ( previous != nullptr && previous->points == page[i].points ) {
+            ranks_.push_back(ranks_.back());
+        } else if ( !filtered ) {
+            ranks_.push_back(first + long(i) + 1);
+        } else {
+            ranks_.push_back(store_.rank(page[i].points));
+        }
+    }
+
+    beginInsertRows(QModelIndex(), first, first + int(page.size()) - 1);
+    rows_.insert(rows_.end(), page.begin(), page.end());
+    endInsertRows();
+}
+
+void ScoreModel::setFilter(const std::string& name, int difficulty) {
+    beginResetModel();
+    rows_.clear();
+    ranks_.clear();
+    scanned_ = 0;
+    exhausted_ = false;
+    name_ = name;
+    difficulty_ = difficulty;
+    endResetModel();
+}
+
+void ScoreModel::setScores(const std::vector< ScoreStore::Score >& scores) {
+    beginResetModel();
+    rows_ = scores;
+    ranks_.clear();
+    for ( size_t i = 0; i < rows_.size(); ++i ) {
+        bool tie = i > 0 && rows_[i].points == rows_[i - 1].points;
+        ranks_.push_back(tie ? ranks_.back() : long(i) + 1);
+    }
+    exhausted_ = true;
+    endResetModel();
+}
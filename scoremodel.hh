@@ -0,0 +1,72 @@
+/*
+ * Scoreboard -model
+ * Pages scores in from the score store as
+ * the view scrolls and formats only the
+ * rows that are shown
+ *
+ * Timi Rautamäki, 284032
+ *
+ */
+
+#ifndef SCOREMODEL_HH
+#define SCOREMODEL_HH
+
+#include "scorestore.hh"
+#include <QAbstractListModel>
+
+class ScoreModel : public QAbstractListModel {
+    Q_OBJECT
+
+public:
+    // Difficulty filter that lets every score through
+    static const int ANY_DIFFICULTY = -1;
+
+    /**
+     * @brief ScoreModel
+     * @param store: open store to read from, must outlive the model
+     * @param parent
+     */
+    explicit ScoreModel(ScoreStore& store, QObject* parent = nullptr);
+
+    int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex& index,
+                  int role = Qt::DisplayRole) const override;
+    bool canFetchMore(const QModelIndex& parent) const override;
+    void fetchMore(const QModelIndex& parent) override;
+
+    /**
+     * @brief setFilter
+     * @param name: exact player name, empty for everybody
+     * @param difficulty: Engine::DIFFICULTY or ANY_DIFFICULTY
+     */
+    void setFilter(const std::string& name, int difficulty);
+    /**
+     * @brief setScores
+     * @param scores: best first
+     * Show a fixed list instead of the store,
+     * used while the store is still empty
+     */
+    void setScores(const std::vector< ScoreStore::Score >& scores);
+
+private:
+    ScoreStore& store_;
+
+    // Scores fetched so far, in display order, and the place
+    // each one shows, found once when it is fetched. Equal
+    // points share a place on every list.
+    std::vector< ScoreStore::Score > rows_;
+    std::vector< long > ranks_;
+    // Position in the store's best-first order read so far
+    long scanned_ = 0;
+    bool exhausted_ = false;
+
+    std::string name_;
+    int difficulty_ = ANY_DIFFICULTY;
+
+    // Scores read from the store per page and the most
+    // pages one fetch reads looking for filtered matches
+    static const int PAGE_SIZE = 100;
+    static const int MAX_PAGES_PER_FETCH = 20;
+};
+
+#endif // SCOREMODEL_HH
@@ -0,0 +1,765 @@
+/*
+ * Tetris -game
+ * Leaderboard storage. Scores go to an append
+ * log, sorted indexes over the log answer
+ * queries without reading all of it
+ *
+ * Timi Rautamäki, 284032
+ *
+ */
+
+#include "scorestore.hh"
+#include "legacyscores.hh"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// Every file starts with this. 'count' is the number of
+// log records an index covers, unused in the log itself.
+struct FileHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t count;
+    uint32_t record_size;
+};
+
+const uint32_t VERSION = 1;
+const char LOG_MAGIC[] = "TLOG";
+const char INDEX_MAGIC[] = "TIDX";
+const char NAMES_MAGIC[] = "TNAM";
+const char JOURNAL_MAGIC[] = "TJNL";
+const char IMPORT_MAGIC[] = "TIMP";
+
+// Marks the import of the old scoreboard. Written before the
+// imported scores are appended, and again once they are safe.
+struct ImportMarker {
+    char magic[4];
+    uint32_t version;
+    uint32_t done;
+    // Log records before the imported ones and their number
+    uint32_t base;
+    uint32_t count;
+};
+
+const long HEADER_SIZE = sizeof(FileHeader);
+
+// Unindexed scores kept before compacting. Grows with the
+// store so compaction stays cheap per score, but is capped
+// so opening the store reads a bounded amount.
+const size_t MIN_TAIL = 256;
+const size_t MAX_TAIL = 4096;
+const long TAIL_FRACTION = 16;
+
+bool readAt(std::ifstream& file, long offset, void* out, size_t size) {
+    file.clear();
+    file.seekg(offset);
+    file.read(static_cast< char* >(out), std::streamsize(size));
+    return bool(file);
+}
+
+bool readHeader(std::ifstream& file, const char* magic, uint32_t record_size,
+                FileHeader& header) {
+    return readAt(file, 0, &header, sizeof(header)) &&
+           std::memcmp(header.magic, magic, 4) == 0 &&
+           header.version == VERSION &&
+           header.record_size == record_size;
+}
+
+long fileSize(std::ifstream& file) {
+    file.clear();
+    file.seekg(0, std::ios_base::end);
+    return long(file.tellg());
+}
+
+uint32_t checksum(const void* data, size_t size) {
+    // FNV-1a
+    const uint8_t* bytes = static_cast< const uint8_t* >(data);
+    uint32_t hash = 2166136261u;
+    for ( size_t i = 0; i < size; ++i ) {
+        hash ^= bytes[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// Writes at 'offset' and waits until the data is on the disk.
+// Without fsync on Windows the data is only handed to the system.
+bool writeSynced(const std::string& path, long offset, const void* data,
+                 size_t size, bool truncate = false) {
+#ifndef _WIN32
+    int fd = ::open(path.c_str(),
+                    O_WRONLY | O_CREAT | (truncate ? O_TRUNC : 0), 0644);
+    if ( fd < 0 ) return false;
+
+    const char* bytes = static_cast< const char* >(data);
+    size_t done = 0;
+    bool ok = true;
+    while ( done < size ) {
+        ssize_t n = ::pwrite(fd, bytes + done, size - done,
+                             off_t(offset) + off_t(done));
+        if ( n < 0 && errno == EINTR ) continue;
+        if ( n <= 0 ) {
+            ok = false;
+            break;
+        }
+        done += size_t(n);
+    }
+    ok = ok && ::fsync(fd) == 0;
+    return ::close(fd) == 0 && ok;
+#else
+    std::ios_base::openmode mode = std::ios_base::binary | std::ios_base::out;
+    if ( !truncate && std::ifstream(path) ) {
+        mode |= std::ios_base::in;
+    }
+    std::fstream file(path, mode);
+    file.seekp(offset);
+    file.write(static_cast< const char* >(data), std::streamsize(size));
+    return bool(file.flush());
+#endif
+}
+
+bool truncateSynced(const std::string& path) {
+    return writeSynced(path, 0, nullptr, 0, true);
+}
+
+// Holds the lock file of a store while alive. Other processes wait
+// for it, so their appends and compactions never interleave. There
+// is no flock on Windows, one process per store is assumed there.
+class FileLock {
+public:
+    explicit FileLock(const std::string& path) {
+#ifndef _WIN32
+        fd_ = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+        while ( fd_ >= 0 && ::flock(fd_, LOCK_EX) != 0 ) {
+            if ( errno != EINTR ) {
+                ::close(fd_);
+                fd_ = -1;
+            }
+        }
+#else
+        (void)path;
+        fd_ = 0;
+#endif
+    }
+
+    ~FileLock() {
+#ifndef _WIN32
+        // Closing lets go of the lock
+        if ( fd_ >= 0 ) {
+            ::close(fd_);
+        }
+#endif
+    }
+
+    FileLock(const FileLock&) = delete;
+    FileLock& operator=(const FileLock&) = delete;
+
+    bool locked() const { return fd_ >= 0; }
+
+private:
+    int fd_ = -1;
+};
+
+// Writes a whole file next to its final name and then moves
+// it over the old one, so a crash leaves the old file intact
+bool replaceSynced(const std::string& path, const void* data, size_t size) {
+    std::string tmp = path + ".tmp";
+    if ( !writeSynced(tmp, 0, data, size, true) ) {
+        return false;
+    }
+
+    if ( std::rename(tmp.c_str(), path.c_str()) != 0 ) {
+        // Renaming over an existing file fails on some platforms
+        std::remove(path.c_str());
+        return std::rename(tmp.c_str(), path.c_str()) == 0;
+    }
+    return true;
+}
+
+template< typename T >
+bool writeIndex(const std::string& path, const char* magic, uint32_t count,
+                const std::vector< T >& entries) {
+    FileHeader header = { {}, VERSION, count, uint32_t(sizeof(T)) };
+    std::memcpy(header.magic, magic, 4);
+
+    std::string file(reinterpret_cast< const char* >(&header), sizeof(header));
+    file.append(reinterpret_cast< const char* >(entries.data()),
+                entries.size() * sizeof(T));
+    return replaceSynced(path, file.data(), file.size());
+}
+
+bool readMarker(const std::string& path, ImportMarker& marker) {
+    std::ifstream file(path, std::ios_base::binary);
+    return readAt(file, 0, &marker, sizeof(marker)) &&
+           std::memcmp(marker.magic, IMPORT_MAGIC, 4) == 0 &&
+           marker.version == VERSION;
+}
+
+bool writeMarker(const std::string& path, bool done, long base, size_t count) {
+    ImportMarker marker = { {}, VERSION, done, uint32_t(base),
+                            uint32_t(count) };
+    std::memcpy(marker.magic, IMPORT_MAGIC, 4);
+    return replaceSynced(path, &marker, sizeof(marker));
+}
+
+template< typename T >
+bool readIndex(const std::string& path, long count,
+               std::vector< T >& entries) {
+    entries.resize(size_t(count));
+    if ( count == 0 ) return true;
+
+    std::ifstream file(path, std::ios_base::binary);
+    return readAt(file, HEADER_SIZE, entries.data(), entries.size() * sizeof(T));
+}
+
+bool nameBefore(uint32_t hash_a, uint32_t id_a, uint32_t hash_b,
+                uint32_t id_b) {
+    return hash_a != hash_b ? hash_a < hash_b : id_a < id_b;
+}
+
+}
+
+ScoreStore::ScoreStore(const std::string& path) :
+    log_path_(path + ".log"),
+    index_path_(path + ".idx"),
+    names_path_(path + ".nam"),
+    journal_path_(path + ".jnl"),
+    lock_path_(path + ".lck"),
+    import_path_(path + ".imp") {
+}
+
+bool ScoreStore::exists() const {
+    return bool(std::ifstream(log_path_));
+}
+
+bool ScoreStore::imported() const {
+    ImportMarker marker;
+    return readMarker(import_path_, marker) && marker.done;
+}
+
+bool ScoreStore::open() {
+    FileLock lock(lock_path_);
+    if ( !lock.locked() ) return false;
+
+    if ( !exists() ) {
+        std::ofstream file(log_path_, std::ios_base::binary);
+        FileHeader header = { {}, VERSION, 0, uint32_t(sizeof(Record)) };
+        std::memcpy(header.magic, LOG_MAGIC, 4);
+        file.write(reinterpret_cast< const char* >(&header), sizeof(header));
+        if ( !file.flush() ) {
+            return false;
+        }
+    }
+
+    return recoverJournal() && load();
+}
+
+bool ScoreStore::openReadOnly() {
+    if ( !exists() ) {
+        count_ = 0;
+        indexed_ = 0;
+        tail_.clear();
+        return true;
+    }
+
+    // An append cut short stays in the journal for the next writer
+    return load();
+}
+
+bool ScoreStore::load() {
+    std::ifstream log(log_path_, std::ios_base::binary);
+    FileHeader header;
+    if ( !readHeader(log, LOG_MAGIC, sizeof(Record), header) ) {
+        return false;
+    }
+
+    // A record cut short by a crash is overwritten by the next append
+    count_ = (fileSize(log) - HEADER_SIZE) / long(sizeof(Record));
+
+    // Both indexes are written by the same compaction, if they
+    // disagree everything is read from the log again
+    std::ifstream index(index_path_, std::ios_base::binary);
+    std::ifstream names(names_path_, std::ios_base::binary);
+    FileHeader index_header;
+    FileHeader names_header;
+    indexed_ = 0;
+    if ( readHeader(index, INDEX_MAGIC, sizeof(ScoreKey), index_header) &&
+         readHeader(names, NAMES_MAGIC, sizeof(NameKey), names_header) &&
+         index_header.count == names_header.count &&
+         long(index_header.count) <= count_ ) {
+        indexed_ = index_header.count;
+    }
+
+    tail_.clear();
+    std::vector< Record > records(size_t(count_ - indexed_));
+    if ( !records.empty() &&
+         !readAt(log, HEADER_SIZE + indexed_ * long(sizeof(Record)),
+                 records.data(), records.size() * sizeof(Record)) ) {
+        return false;
+    }
+
+    for ( size_t i = 0; i < records.size(); ++i ) {
+        tail_.push_back({ { records[i].points, uint32_t(indexed_ + long(i)) },
+                          records[i] });
+    }
+    std::sort(tail_.begin(), tail_.end(),
+              [](const TailEntry& a, const TailEntry& b) {
+        return before(a.key, b.key);
+    });
+
+    return true;
+}
+
+bool ScoreStore::append(const Score& score) {
+    return append(std::vector< Score >{ score });
+}
+
+bool ScoreStore::append(const std::vector< Score >& scores) {
+    std::vector< Record > records;
+    for ( const Score& score : scores ) {
+        records.push_back(makeRecord(score));
+    }
+
+    FileLock lock(lock_path_);
+    if ( !lock.locked() || !appendRecords(records) ) {
+        return false;
+    }
+
+    // The scores are safe already, a compaction that fails
+    // is tried again by the next append
+    size_t limit = std::max(MIN_TAIL, size_t(indexed_ / TAIL_FRACTION));
+    if ( tail_.size() >= std::min(limit, MAX_TAIL) ) {
+        compactLocked();
+    }
+    return true;
+}
+
+void ScoreStore::addToTail(const Record& record, uint32_t id) {
+    TailEntry entry = { { record.points, id }, record };
+    auto position = std::upper_bound(tail_.begin(), tail_.end(), entry,
+                                     [](const TailEntry& a,
+                                        const TailEntry& b) {
+        return before(a.key, b.key);
+    });
+    tail_.insert(position, entry);
+}
+
+bool ScoreStore::compact() {
+    FileLock lock(lock_path_);
+    return lock.locked() && sync() && compactLocked();
+}
+
+bool ScoreStore::compactLocked() {
+    if ( tail_.empty() ) return true;
+
+    std::vector< ScoreKey > keys;
+    std::vector< NameKey > names;
+    if ( !readIndex(index_path_, indexed_, keys) ||
+         !readIndex(names_path_, indexed_, names) ) {
+        return false;
+    }
+
+    std::vector< ScoreKey > tail_keys;
+    std::vector< NameKey > tail_names;
+    for ( const TailEntry& t : tail_ ) {
+        tail_keys.push_back(t.key);
+        tail_names.push_back({ hashName(t.record.name, t.record.name_length),
+                               t.key.id });
+    }
+
+    auto name_order = [](const NameKey& a, const NameKey& b) {
+        return nameBefore(a.hash, a.id, b.hash, b.id);
+    };
+    std::sort(tail_names.begin(), tail_names.end(), name_order);
+
+    std::vector< ScoreKey > merged_keys(keys.size() + tail_keys.size());
+    std::merge(keys.begin(), keys.end(), tail_keys.begin(), tail_keys.end(),
+               merged_keys.begin(), before);
+
+    std::vector< NameKey > merged_names(names.size() + tail_names.size());
+    std::merge(names.begin(), names.end(),
+               tail_names.begin(), tail_names.end(),
+               merged_names.begin(), name_order);
+
+    // The score index decides what is indexed, write it last
+    uint32_t count = uint32_t(merged_keys.size());
+    if ( !writeIndex(names_path_, NAMES_MAGIC, count, merged_names) ||
+         !writeIndex(index_path_, INDEX_MAGIC, count, merged_keys) ) {
+        return false;
+    }
+
+    indexed_ = count;
+    tail_.clear();
+    return true;
+}
+
+std::vector< ScoreStore::Score > ScoreStore::top(int count,
+                                                 long offset) const {
+    std::vector< Score > result;
+    if ( count <= 0 || offset < 0 || offset >= count_ ) return result;
+
+    std::ifstream index(index_path_, std::ios_base::binary);
+    std::ifstream log(log_path_, std::ios_base::binary);
+
+    long n = indexed_;
+    long m = long(tail_.size());
+
+    // Find how many of the first 'offset' scores come from the tail.
+    // The tail is small, this reads O(log tail) index entries.
+    long low = std::max(0L, offset - n);
+    long high = std::min(m, offset);
+    while ( low < high ) {
+        long t = (low + high) / 2;
+        long i = offset - t;
+
+        ScoreKey last_indexed;
+        if ( i > 0 && readScoreKey(index, i - 1, last_indexed) &&
+             before(tail_[size_t(t)].key, last_indexed) ) {
+            low = t + 1;
+        } else {
+            high = t;
+        }
+    }
+    long t = low;
+    long i = offset - t;
+
+    // Read the index entries that can be needed in one go
+    long wanted = std::min(long(count), n - i);
+    std::vector< ScoreKey > keys(size_t(std::max(0L, wanted)));
+    if ( !keys.empty() &&
+         !readAt(index, HEADER_SIZE + i * long(sizeof(ScoreKey)),
+                 keys.data(), keys.size() * sizeof(ScoreKey)) ) {
+        return result;
+    }
+
+    size_t k = 0;
+    while ( int(result.size()) < count &&
+            (k < keys.size() || t < m) ) {
+        if ( t < m && (k >= keys.size() ||
+                       before(tail_[size_t(t)].key, keys[k])) ) {
+            const TailEntry& e = tail_[size_t(t++)];
+            result.push_back(makeScore(e.record, e.key.id));
+        } else {
+            Record record;
+            if ( !readRecord(log, keys[k].id, record) ) break;
+            result.push_back(makeScore(record, keys[k++].id));
+        }
+    }
+
+    return result;
+}
+
+long ScoreStore::rank(int points) const {
+    std::ifstream index(index_path_, std::ios_base::binary);
+
+    long better = countBetter(index, points);
+    for ( const TailEntry& t : tail_ ) {
+        if ( t.key.points <= points ) break;
+        ++better;
+    }
+
+    return better + 1;
+}
+
+std::vector< ScoreStore::Score > ScoreStore::byName(
+        const std::string& name) const {
+    std::vector< Score > result;
+
+    Record wanted = makeRecord({ name, 0, 0, 0, 0 });
+    std::string key(wanted.name, wanted.name_length);
+    uint32_t hash = hashName(wanted.name, wanted.name_length);
+
+    std::ifstream names(names_path_, std::ios_base::binary);
+    std::ifstream log(log_path_, std::ios_base::binary);
+
+    // First entry with the hash
+    long low = 0;
+    long high = indexed_;
+    while ( low < high ) {
+        long middle = (low + high) / 2;
+        NameKey entry;
+        if ( !readAt(names, HEADER_SIZE + middle * long(sizeof(NameKey)),
+                     &entry, sizeof(entry)) ) {
+            return result;
+        }
+        if ( entry.hash < hash ) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    // Names that only share the hash are filtered out here
+    for ( long p = low; p < indexed_; ++p ) {
+        NameKey entry;
+        if ( !readAt(names, HEADER_SIZE + p * long(sizeof(NameKey)),
+                     &entry, sizeof(entry)) || entry.hash != hash ) {
+            break;
+        }
+
+        Record record;
+        if ( readRecord(log, entry.id, record) &&
+             key.compare(0, std::string::npos,
+                         record.name, record.name_length) == 0 ) {
+            result.push_back(makeScore(record, entry.id));
+        }
+    }
+
+    for ( const TailEntry& t : tail_ ) {
+        if ( key.compare(0, std::string::npos,
+                         t.record.name, t.record.name_length) == 0 ) {
+            result.push_back(makeScore(t.record, t.key.id));
+        }
+    }
+
+    std::sort(result.begin(), result.end(),
+              [](const Score& a, const Score& b) {
+        return before({ a.points, a.id }, { b.points, b.id });
+    });
+
+    return result;
+}
+
+long ScoreStore::importLegacy(const std::string& filename, long* malformed) {
+    // No old scoreboard is an import with nothing to import
+    std::vector< Record > records;
+    if ( std::ifstream(filename) ) {
+        long read = LegacyScores::read(filename,
+                                       [&](const std::vector< Score >& scores) {
+            for ( const Score& score : scores ) {
+                records.push_back(makeRecord(score));
+            }
+            return true;
+        }, malformed);
+
+        if ( read < 0 ) return -1;
+    }
+
+    FileLock lock(lock_path_);
+    if ( !lock.locked() || !recoverJournal() || !sync() ) {
+        return -1;
+    }
+
+    // Another process may have imported them meanwhile
+    ImportMarker marker;
+    bool started = readMarker(import_path_, marker);
+    if ( started && marker.done ) {
+        return 0;
+    }
+
+    // An import cut short after the append is only marked done,
+    // otherwise the scores would be in the log twice
+    long base = started ? long(marker.base) : count_;
+    if ( !started || marker.count != records.size() ||
+         !logHolds(marker.base, records) ) {
+        base = count_;
+        if ( !writeMarker(import_path_, false, base, records.size()) ||
+             !appendRecords(records) ) {
+            return -1;
+        }
+    }
+
+    // The scores are safe once appended, a compaction
+    // that fails is tried again by the next append
+    compactLocked();
+    if ( !writeMarker(import_path_, true, base, records.size()) ) {
+        return -1;
+    }
+    return long(records.size());
+}
+
+bool ScoreStore::logHolds(uint32_t base,
+                          const std::vector< Record >& records) const {
+    if ( long(base) + long(records.size()) > count_ ) return false;
+    if ( records.empty() ) return true;
+
+    std::ifstream log(log_path_, std::ios_base::binary);
+    std::vector< Record > logged(records.size());
+    return readAt(log, HEADER_SIZE + long(base) * long(sizeof(Record)),
+                  logged.data(), logged.size() * sizeof(Record)) &&
+           std::memcmp(logged.data(), records.data(),
+                       records.size() * sizeof(Record)) == 0;
+}
+
+bool ScoreStore::before(const ScoreKey& a, const ScoreKey& b) {
+    return a.points != b.points ? a.points > b.points : a.id < b.id;
+}
+
+uint32_t ScoreStore::hashName(const char* name, size_t length) {
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    for ( size_t i = 0; i < length; ++i ) {
+        hash ^= uint8_t(name[i]);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+ScoreStore::Record ScoreStore::makeRecord(const Score& score) {
+    Record record;
+    std::memset(&record, 0, sizeof(record));
+
+    record.points = score.points;
+    record.seconds = score.seconds;
+    record.difficulty = uint8_t(score.difficulty);
+
+    // Cut long names without splitting a UTF-8 character
+    size_t length = std::min(score.name.size(), size_t(NAME_LENGTH));
+    while ( length > 0 && length < score.name.size() &&
+            (uint8_t(score.name[length]) & 0xc0) == 0x80 ) {
+        --length;
+    }
+
+    record.name_length = uint8_t(length);
+    std::memcpy(record.name, score.name.data(), length);
+
+    return record;
+}
+
+ScoreStore::Score ScoreStore::makeScore(const Record& record, uint32_t id) {
+    return { std::string(record.name, record.name_length),
+             record.points, record.seconds, record.difficulty, id };
+}
+
+bool ScoreStore::sync() {
+    std::ifstream log(log_path_, std::ios_base::binary);
+    std::ifstream index(index_path_, std::ios_base::binary);
+
+    FileHeader header;
+    long count = (fileSize(log) - HEADER_SIZE) / long(sizeof(Record));
+    long indexed = readHeader(index, INDEX_MAGIC, sizeof(ScoreKey), header)
+            ? long(header.count) : 0;
+    if ( count == count_ && indexed == indexed_ ) {
+        return true;
+    }
+    return load();
+}
+
+bool ScoreStore::recoverJournal() {
+    std::ifstream journal(journal_path_, std::ios_base::binary);
+    JournalHeader header;
+    if ( !readAt(journal, 0, &header, sizeof(header)) ) {
+        // No journal or one cut short before the log was touched
+        return true;
+    }
+
+    std::vector< Record > records;
+    if ( std::memcmp(header.magic, JOURNAL_MAGIC, 4) == 0 &&
+         header.version == VERSION && header.record_size == sizeof(Record) ) {
+        records.resize(header.count);
+    }
+    if ( records.empty() ||
+         !readAt(journal, sizeof(header), records.data(),
+                 records.size() * sizeof(Record)) ||
+         checksum(records.data(), records.size() * sizeof(Record)) !=
+         header.checksum ) {
+        return truncateSynced(journal_path_);
+    }
+
+    // Records found at 'base' made it to the log before the crash.
+    // The rest were lost or written over by another process.
+    std::ifstream log(log_path_, std::ios_base::binary);
+    long count = (fileSize(log) - HEADER_SIZE) / long(sizeof(Record));
+    size_t written = 0;
+    while ( written < records.size() &&
+            long(header.base + written) < count ) {
+        Record record;
+        if ( !readRecord(log, uint32_t(header.base + written), record) ||
+             std::memcmp(&record, &records[written], sizeof(record)) != 0 ) {
+            break;
+        }
+        ++written;
+    }
+
+    if ( written < records.size() &&
+         !writeSynced(log_path_, HEADER_SIZE + count * long(sizeof(Record)),
+                      records.data() + written,
+                      (records.size() - written) * sizeof(Record)) ) {
+        return false;
+    }
+    return truncateSynced(journal_path_);
+}
+
+bool ScoreStore::appendRecords(const std::vector< Record >& records) {
+    if ( records.empty() ) return true;
+    if ( !recoverJournal() || !sync() ) return false;
+
+    size_t size = records.size() * sizeof(Record);
+    JournalHeader header = { {}, VERSION, uint32_t(records.size()),
+                             uint32_t(sizeof(Record)), uint32_t(count_),
+                             checksum(records.data(), size) };
+    std::memcpy(header.magic, JOURNAL_MAGIC, 4);
+
+    std::string journal(reinterpret_cast< const char* >(&header),
+                        sizeof(header));
+    journal.append(reinterpret_cast< const char* >(records.data()), size);
+    if ( !writeSynced(journal_path_, 0, journal.data(), journal.size(),
+                      true) ) {
+        return false;
+    }
+
+    // Safe from here on. If the log can't be written now
+    // the next append or open moves the journal into it.
+    if ( !writeSynced(log_path_, HEADER_SIZE + count_ * long(sizeof(Record)),
+                      records.data(), size) ) {
+        return true;
+    }
+    // A journal left behind matches the log and is dropped later
+    truncateSynced(journal_path_);
+
+    long first_id = count_;
+    count_ += long(records.size());
+    if ( records.size() == 1 ) {
+        addToTail(records.front(), uint32_t(first_id));
+        return true;
+    }
+
+    for ( size_t i = 0; i < records.size(); ++i ) {
+        tail_.push_back({ { records[i].points, uint32_t(first_id + long(i)) },
+                          records[i] });
+    }
+    std::sort(tail_.begin(), tail_.end(),
+              [](const TailEntry& a, const TailEntry& b) {
+        return before(a.key, b.key);
+    });
+    return true;
+}
+
+bool ScoreStore::readRecord(std::ifstream& log, uint32_t id,
+                            Record& record) {
+    return readAt(log, HEADER_SIZE + long(id) * long(sizeof(Record)),
+                  &record, sizeof(record));
+}
+
+bool ScoreStore::readScoreKey(std::ifstream& index, long position,
+                              ScoreKey& key) {
+    return readAt(index, HEADER_SIZE + position * long(sizeof(ScoreKey)),
+                  &key, sizeof(key));
+}
+
+long ScoreStore::countBetter(std::ifstream& index, int points) const {
+    // Index is best first, find the first entry not above 'points'
+    long low = 0;
+    long high = indexed_;
+    while ( low < high ) {
+        long middle = (low + high) / 2;
+        ScoreKey key;
+        if ( !readScoreKey(index, middle, key) ) break;
+
+        if ( key.points > points ) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
@@ -0,0 +1,264 @@
+/*
+ * Tetris -game
+ * Leaderboard storage. Scores go to an append
+ * log, sorted indexes over the log answer
+ * queries without reading all of it
+ *
+ * Timi Rautamäki, 284032
+ *
+ */
+
+#ifndef SCORESTORE_HH
+#define SCORESTORE_HH
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+class ScoreStore {
+public:
+    // Longest name kept, in bytes
+    static const int NAME_LENGTH = 38;
+    // Difficulty of scores imported from the old text format
+    static const int UNKNOWN_DIFFICULTY = 255;
+
+    struct Score {
+        std::string name;
+        int points;
+        // Length of the game
+        int seconds;
+        // Engine::DIFFICULTY or UNKNOWN_DIFFICULTY
+        int difficulty;
+        // Position in the log, later scores have larger ids
+        uint32_t id;
+    };
+
+    /**
+     * @brief ScoreStore
+     * @param path: base name, the store uses path.log,
+     *        path.idx and path.nam, path.jnl for appends in
+     *        progress, path.lck to take turns with other
+     *        processes using the same store and path.imp
+     *        once the old scoreboard is imported
+     */
+    explicit ScoreStore(const std::string& path);
+
+    /**
+     * @brief exists
+     * @return true if the log has been created
+     */
+    bool exists() const;
+    /**
+     * @brief open
+     * @return false if the log can't be created or read
+     * Create the log if needed and load the scores
+     * that are not in the indexes yet
+     */
+    bool open();
+    /**
+     * @brief openReadOnly
+     * @return false if the log can't be read
+     * Load the scores without creating or writing any
+     * file, a missing log is an empty store
+     */
+    bool openReadOnly();
+    /**
+     * @brief imported
+     * @return true once importLegacy() has finished
+     */
+    bool imported() const;
+    /**
+     * @brief append
+     * @param score: score to add, its id is ignored
+     * @return false on write errors
+     */
+    bool append(const Score& score);
+    /**
+     * @brief append
+     * @param scores: scores to add in one write, ids are ignored
+     * @return false if the scores didn't reach the disk. Once
+     *         true they survive a crash or power loss, at worst
+     *         in the journal until the store is next written.
+     */
+    bool append(const std::vector< Score >& scores);
+    /**
+     * @brief compact
+     * @return false on write errors
+     * Merge the unindexed scores into the indexes
+     */
+    bool compact();
+
+    /**
+     * @brief size
+     * @return number of scores
+     */
+    long size() const { return count_; }
+    /**
+     * @brief top
+     * @param count: number of scores wanted
+     * @param offset: number of better scores to skip
+     * @return scores from best to worst, ties by age
+     */
+    std::vector< Score > top(int count, long offset = 0) const;
+    /**
+     * @brief rank
+     * @param points: score to look up
+     * @return 1-based place a score of 'points' would get
+     */
+    long rank(int points) const;
+    /**
+     * @brief byName
+     * @param name: player name
+     * @return scores of the player from best to worst
+     */
+    std::vector< Score > byName(const std::string& name) const;
+
+    /**
+     * @brief importLegacy
+     * @param filename: colon separated name:min:s:points lines
+     * @param malformed: filled with the number of skipped lines
+     * @return number of scores imported, -1 if the file can't be
+     *         read or the scores not written. A missing file imports
+     *         nothing, and once done the import isn't repeated.
+     */
+    long importLegacy(const std::string& filename,
+                      long* malformed = nullptr);
+
+private:
+    // Fixed size log record, the id is the record number
+    struct Record {
+        int32_t points;
+        int32_t seconds;
+        uint8_t difficulty;
+        uint8_t name_length;
+        char name[NAME_LENGTH];
+    };
+
+    // Entry of the score index, best first
+    struct ScoreKey {
+        int32_t points;
+        uint32_t id;
+    };
+
+    // Entry of the name index, ordered by hash and id
+    struct NameKey {
+        uint32_t hash;
+        uint32_t id;
+    };
+
+    /**
+     * @brief before
+     * @return true if 'a' ranks above 'b'
+     */
+    static bool before(const ScoreKey& a, const ScoreKey& b);
+    static uint32_t hashName(const char* name, size_t length);
+    static Record makeRecord(const Score& score);
+    static Score makeScore(const Record& record, uint32_t id);
+
+    // Written before the records go to the log. A crash while
+    // appending leaves the records here and the next writer
+    // finishes the append.
+    struct JournalHeader {
+        char magic[4];
+        uint32_t version;
+        uint32_t count;
+        uint32_t record_size;
+        // Log records when the journal was written
+        uint32_t base;
+        // FNV-1a of the records
+        uint32_t checksum;
+    };
+
+    /**
+     * @brief load
+     * @return false on read errors
+     * Read the log and index sizes and the unindexed scores
+     */
+    bool load();
+    /**
+     * @brief sync
+     * @return false on read errors
+     * Load again if another process has written the store.
+     * Called with the store locked.
+     */
+    bool sync();
+    /**
+     * @brief recoverJournal
+     * @return false on write errors
+     * Finish an append cut short by a crash. Called with
+     * the store locked.
+     */
+    bool recoverJournal();
+    /**
+     * @brief appendRecords
+     * @param records: records to write at the end of the log
+     * @return false if the records didn't reach the disk
+     * Journal, log and tail are updated in turn. Called
+     * with the store locked.
+     */
+    bool appendRecords(const std::vector< Record >& records);
+    /**
+     * @brief compactLocked
+     * @return false on write errors
+     * compact() with the store locked
+     */
+    bool compactLocked();
+    /**
+     * @brief logHolds
+     * @param base: record number of the first record
+     * @param records: records to look for
+     * @return true if the log has 'records' from 'base' on
+     */
+    bool logHolds(uint32_t base, const std::vector< Record >& records) const;
+    /**
+     * @brief addToTail
+     * @param record: record just written to the log
+     * @param id: its record number
+     */
+    void addToTail(const Record& record, uint32_t id);
+    /**
+     * @brief readRecord
+     * @param log: open log file
+     * @param id: record number
+     * @param record: filled from the log
+     * @return false on read errors
+     */
+    static bool readRecord(std::ifstream& log, uint32_t id, Record& record);
+    /**
+     * @brief readScoreKey
+     * @param index: open score index
+     * @param position: position in the index
+     * @param key: filled from the index
+     * @return false on read errors
+     */
+    static bool readScoreKey(std::ifstream& index, long position,
+                             ScoreKey& key);
+    /**
+     * @brief countBetter
+     * @param index: open score index
+     * @param points: score to compare to
+     * @return number of indexed scores above 'points'
+     */
+    long countBetter(std::ifstream& index, int points) const;
+
+    std::string log_path_;
+    std::string index_path_;
+    std::string names_path_;
+    std::string journal_path_;
+    std::string lock_path_;
+    std::string import_path_;
+
+    // Records in the log and how many of them are indexed
+    long count_ = 0;
+    long indexed_ = 0;
+
+    // Records after the indexed ones, sorted like the index
+    struct TailEntry {
+        ScoreKey key;
+        Record record;
+    };
+    std::vector< TailEntry > tail_;
+};
+
+#endif // SCORESTORE_HH
@@ -0,0 +1,101 @@
+/*
+ * Tetris -game
+ * Writes scores to the store on a thread of its
+ * own so a slow disk never holds up the game
+ *
+ * Timi Rautamäki, 284032
+ *
+ */
+
+#include "scorewriter.hh"
+#include "trace.hh"
+
+ScoreWriter::ScoreWriter(ScoreStore& store) :
+    store_(store) {
+}
+
+ScoreWriter::~ScoreWriter() {
+    if ( !thread_.joinable() ) return;
+
+    {
+        std::lock_guard< std::mutex > lock(mutex_);
+        stop_ = true;
+    }
+    wake_.notify_all();
+    thread_.join();
+}
+
+void ScoreWriter::start(const std::function< void(ScoreStore&) >& setup) {
+    if ( thread_.joinable() ) return;
+    thread_ = std::thread(&ScoreWriter::run, this, setup);
+}
+
+void ScoreWriter::submit(const ScoreStore::Score& score) {
+    {
+        std::lock_guard< std::mutex > lock(mutex_);
+        if ( queue_.empty() ) {
+            oldest_ = Clock::now();
+        }
+        queue_.push_back(score);
+        ++submitted_;
+    }
+    wake_.notify_all();
+}
+
+bool ScoreWriter::flush() {
+    std::unique_lock< std::mutex > lock(mutex_);
+    if ( !thread_.joinable() ) {
+        return queue_.empty();
+    }
+
+    long wanted = submitted_;
+    flushing_ = true;
+    wake_.notify_all();
+    written_.wait(lock, [&]() {
+        return done_ >= wanted || failed_ || stop_;
+    });
+    flushing_ = false;
+
+    bool ok = !failed_ && done_ >= wanted;
+    failed_ = false;
+    return ok;
+}
+
+void ScoreWriter::run(std::function< void(ScoreStore&) > setup) {
+    if ( setup ) {
+        setup(store_);
+    }
+
+    std::unique_lock< std::mutex > lock(mutex_);
+    while ( true ) {
+        wake_.wait(lock, [&]() { return !queue_.empty() || stop_; });
+        if ( queue_.empty() ) break;
+
+        // Scores arriving meanwhile share the write and its fsyncs
+        wake_.wait_until(lock, oldest_ + std::chrono::milliseconds(MAX_DELAY_MS),
+                         [&]() { return stop_ || flushing_; });
+
+        std::vector< ScoreStore::Score > batch;
+        batch.swap(queue_);
+        lock.unlock();
+        bool ok = store_.append(batch);
+        Trace::record< Trace::STORE >(Trace::SCORES, int32_t(batch.size()), ok);
+        lock.lock();
+
+        if ( ok ) {
+            done_ += long(batch.size());
+        } else {
+            // Nothing reached the disk. Keep the scores and try
+            // again later, or give up on them when stopping.
+            failed_ = true;
+            if ( stop_ ) {
+                done_ += long(batch.size());
+            } else {
+                batch.insert(batch.end(), queue_.begin(), queue_.end());
+                queue_.swap(batch);
+                oldest_ = Clock::now();
+            }
+        }
+        written_.notify_all();
+    }
+}
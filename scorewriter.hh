@@ -0,0 +1,83 @@
+/*
+ * Tetris -game
+ * Writes scores to the store on a thread of its
+ * own so a slow disk never holds up the game
+ *
+ * Timi Rautamäki, 284032
+ *
+ */
+
+#ifndef SCOREWRITER_HH
+#define SCOREWRITER_HH
+
+#include "scorestore.hh"
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ScoreWriter {
+public:
+    // Longest a score waits for others to share its write
+    static const int MAX_DELAY_MS = 200;
+
+    /**
+     * @brief ScoreWriter
+     * @param store: store to write to. Once started only
+     *        the writer thread touches it.
+     */
+    explicit ScoreWriter(ScoreStore& store);
+    /**
+     * @brief ~ScoreWriter
+     * Writes what is queued and stops the thread
+     */
+    ~ScoreWriter();
+    ScoreWriter(const ScoreWriter&) = delete;
+    ScoreWriter& operator=(const ScoreWriter&) = delete;
+
+    /**
+     * @brief start
+     * @param setup: run on the writer thread before any
+     *        score is written, e.g. to open the store
+     */
+    void start(const std::function< void(ScoreStore&) >& setup);
+    /**
+     * @brief submit
+     * @param score: score to append, returns at once
+     */
+    void submit(const ScoreStore::Score& score);
+    /**
+     * @brief flush
+     * @return false if a write has failed since the last flush
+     * Wait until every submitted score is on the disk or a
+     * write fails. Failed scores are tried again later.
+     */
+    bool flush();
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    void run(std::function< void(ScoreStore&) > setup);
+
+    ScoreStore& store_;
+    std::thread thread_;
+
+    std::mutex mutex_;
+    // New scores, a flush or the end
+    std::condition_variable wake_;
+    // A batch was written
+    std::condition_variable written_;
+
+    std::vector< ScoreStore::Score > queue_;
+    // When the oldest queued score was submitted
+    Clock::time_point oldest_;
+    long submitted_ = 0;
+    long done_ = 0;
+    bool flushing_ = false;
+    bool failed_ = false;
+    bool stop_ = false;
+};
+
+#endif // SCOREWRITER_HH
@@ -0,0 +1,561 @@
+/*
+ * Tetris -game
+ * Headless simulator. Plays games through
+ * the engine on all cores as fast as the CPU
+ * allows and reports the results
+ *
+ * Timi Rautamäki, 284032
+ *
+ */
+
+#include "aiplayer.hh"
+#include "batch.hh"
+#include "engine.hh"
+#include "replay.hh"
+#include "versus.hh"
+#include "wideboard.hh"
+#include <chrono>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+
+namespace {
+
+/**
+ * @brief playGame
+ * @param seed: seed of the game
+ * @param difficulty: starting difficulty
+ * @param ai: plays with the computer player instead of randomly
+ * @param max_pieces: ends the game after this many tetrominos
+ * @return result of the game
+ * Play one game to the end. The random player places every
+ * tetromino with a random rotation and column and drops it.
+ * The play time is what the gravity would have taken to
+ * bring the tetromino down on the difficulty curve of the
+ * real game.
+ */
+Batch::GameResult playGame(unsigned seed, int difficulty, bool ai,
+                           long max_pieces) {
+    const Engine::DIFFICULTY_CONSTANTS& constants =
+            Engine::DIFFICULTIES[difficulty];
+
+    Engine engine;
+    std::minstd_rand player(seed);
+    engine.reset(seed, constants.points);
+
+    // Search buffers are big, one player per thread
+    static thread_local AiPlayer ai_player;
+    std::vector< int > inputs;
+
+    int speed = constants.speed;
+    long time_ms = 0;
+    long next_step_ms = Engine::DIFFICULTY_INTERVAL * 1000L;
+
+    while ( !engine.gameOver() && engine.pieces() < max_pieces ) {
+        int start_y = engine.piece().y;
+
+        if ( ai ) {
+            ai_player.plan(engine, inputs);
+            for ( int input : inputs ) {
+                engine.step(input);
+            }
+        } else {
+            int rotations = player() % 4;
+            int shift = int(player() % Engine::COLUMNS) - Engine::COLUMNS / 2;
+
+            for ( int i = 0; i < rotations; ++i ) {
+                engine.step(Engine::ROTATE);
+            }
+            for ( int i = 0; i < std::abs(shift); ++i ) {
+                engine.step(shift < 0 ? Engine::LEFT : Engine::RIGHT);
+            }
+            engine.step(Engine::DROP);
+        }
+
+        // One tick per row on the way down and one to lock
+        time_ms += long(engine.piece().y - start_y + 1) * speed;
+        while ( time_ms >= next_step_ms ) {
+            if ( speed > Engine::MAX_DIFFICULTY ) {
+                speed -= Engine::DIFFICULTY_STEP;
+            }
+            next_step_ms += Engine::DIFFICULTY_INTERVAL * 1000L;
+        }
+
+        // Gravity locks the tetromino that is already down
+        engine.step(Engine::TICK);
+    }
+
+    return { engine.points(), engine.pieces(), engine.lines(), time_ms };
+}
+
+/**
+ * @brief landing
+ * @param o: orientation
+ * @param x: x coordinate of the 4*4 box
+ * @param heights: first taken row of every column
+ * @param holes: set to the free cells left under the tetromino
+ * @return y coordinate of the 4*4 box where a drop stops
+ */
+int landing(const Tetrominos::Orientation& o, int x,
+            const std::vector< int >& heights, int& holes) {
+    int y = INT_MAX;
+    for ( int c = o.min_x; c <= o.max_x; ++c ) {
+        y = std::min(y, heights[size_t(x + c)] - 1 - o.bottom[c]);
+    }
+
+    holes = 0;
+    for ( int c = o.min_x; c <= o.max_x; ++c ) {
+        holes += heights[size_t(x + c)] - 1 - o.bottom[c] - y;
+    }
+    return y;
+}
+
+/**
+ * @brief playWideGame
+ * @param seed: seed of the game
+ * @param difficulty: starting difficulty
+ * @param columns: board width, up to WideBoard::MAX_COLUMNS
+ * @param rows: board height, up to WideBoard::MAX_ROWS
+ * @param max_pieces: ends the game after this many tetrominos
+ * @return result of the game
+ * Play one game on a WideBoard for load tests on fields far
+ * larger than the game's. Random tetrominos go where they leave
+ * the fewest holes, lowest first, as found from the column
+ * heights. Random columns would never fill a wide row. The
+ * tetromino is then dropped row by row from the top, locked
+ * and the full rows are cleared. The game is over when the
+ * tetromino does not fit at the top.
+ */
+Batch::GameResult playWideGame(unsigned seed, int difficulty, int columns,
+                               int rows, long max_pieces) {
+    const Engine::DIFFICULTY_CONSTANTS& constants =
+            Engine::DIFFICULTIES[difficulty];
+
+    WideBoard board(columns, rows);
+    std::vector< int > heights(size_t(columns), rows);
+    std::minstd_rand player(seed);
+
+    int points = 0;
+    long pieces = 0;
+    long lines = 0;
+    int speed = constants.speed;
+    long time_ms = 0;
+    long next_step_ms = Engine::DIFFICULTY_INTERVAL * 1000L;
+
+    while ( pieces < max_pieces ) {
+        int kind = int(player() % Tetrominos::NUMBER_OF_TETROMINOS);
+
+        // Ties go to the first found from a random column on
+        const Tetrominos::Orientation* best = nullptr;
+        int best_x = 0;
+        int best_bottom = 0;
+        int best_holes = 0;
+        int start = int(player() % unsigned(columns));
+        for ( int rotation = 0; rotation < 4; ++rotation ) {
+            const Tetrominos::Orientation& o =
+                    Tetrominos::orientation(kind, rotation);
+            int span = columns - (o.max_x - o.min_x);
+            for ( int i = 0; i < span; ++i ) {
+                int x = (start + i) % span - o.min_x;
+                int holes = 0;
+                int bottom = landing(o, x, heights, holes) + o.max_y;
+                if ( best == nullptr || holes < best_holes ||
+                     (holes == best_holes && bottom > best_bottom) ) {
+                    best = &o;
+                    best_x = x;
+                    best_bottom = bottom;
+                    best_holes = holes;
+                }
+            }
+        }
+
+        const Tetrominos::Orientation& o = *best;
+        int x = best_x;
+        int y = -o.min_y;
+        if ( !board.fits(o, x, y) ) break;
+        while ( board.fits(o, x, y + 1) ) {
+            ++y;
+        }
+
+        for ( int py = o.min_y; py <= o.max_y; ++py ) {
+            for ( int px = o.min_x; px <= o.max_x; ++px ) {
+                if ( Tetrominos::filled(o, px, py) ) {
+                    board.set(x + px, y + py);
+                    int& height = heights[size_t(x + px)];
+                    height = std::min(height, y + py);
+                }
+            }
+        }
+
+        int cleared = board.clearFullRows(y + o.min_y, y + o.max_y);
+        if ( cleared > 0 ) {
+            // Every column reached the cleared rows, the rows
+            // above them moved down by at least that many
+            for ( int c = 0; c < columns; ++c ) {
+                int& height = heights[size_t(c)];
+                height += cleared;
+                while ( height < rows && !board.occupied(c, height) ) {
+                    ++height;
+                }
+            }
+        }
+
+        ++pieces;
+        lines += cleared;
+        points += cleared * constants.points;
+
+        // One tick per row on the way down and one to lock
+        time_ms += long(y + o.min_y + 1) * speed;
+        while ( time_ms >= next_step_ms ) {
+            if ( speed > Engine::MAX_DIFFICULTY ) {
+                speed -= Engine::DIFFICULTY_STEP;
+            }
+            next_step_ms += Engine::DIFFICULTY_INTERVAL * 1000L;
+        }
+    }
+
+    return { points, pieces, lines, time_ms };
+}
+
+template< typename T >
+T percentile(const std::vector< T >& sorted, int p) {
+    if ( sorted.empty() ) return T();
+
+    return sorted.at((sorted.size() - 1) * size_t(p) / 100);
+}
+
+template< typename T >
+void printDistribution(const char* name, const std::vector< T >& sorted) {
+    std::string label = std::string(name) + ":";
+    label.resize(16, ' ');
+
+    std::cout << label
+              << "p10 " << percentile(sorted, 10)
+              << "  p50 " << percentile(sorted, 50)
+              << "  p90 " << percentile(sorted, 90)
+              << "  p99 " << percentile(sorted, 99)
+              << "  max " << percentile(sorted, 100) << "\n";
+}
+
+/**
+ * @brief runReplay
+ * @param filename: replay to re-simulate
+ * @return process exit code
+ */
+int runReplay(const char* filename) {
+    Replay replay;
+    if ( !replay.load(filename) ) {
+        std::cerr << "Error reading replay " << filename << std::endl;
+        return 1;
+    }
+
+    Engine engine;
+    long inputs = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    bool verified = replay.run(engine, &inputs);
+    std::chrono::duration< double > elapsed =
+            std::chrono::steady_clock::now() - start;
+
+    std::cout << "seed:           " << replay.seed() << "\n"
+              << "bytes:          " << replay.data().size() << "\n"
+              << "inputs:         " << inputs << "\n"
+              << "pieces:         " << engine.pieces() << "\n"
+              << "lines:          " << engine.lines() << "\n"
+              << "points:         " << engine.points() << "\n"
+              << "seconds:        " << elapsed.count() << "\n"
+              << "verified:       " << (verified ? "yes" : "NO") << std::endl;
+
+    return verified ? 0 : 2;
+}
+
+// One side of a versus game, played by the computer
+struct VersusSide {
+    std::unique_ptr< Versus > session;
+    AiPlayer ai;
+    std::vector< int > inputs;
+    size_t next = 0;
+    long planned_piece = 0;
+
+    /**
+     * @brief play
+     * Give the next planned input, planning when a
+     * new tetromino has appeared
+     */
+    void play() {
+        const Engine& game = session->game(session->player());
+        if ( game.pieces() != planned_piece ) {
+            planned_piece = game.pieces();
+            next = 0;
+            if ( !ai.plan(game, inputs) ) inputs.clear();
+        }
+        if ( next < inputs.size() ) {
+            session->input(inputs[next++]);
+        }
+    }
+};
+
+/**
+ * @brief getDifficulty
+ * @param name: easy, medium or insane
+ * @param difficulty: filled with the Engine::DIFFICULTY
+ * @return false for unknown names
+ */
+bool getDifficulty(const std::string& name, int& difficulty) {
+    if ( name == "easy" ) {
+        difficulty = Engine::EASY;
+    } else if ( name == "medium" ) {
+        difficulty = Engine::MEDIUM;
+    } else if ( name == "insane" ) {
+        difficulty = Engine::INSANE;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief runVersus
+ * @param argc: arguments after --versus
+ * @param argv: arguments after --versus
+ * @return process exit code
+ * Two computer players against each other. Over the loopback
+ * both sides run here in lockstep on simulated time and their
+ * confirmed states are compared every frame. With --udp this
+ * process is one side and another process the other.
+ */
+int runVersus(int argc, char* argv[]);
+
+int usage() {
+    std::cerr << "usage: tetris-sim [games] [seed] [--threads n]"
+                 " [--difficulty easy|medium|insane]\n"
+              << "                  [--ai | --wide WxH] [--pieces max]\n"
+              << "       tetris-sim --replay file\n"
+              << "       tetris-sim --versus [seed] [--frames n]"
+                 " [--difficulty easy|medium|insane]\n"
+              << "                  [--delay ms] [--jitter ms] [--loss p]"
+                 " [--udp port remote_port player]" << std::endl;
+    return 1;
+}
+
+int runVersus(int argc, char* argv[]) {
+    unsigned seed = 1;
+    long frames = 20000;
+    int difficulty = Engine::INSANE;
+    int delay = 40;
+    int jitter = 30;
+    double loss = 0.05;
+    int port = 0;
+    int remote_port = 0;
+    int player = -1;
+
+    for ( int i = 0; i < argc; ++i ) {
+        std::string arg = argv[i];
+
+        if ( arg == "--frames" && i + 1 < argc ) {
+            frames = std::atol(argv[++i]);
+        } else if ( arg == "--difficulty" && i + 1 < argc ) {
+            if ( !getDifficulty(argv[++i], difficulty) ) return usage();
+        } else if ( arg == "--delay" && i + 1 < argc ) {
+            delay = std::atoi(argv[++i]);
+        } else if ( arg == "--jitter" && i + 1 < argc ) {
+            jitter = std::atoi(argv[++i]);
+        } else if ( arg == "--loss" && i + 1 < argc ) {
+            loss = std::atof(argv[++i]);
+        } else if ( arg == "--udp" && i + 3 < argc ) {
+            port = std::atoi(argv[++i]);
+            remote_port = std::atoi(argv[++i]);
+            player = std::atoi(argv[++i]);
+        } else if ( arg[0] != '-' ) {
+            seed = unsigned(std::atol(argv[i]));
+        } else {
+            return usage();
+        }
+    }
+
+    using Clock = std::chrono::steady_clock;
+    Loopback loopback(delay, jitter, loss, seed);
+    UdpLink udp;
+
+    int sides = 2;
+    if ( player >= 0 ) {
+        if ( player > 1 || !udp.open(port, remote_port) ) {
+            std::cerr << "Error opening UDP port " << port << std::endl;
+            return 1;
+        }
+        sides = 1;
+    }
+
+    std::vector< VersusSide > versus(static_cast< size_t >(sides));
+    for ( int i = 0; i < sides; ++i ) {
+        int p = sides == 1 ? player : i;
+        Link& link = sides == 1 ? static_cast< Link& >(udp)
+                                : loopback.end(p);
+        versus[size_t(i)].session.reset(
+                    new Versus(p, seed, difficulty, link));
+        // Not quite equal players, or every game is a draw
+        versus[size_t(i)].ai.setLookahead(p == 0);
+    }
+
+    long stalls = 0;
+    long desyncs = 0;
+    double slowest_us = 0;
+    double total_us = 0;
+    long advances = 0;
+
+    auto start = Clock::now();
+    // Keep going after the end until both sides agree on it
+    long extra = Versus::MAX_ROLLBACK * 4;
+    for ( long n = 0; n < frames + extra; ++n ) {
+        loopback.setTime(n * Versus::FRAME_US / 1000);
+
+        bool done = true;
+        for ( VersusSide& side : versus ) {
+            if ( n < frames && side.session->finished() == Versus::PLAYING ) {
+                side.play();
+            }
+
+            auto before = Clock::now();
+            stalls += !side.session->advance();
+            std::chrono::duration< double, std::micro > took =
+                    Clock::now() - before;
+            slowest_us = std::max(slowest_us, took.count());
+            total_us += took.count();
+            ++advances;
+
+            done = done && side.session->finished() != Versus::PLAYING &&
+                   side.session->confirmed() >= side.session->frame();
+        }
+
+        if ( sides == 2 ) {
+            long common = std::min(versus[0].session->confirmed(),
+                                   versus[1].session->confirmed());
+            uint64_t a = versus[0].session->checksum(common);
+            uint64_t b = versus[1].session->checksum(common);
+            desyncs += a != 0 && b != 0 && a != b;
+        } else {
+            // Real time against the other process
+            std::this_thread::sleep_until(
+                        start + std::chrono::microseconds(
+                            (n + 1) * Versus::FRAME_US));
+        }
+
+        if ( done && n >= Versus::MAX_ROLLBACK ) break;
+    }
+
+    const Versus& v = *versus[0].session;
+    int winner = v.finished();
+    std::cout << "frames:         " << v.frame() << "\n"
+              << "winner:         "
+              << (winner == Versus::PLAYING ? std::string("none")
+                  : winner == Versus::DRAW ? std::string("draw")
+                  : "player " + std::to_string(winner)) << "\n"
+              << "points:         " << v.game(0).points() << " - "
+              << v.game(1).points() << "\n"
+              << "rollbacks:      " << v.rollbacks() << "\n"
+              << "resimulated:    " << v.resimulated() << "\n"
+              << "deepest:        " << v.deepestRollback() << "\n"
+              << "stalls:         " << stalls << "\n"
+              << "advance us:     mean " << total_us / std::max(advances, 1L)
+              << "  max " << slowest_us << "\n";
+    if ( sides == 2 ) {
+        std::cout << "packets:        " << loopback.sent() << " sent, "
+                  << loopback.dropped() << " dropped\n"
+                  << "desyncs:        " << desyncs << "\n";
+    }
+    std::cout << std::flush;
+
+    return desyncs == 0 ? 0 : 2;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    if ( argc > 2 && std::strcmp(argv[1], "--replay") == 0 ) {
+        return runReplay(argv[2]);
+    }
+    if ( argc > 1 && std::strcmp(argv[1], "--versus") == 0 ) {
+        return runVersus(argc - 2, argv + 2);
+    }
+
+    long games = 100000;
+    unsigned seed = 1;
+    int threads = 0;
+    int difficulty = Engine::MEDIUM;
+    bool ai = false;
+    // The computer player can go on for ever
+    long max_pieces = 100000;
+    // Board size of --wide, 0 plays the game's own field
+    int wide_columns = 0;
+    int wide_rows = 0;
+    int positional = 0;
+
+    for ( int i = 1; i < argc; ++i ) {
+        std::string arg = argv[i];
+
+        if ( arg == "--ai" ) {
+            ai = true;
+        } else if ( arg == "--pieces" && i + 1 < argc ) {
+            max_pieces = std::atol(argv[++i]);
+        } else if ( arg == "--threads" && i + 1 < argc ) {
+            threads = std::atoi(argv[++i]);
+        } else if ( arg == "--difficulty" && i + 1 < argc ) {
+            if ( !getDifficulty(argv[++i], difficulty) ) return usage();
+        } else if ( arg == "--wide" && i + 1 < argc ) {
+            std::string size = argv[++i];
+            size_t split = size.find('x');
+            if ( split == std::string::npos ) return usage();
+            wide_columns = std::atoi(size.substr(0, split).c_str());
+            wide_rows = std::atoi(size.substr(split + 1).c_str());
+            if ( wide_columns < 4 || wide_columns > WideBoard::MAX_COLUMNS ||
+                 wide_rows < 4 || wide_rows > WideBoard::MAX_ROWS ) {
+                return usage();
+            }
+        } else if ( positional == 0 ) {
+            games = std::atol(argv[i]);
+            ++positional;
+        } else if ( positional == 1 ) {
+            seed = unsigned(std::atol(argv[i]));
+            ++positional;
+        } else {
+            return usage();
+        }
+    }
+
+    if ( games <= 0 || threads < 0 || max_pieces <= 0 ||
+         (ai && wide_columns > 0) ) {
+        return usage();
+    }
+
+    Batch::Report r = Batch::run(games, seed, threads,
+                                 [=](unsigned game_seed) {
+        if ( wide_columns > 0 ) {
+            return playWideGame(game_seed, difficulty, wide_columns,
+                                wide_rows, max_pieces);
+        }
+        return playGame(game_seed, difficulty, ai, max_pieces);
+    });
+
+    double s = r.seconds;
+
+    std::cout << "games:          " << r.games << "\n"
+              << "threads:        " << r.threads << "\n"
+              << "pieces:         " << r.pieces << "\n"
+              << "lines:          " << r.lines << "\n"
+              << "seconds:        " << s << "\n"
+              << "games/second:   " << r.games / s << "\n"
+              << "pieces/second:  " << r.pieces / s << "\n"
+              << "lines/second:   " << r.lines / s << "\n";
+
+    printDistribution("points", r.points);
+    printDistribution("survival ms", r.time_ms);
+    printDistribution("lines/game", r.lines_per_game);
+    std::cout << std::flush;
+
+    return 0;
+}
@@ -0,0 +1,134 @@
+/*
+ * Tetris -game
+ * Snapshot of the game in progress
+ *
+ * Timi Rautamäki, 284032
+ *
+ */
+
+#include "snapshot.hh"
+#include <cstddef>
+#include <cstring>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+const char MAGIC[4] = { 'T', 'S', 'N', 'P' };
+
+}
+
+Snapshot::Snapshot(const std::string& path) :
+    path_(path) {
+}
+
+Snapshot::~Snapshot() {
+#ifndef _WIN32
+    if ( file_ != nullptr ) {
+        ::munmap(file_, sizeof(File));
+    }
+#endif
+}
+
+bool Snapshot::open() {
+#ifndef _WIN32
+    if ( file_ != nullptr ) return true;
+
+    int fd = ::open(path_.c_str(), O_RDWR | O_CREAT, 0644);
+    if ( fd < 0 ) return false;
+
+    struct stat info;
+    bool sized = ::fstat(fd, &info) == 0 &&
+            ( info.st_size == off_t(sizeof(File)) ||
+              ::ftruncate(fd, sizeof(File)) == 0 );
+    void* mapping = sized ? ::mmap(nullptr, sizeof(File),
+                                   PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)
+                          : MAP_FAILED;
+    // The mapping stays valid without the descriptor
+    ::close(fd);
+    if ( mapping == MAP_FAILED ) return false;
+    file_ = static_cast< File* >(mapping);
+
+    Header& header = file_->header;
+    if ( std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 ||
+         header.version != VERSION || header.slot_size != sizeof(Slot) ||
+         header.columns != Board::COLUMNS || header.rows != Board::ROWS ) {
+        // New file or one of another build, nothing to resume
+        std::memset(file_, 0, sizeof(File));
+        std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+        header.version = VERSION;
+        header.slot_size = sizeof(Slot);
+        header.columns = Board::COLUMNS;
+        header.rows = Board::ROWS;
+    }
+
+    int slot = latest();
+    sequence_ = slot < 0 ? 0 : file_->slots[slot].sequence;
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool Snapshot::load(Game& game) const {
+    if ( file_ == nullptr ) return false;
+
+    int slot = latest();
+    if ( slot < 0 ) return false;
+    game = file_->slots[slot].game;
+    return true;
+}
+
+void Snapshot::save(const Game& game) {
+    if ( file_ == nullptr ) return;
+
+    // Built aside and copied in one go, the slot being
+    // replaced is the older one
+    Slot slot;
+    std::memset(&slot, 0, sizeof(slot));
+    slot.sequence = ++sequence_;
+    std::memcpy(&slot.game, &game, sizeof(game));
+    slot.checksum = checksum(slot);
+    std::memcpy(&file_->slots[sequence_ % 2], &slot, sizeof(slot));
+}
+
+void Snapshot::clear() {
+    if ( file_ == nullptr ) return;
+
+    for ( Slot& slot : file_->slots ) {
+        slot.sequence = 0;
+        slot.checksum = 0;
+    }
+}
+
+uint32_t Snapshot::checksum(const Slot& slot) {
+    const uint8_t* bytes = reinterpret_cast< const uint8_t* >(&slot);
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    for ( size_t i = 0; i < sizeof(Slot); ++i ) {
+        if ( i == offsetof(Slot, checksum) ) {
+            i += sizeof(slot.checksum) - 1;
+            continue;
+        }
+        hash ^= bytes[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+int Snapshot::latest() const {
+    int best = -1;
+    for ( int i = 0; i < 2; ++i ) {
+        const Slot& slot = file_->slots[i];
+        if ( slot.sequence == 0 || slot.checksum != checksum(slot) ) continue;
+        if ( best < 0 || slot.sequence > file_->slots[best].sequence ) {
+            best = i;
+        }
+    }
+    return best;
+}
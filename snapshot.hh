@@ -0,0 +1,117 @@
+/*
+ * Tetris -game
+ * Snapshot of the game in progress, kept in a
+ * memory mapped file so a restarted or crashed
+ * window can carry on where play stopped
+ *
+ * Timi Rautamäki, 284032
+ *
+ */
+
+#ifndef SNAPSHOT_HH
+#define SNAPSHOT_HH
+
+#include "engine.hh"
+#include <cstdint>
+#include <string>
+
+// The file is a header and two slots written in turn. A slot holds
+// a sequence number, a checksum and the game, the valid slot with
+// the larger sequence number is the latest game. A save torn by a
+// crash fails its checksum and the other slot is used.
+class Snapshot {
+public:
+    static const uint32_t VERSION = 1;
+    // Longest name kept, in bytes
+    static const int NAME_LENGTH = 38;
+
+    // The game as MainWindow runs it
+    struct Game {
+        Engine::State engine;
+        uint32_t seed;
+        // Engine::DIFFICULTY the game was started on
+        int32_t level;
+        // Gravity delay in ms
+        int32_t difficulty;
+        int32_t seconds;
+        // Game time not simulated yet in ms
+        int32_t accumulator;
+        uint8_t ai;
+        uint8_t name_length;
+        char name[NAME_LENGTH];
+    };
+
+    /**
+     * @brief Snapshot
+     * @param path: file to keep the snapshot in
+     */
+    explicit Snapshot(const std::string& path);
+    ~Snapshot();
+    Snapshot(const Snapshot&) = delete;
+    Snapshot& operator=(const Snapshot&) = delete;
+
+    /**
+     * @brief open
+     * @return false if the file can't be created or mapped
+     * A file of another version or field size is started over
+     */
+    bool open();
+    bool isOpen() const { return file_ != nullptr; }
+
+    /**
+     * @brief load
+     * @param game: filled with the latest game
+     * @return false if there is no game to resume
+     */
+    bool load(Game& game) const;
+    /**
+     * @brief save
+     * @param game: game to keep, a copy into the mapping
+     *        without any system calls
+     */
+    void save(const Game& game);
+    /**
+     * @brief clear
+     * Forget the game, e.g. once it is over
+     */
+    void clear();
+
+private:
+    struct Header {
+        char magic[4];
+        uint32_t version;
+        uint32_t slot_size;
+        uint16_t columns;
+        uint16_t rows;
+    };
+
+    struct Slot {
+        uint64_t sequence;
+        uint32_t checksum;
+        uint32_t reserved;
+        Game game;
+    };
+
+    struct File {
+        Header header;
+        Slot slots[2];
+    };
+
+    /**
+     * @brief checksum
+     * @return FNV-1a of the slot without its checksum
+     */
+    static uint32_t checksum(const Slot& slot);
+    /**
+     * @brief latest
+     * @return index of the valid slot with the larger
+     *         sequence number, -1 if neither is valid
+     */
+    int latest() const;
+
+    std::string path_;
+    File* file_ = nullptr;
+    uint64_t sequence_ = 0;
+};
+
+#endif // SNAPSHOT_HH
@@ -0,0 +1,397 @@
+/*
+ * Tetris -game
+ * Live stream of a game for spectators
+ *
+ * Timi Rautamäki, 284032
+ *
+ */
+
+#include "spectator.hh"
+#include "varint.hh"
+#include <cerrno>
+#include <cstring>
+
+#ifndef _WIN32
+#include <csignal>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#else
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+namespace {
+
+const char MAGIC[3] = { 'T', 'S', 'P' };
+const std::string UNIX_PREFIX = "unix:";
+
+uint32_t zigzag(int value) {
+    return (uint32_t(value) << 1) ^ uint32_t(value >> 31);
+}
+
+int unzigzag(uint64_t value) {
+    return int(uint32_t(value) >> 1) ^ -int(value & 1);
+}
+
+void putRow(std::string& out, const Board::RowMask (&row)[4]) {
+    for ( int i = 0; i < 4; ++i ) {
+        Varint::put(out, row[i]);
+    }
+}
+
+void putPiece(std::string& out, int shape, const Engine::Pose& piece) {
+    Varint::put(out, uint64_t(shape + 1));
+    Varint::put(out, zigzag(piece.x));
+    Varint::put(out, zigzag(piece.y));
+    Varint::put(out, uint64_t(piece.rotation));
+}
+
+}
+
+SpectatorStream::~SpectatorStream() {
+    close();
+}
+
+bool SpectatorStream::open(const std::string& target) {
+    close();
+
+#ifndef _WIN32
+    if ( target.compare(0, UNIX_PREFIX.size(), UNIX_PREFIX) == 0 ) {
+        std::string path = target.substr(UNIX_PREFIX.size());
+        sockaddr_un address = {};
+        if ( path.empty() || path.size() >= sizeof(address.sun_path) ) {
+            return false;
+        }
+        address.sun_family = AF_UNIX;
+        std::memcpy(address.sun_path, path.data(), path.size());
+
+        fd_ = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if ( fd_ < 0 ) return false;
+        if ( ::connect(fd_, reinterpret_cast< sockaddr* >(&address),
+                       sizeof(address)) != 0 ) {
+            close();
+            return false;
+        }
+    } else {
+        // Non-blocking open fails on a FIFO nobody reads
+        // instead of waiting for a reader
+        fd_ = ::open(target.c_str(),
+                     O_WRONLY | O_CREAT | O_TRUNC | O_NONBLOCK, 0644);
+        if ( fd_ < 0 ) return false;
+    }
+    if ( ::fcntl(fd_, F_SETFL, ::fcntl(fd_, F_GETFL) | O_NONBLOCK) != 0 ) {
+        close();
+        return false;
+    }
+    // A reader going away must end the stream, not the game
+    std::signal(SIGPIPE, SIG_IGN);
+#else
+    if ( target.compare(0, UNIX_PREFIX.size(), UNIX_PREFIX) == 0 ) {
+        return false;
+    }
+    fd_ = ::_open(target.c_str(), _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY,
+                  _S_IREAD | _S_IWRITE);
+    if ( fd_ < 0 ) return false;
+#endif
+
+    buffer_.assign(MAGIC, sizeof(MAGIC));
+    buffer_.push_back(char(VERSION));
+    Varint::put(buffer_, Board::COLUMNS);
+    Varint::put(buffer_, Board::ROWS);
+    ends_.push_back(buffer_.size());
+    keyframe_due_ = true;
+    tick_ = 0;
+    last_tick_ = 0;
+    last_keyframe_tick_ = 0;
+    flush();
+    return isOpen();
+}
+
+void SpectatorStream::close() {
+    if ( fd_ >= 0 ) {
+#ifndef _WIN32
+        ::close(fd_);
+#else
+        ::_close(fd_);
+#endif
+    }
+    fd_ = -1;
+    buffer_.clear();
+    ends_.clear();
+    written_ = 0;
+    start_ = 0;
+}
+
+SpectatorStream::Shown SpectatorStream::capture(const Engine& engine,
+                                                int seconds) {
+    Shown shown;
+    const Board& board = engine.board();
+    for ( int y = 0; y < Board::ROWS; ++y ) {
+        Board::RowMask mask = board.row(y);
+        shown.rows[y][0] = mask;
+        for ( int bit = 0; bit < 3; ++bit ) {
+            shown.rows[y][bit + 1] = Board::RowMask(board.plane(y, bit) & mask);
+        }
+    }
+    shown.shape = engine.current() ? engine.currentShape() : -1;
+    shown.piece = shown.shape < 0 ? Engine::Pose{ 0, 0, 0 } : engine.piece();
+    shown.next = engine.nextShape();
+    shown.points = engine.points();
+    shown.seconds = seconds;
+    shown.game_over = engine.gameOver();
+    return shown;
+}
+
+void SpectatorStream::publish(const Engine& engine, int seconds) {
+    if ( !isOpen() ) return;
+    ++tick_;
+
+    Shown now = capture(engine, seconds);
+    std::string message;
+
+    if ( keyframe_due_ ||
+         tick_ - last_keyframe_tick_ >= KEYFRAME_INTERVAL ) {
+        message.push_back(char(KEYFRAME));
+        Varint::put(message, uint64_t(tick_));
+        for ( int y = 0; y < Board::ROWS; ++y ) {
+            putRow(message, now.rows[y]);
+        }
+        putPiece(message, now.shape, now.piece);
+        Varint::put(message, uint64_t(now.next));
+        Varint::put(message, zigzag(now.points));
+        Varint::put(message, uint64_t(now.seconds));
+        message.push_back(char(now.game_over));
+        keyframe_due_ = false;
+        last_keyframe_tick_ = tick_;
+    } else {
+        uint8_t changes = 0;
+        int rows = 0;
+        for ( int y = 0; y < Board::ROWS; ++y ) {
+            if ( std::memcmp(now.rows[y], shown_.rows[y],
+                             sizeof(now.rows[y])) != 0 ) {
+                ++rows;
+            }
+        }
+        if ( rows ) changes |= ROWS;
+        if ( now.shape != shown_.shape || now.piece.x != shown_.piece.x ||
+             now.piece.y != shown_.piece.y ||
+             now.piece.rotation != shown_.piece.rotation ) {
+            changes |= PIECE;
+        }
+        if ( now.next != shown_.next ) changes |= NEXT;
+        if ( now.points != shown_.points ) changes |= POINTS;
+        if ( now.seconds != shown_.seconds ) changes |= TIME;
+        if ( now.game_over != shown_.game_over ) changes |= GAME_OVER;
+        if ( !changes ) return;
+
+        message.push_back(char(DELTA));
+        Varint::put(message, uint64_t(tick_ - last_tick_));
+        message.push_back(char(changes));
+        if ( changes & ROWS ) {
+            Varint::put(message, uint64_t(rows));
+            for ( int y = 0; y < Board::ROWS; ++y ) {
+                if ( std::memcmp(now.rows[y], shown_.rows[y],
+                                 sizeof(now.rows[y])) != 0 ) {
+                    Varint::put(message, uint64_t(y));
+                    putRow(message, now.rows[y]);
+                }
+            }
+        }
+        if ( changes & PIECE ) putPiece(message, now.shape, now.piece);
+        if ( changes & NEXT ) Varint::put(message, uint64_t(now.next));
+        if ( changes & POINTS ) Varint::put(message, zigzag(now.points));
+        if ( changes & TIME ) Varint::put(message, uint64_t(now.seconds));
+        if ( changes & GAME_OVER ) message.push_back(char(now.game_over));
+    }
+
+    shown_ = now;
+    last_tick_ = tick_;
+    queue(message);
+    flush();
+}
+
+void SpectatorStream::queue(const std::string& message) {
+    if ( buffer_.size() - written_ + message.size() > MAX_BACKLOG ) {
+        // The reader is stuck. Finish the message it is in the
+        // middle of, drop the rest and start over from a keyframe.
+        size_t keep = written_ > start_ ? ends_.front() : written_;
+        buffer_.resize(keep);
+        ends_.clear();
+        if ( keep > written_ ) ends_.push_back(keep);
+        keyframe_due_ = true;
+        return;
+    }
+    Varint::put(buffer_, message.size());
+    buffer_ += message;
+    ends_.push_back(buffer_.size());
+}
+
+void SpectatorStream::flush() {
+    while ( isOpen() && written_ < buffer_.size() ) {
+#ifndef _WIN32
+        ssize_t n = ::write(fd_, buffer_.data() + written_,
+                            buffer_.size() - written_);
+#else
+        int n = ::_write(fd_, buffer_.data() + written_,
+                         unsigned(buffer_.size() - written_));
+#endif
+        if ( n > 0 ) {
+            written_ += size_t(n);
+            bytes_ += n;
+            continue;
+        }
+        if ( n < 0 && errno == EINTR ) continue;
+        if ( n < 0 && ( errno == EAGAIN || errno == EWOULDBLOCK ) ) break;
+        // Reader gone or the disk full
+        close();
+        return;
+    }
+
+    while ( !ends_.empty() && ends_.front() <= written_ ) {
+        start_ = ends_.front();
+        ends_.pop_front();
+    }
+    if ( written_ == buffer_.size() ) {
+        buffer_.clear();
+        written_ = 0;
+        start_ = 0;
+    } else if ( start_ > MAX_BACKLOG ) {
+        buffer_.erase(0, start_);
+        for ( size_t& end : ends_ ) {
+            end -= start_;
+        }
+        written_ -= start_;
+        start_ = 0;
+    }
+}
+
+bool SpectatorView::read(const std::string& data, size_t& pos) {
+    if ( !header_ ) {
+        if ( data.size() - pos < sizeof(MAGIC) + 1 ) return true;
+        if ( data.compare(pos, sizeof(MAGIC), MAGIC, sizeof(MAGIC)) != 0 ||
+             uint8_t(data[pos + sizeof(MAGIC)]) !=
+             SpectatorStream::VERSION ) {
+            return false;
+        }
+        size_t at = pos + sizeof(MAGIC) + 1;
+        uint64_t columns = 0;
+        uint64_t rows = 0;
+        if ( !Varint::get(data, at, columns) ||
+             !Varint::get(data, at, rows) ) {
+            return true;
+        }
+        if ( columns != uint64_t(Board::COLUMNS) ||
+             rows != uint64_t(Board::ROWS) ) {
+            return false;
+        }
+        header_ = true;
+        pos = at;
+    }
+
+    while ( pos < data.size() ) {
+        size_t at = pos;
+        uint64_t length = 0;
+        if ( !Varint::get(data, at, length) ||
+             data.size() - at < length ) {
+            return true;
+        }
+        if ( !apply(data.substr(at, size_t(length))) ) return false;
+        pos = at + size_t(length);
+    }
+    return true;
+}
+
+int SpectatorView::colour(int x, int y) const {
+    if ( x < 0 || x >= Board::COLUMNS || y < 0 || y >= Board::ROWS ||
+         !((rows_[y][0] >> x) & 1) ) {
+        return Board::EMPTY;
+    }
+    return  ((rows_[y][1] >> x) & 1)
+          | ((rows_[y][2] >> x) & 1) << 1
+          | ((rows_[y][3] >> x) & 1) << 2;
+}
+
+bool SpectatorView::apply(const std::string& message) {
+    if ( message.empty() ) return false;
+    size_t pos = 1;
+    uint64_t value = 0;
+
+    auto row = [&](Board::RowMask (&out)[4]) {
+        for ( int i = 0; i < 4; ++i ) {
+            if ( !Varint::get(message, pos, value) ) return false;
+            out[i] = Board::RowMask(value);
+        }
+        return true;
+    };
+    auto piece = [&]() {
+        uint64_t shape = 0, x = 0, y = 0, rotation = 0;
+        if ( !Varint::get(message, pos, shape) ||
+             !Varint::get(message, pos, x) ||
+             !Varint::get(message, pos, y) ||
+             !Varint::get(message, pos, rotation) ) {
+            return false;
+        }
+        shape_ = int(shape) - 1;
+        piece_ = { unzigzag(x), unzigzag(y), int(rotation) };
+        return true;
+    };
+    auto number = [&](int& out) {
+        if ( !Varint::get(message, pos, value) ) return false;
+        out = int(value);
+        return true;
+    };
+    auto flag = [&](bool& out) {
+        if ( pos >= message.size() ) return false;
+        out = message[pos++] != 0;
+        return true;
+    };
+
+    uint8_t type = uint8_t(message[0]);
+    if ( !Varint::get(message, pos, value) ) return false;
+
+    if ( type == SpectatorStream::KEYFRAME ) {
+        tick_ = long(value);
+        for ( int y = 0; y < Board::ROWS; ++y ) {
+            if ( !row(rows_[y]) ) return false;
+        }
+        if ( !piece() || !number(next_) ||
+             !Varint::get(message, pos, value) ) {
+            return false;
+        }
+        points_ = unzigzag(value);
+        if ( !number(seconds_) || !flag(game_over_) ) return false;
+        synced_ = true;
+        return pos == message.size();
+    }
+    if ( type != SpectatorStream::DELTA ) return false;
+    tick_ += long(value);
+    // Deltas before the first keyframe build on nothing
+    if ( !synced_ ) return true;
+
+    if ( pos >= message.size() ) return false;
+    uint8_t changes = uint8_t(message[pos++]);
+    if ( changes & SpectatorStream::ROWS ) {
+        uint64_t count = 0;
+        if ( !Varint::get(message, pos, count) ) return false;
+        for ( uint64_t i = 0; i < count; ++i ) {
+            uint64_t y = 0;
+            if ( !Varint::get(message, pos, y) ||
+                 y >= uint64_t(Board::ROWS) || !row(rows_[y]) ) {
+                return false;
+            }
+        }
+    }
+    if ( (changes & SpectatorStream::PIECE) && !piece() ) return false;
+    if ( (changes & SpectatorStream::NEXT) && !number(next_) ) return false;
+    if ( changes & SpectatorStream::POINTS ) {
+        if ( !Varint::get(message, pos, value) ) return false;
+        points_ = unzigzag(value);
+    }
+    if ( (changes & SpectatorStream::TIME) && !number(seconds_) ) return false;
+    if ( (changes & SpectatorStream::GAME_OVER) && !flag(game_over_) ) {
+        return false;
+    }
+    return pos == message.size();
+}
@@ -0,0 +1,162 @@
+/*
+ * Tetris -game
+ * Live stream of a game for spectators. Every
+ * tick only what changed is written, with a
+ * full keyframe now and then for late joiners
+ *
+ * Timi Rautamäki, 284032
+ *
+ */
+
+#ifndef SPECTATOR_HH
+#define SPECTATOR_HH
+
+#include "engine.hh"
+#include <cstdint>
+#include <deque>
+#include <string>
+
+// Stream layout, all numbers LEB128:
+//   "TSP" version columns rows
+//   then messages: length type tick ...
+// A keyframe holds every row, the active tetromino, the next one,
+// points, seconds and game over. A delta holds a byte of CHANGE
+// flags and only the parts flagged, rows as y mask plane0..2.
+class SpectatorStream {
+public:
+    static const uint8_t VERSION = 1;
+
+    enum MESSAGE { KEYFRAME = 1, DELTA = 2 };
+    enum CHANGE { ROWS = 1, PIECE = 2, NEXT = 4, POINTS = 8,
+                  TIME = 16, GAME_OVER = 32 };
+
+    // Ticks between keyframes
+    static const int KEYFRAME_INTERVAL = 300;
+    // Unsent bytes kept for a slow reader before skipping ahead
+    static const size_t MAX_BACKLOG = 64 * 1024;
+
+    SpectatorStream() = default;
+    ~SpectatorStream();
+    SpectatorStream(const SpectatorStream&) = delete;
+    SpectatorStream& operator=(const SpectatorStream&) = delete;
+
+    /**
+     * @brief open
+     * @param target: file or FIFO path, or unix:path for a
+     *        Unix domain stream socket
+     * @return false if the target can't be opened. A FIFO
+     *         needs its reader to be there already.
+     */
+    bool open(const std::string& target);
+    void close();
+    bool isOpen() const { return fd_ >= 0; }
+
+    /**
+     * @brief publish
+     * @param engine: game to show
+     * @param seconds: play time
+     * Write what changed since the last call. Never blocks,
+     * a reader that falls behind misses deltas and gets a
+     * keyframe instead.
+     */
+    void publish(const Engine& engine, int seconds);
+    /**
+     * @brief keyframe
+     * Send a keyframe on the next publish, e.g. for a new game
+     */
+    void keyframe() { keyframe_due_ = true; }
+
+    // Bytes handed to the target so far
+    long bytes() const { return bytes_; }
+
+private:
+    // What the readers have been sent
+    struct Shown {
+        Board::RowMask rows[Board::ROWS][4];
+        int shape;
+        Engine::Pose piece;
+        int next;
+        int points;
+        int seconds;
+        bool game_over;
+    };
+
+    static Shown capture(const Engine& engine, int seconds);
+    /**
+     * @brief queue
+     * @param message: message body, framed with its length
+     */
+    void queue(const std::string& message);
+    /**
+     * @brief flush
+     * Write as much of the backlog as the target takes
+     */
+    void flush();
+
+    int fd_ = -1;
+    long tick_ = 0;
+    // Tick of the last message, deltas count from it
+    long last_tick_ = 0;
+    // Tick of the last keyframe, the next one is due
+    // KEYFRAME_INTERVAL ticks after it
+    long last_keyframe_tick_ = 0;
+    bool keyframe_due_ = true;
+    Shown shown_ = {};
+
+    std::string buffer_;
+    // Bytes of buffer_ already written and the start of
+    // the message being written
+    size_t written_ = 0;
+    size_t start_ = 0;
+    // End offsets of the messages not fully written
+    std::deque< size_t > ends_;
+    long bytes_ = 0;
+};
+
+// Rebuilds the game from a spectator stream
+class SpectatorView {
+public:
+    /**
+     * @brief read
+     * @param data: stream bytes, read from 'pos' on
+     * @param pos: moved past what was read
+     * @return false if the data is not a valid stream. A message
+     *         cut off at the end is left for the next call.
+     */
+    bool read(const std::string& data, size_t& pos);
+
+    // True once a keyframe has been seen
+    bool synced() const { return synced_; }
+    long tick() const { return tick_; }
+
+    Board::RowMask row(int y) const { return rows_[y][0]; }
+    /**
+     * @brief colour
+     * @return tetromino kind of the cell or Board::EMPTY
+     */
+    int colour(int x, int y) const;
+    // Kind of the active tetromino, -1 between tetrominos
+    int shape() const { return shape_; }
+    const Engine::Pose& piece() const { return piece_; }
+    int next() const { return next_; }
+    int points() const { return points_; }
+    int seconds() const { return seconds_; }
+    bool gameOver() const { return game_over_; }
+
+private:
+    bool apply(const std::string& message);
+
+    bool header_ = false;
+    bool synced_ = false;
+    long tick_ = 0;
+
+    Board::RowMask rows_[Board::ROWS][4] = {};
+    int shape_ = -1;
+    Engine::Pose piece_ = { 0, 0, 0 };
+    int next_ = 0;
+    int points_ = 0;
+    int seconds_ = 0;
+    bool game_over_ = false;
+};
+
+#endif // SPECTATOR_HH
@@ -0,0 +1,207 @@
+/*
+ * Tetris -game
+ * Regression tests of the parts that run
+ * without Qt. Exits with the number of
+ * failed checks.
+ *
+ * Timi Rautamäki, 284032
+ *
+ */
+
+#include "inputqueue.hh"
+#include "scorestore.hh"
+#include "spectator.hh"
+#include "varint.hh"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace {
+
+int failures = 0;
+
+void check(bool ok, const char* test, const char* what) {
+    if ( !ok ) {
+        std::cout << "FAIL " << test << ": " << what << "\n";
+        ++failures;
+    }
+}
+
+// Inputs given to the engine and their times
+struct Stepped {
+    long time_ms;
+    int input;
+};
+
+InputQueue::Step recorder(std::vector< Stepped >& stepped) {
+    return [&stepped](long time, int input) {
+        stepped.push_back({ time, input });
+        return Engine::Events();
+    };
+}
+
+void inputQueueStartsOver() {
+    const char* test = "input_queue_starts_over";
+    InputQueue inputs;
+    std::vector< Stepped > stepped;
+
+    // First game ends late
+    inputs.press(Engine::ROTATE, 300000);
+    inputs.advance(300000, recorder(stepped));
+
+    // Game time of the next game starts from zero
+    stepped.clear();
+    inputs.clear();
+    inputs.press(Engine::ROTATE, 50);
+    inputs.advance(50, recorder(stepped));
+
+    check(stepped.size() == 1, test, "press after clear() was not applied");
+    check(!stepped.empty() && stepped.front().time_ms == 50, test,
+          "press after clear() was moved in time");
+}
+
+void inputQueueReleasesSoftDrop() {
+    const char* test = "input_queue_releases_soft_drop";
+    InputQueue inputs;
+    std::vector< Stepped > stepped;
+
+    inputs.press(Engine::DOWN, 10);
+    inputs.advance(10, recorder(stepped));
+    // Release still queued when the game is paused
+    inputs.release(Engine::DOWN, 20);
+    inputs.releaseAll(15, recorder(stepped));
+    inputs.advance(1000, recorder(stepped));
+
+    check(stepped.size() == 2 && stepped.back().input ==
+          Engine::DOWN_RELEASE, test, "held DOWN was not released");
+
+    // Nothing held, nothing to release
+    stepped.clear();
+    inputs.releaseAll(2000, recorder(stepped));
+    check(stepped.empty(), test, "release without a held key");
+}
+
+void spectatorKeyframes() {
+    const char* test = "spectator_keyframes";
+    const char* file = "spectator-test.bin";
+    const long FRAMES = 4321;
+
+    SpectatorStream stream;
+    if ( !stream.open(file) ) {
+        check(false, test, "can't open the stream file");
+        return;
+    }
+
+    // Something changes on most frames, so deltas keep coming
+    Engine engine;
+    engine.reset(1, 10);
+    for ( long frame = 0; frame < FRAMES; ++frame ) {
+        if ( engine.gameOver() ) engine.reset(unsigned(frame), 10);
+        engine.step(frame % 7 == 0 ? Engine::LEFT : Engine::TICK);
+        stream.publish(engine, int(frame / 60));
+    }
+    stream.close();
+
+    std::ifstream in(file, std::ios::binary);
+    std::string data((std::istreambuf_iterator< char >(in)),
+                     std::istreambuf_iterator< char >());
+    in.close();
+    std::remove(file);
+
+    // Header: magic, version, columns, rows
+    size_t pos = 4;
+    uint64_t value = 0;
+    bool ok = data.size() > pos && Varint::get(data, pos, value) &&
+              Varint::get(data, pos, value);
+
+    // Messages: length, type, tick or tick delta
+    long tick = 0;
+    long last_keyframe = 0;
+    long keyframes = 0;
+    long longest_gap = 0;
+    uint64_t length = 0;
+    while ( ok && pos < data.size() ) {
+        size_t start = pos;
+        if ( !Varint::get(data, pos, length) ||
+             data.size() - pos < length ) {
+            ok = false;
+            break;
+        }
+        size_t end = pos + length;
+        int type = data[pos++];
+        if ( !Varint::get(data, pos, value) ) {
+            ok = false;
+            break;
+        }
+        if ( type == SpectatorStream::KEYFRAME ) {
+            tick = long(value);
+            longest_gap = std::max(longest_gap, tick - last_keyframe);
+            last_keyframe = tick;
+            ++keyframes;
+        } else {
+            tick += long(value);
+        }
+        pos = end;
+        ok = pos > start;
+    }
+    longest_gap = std::max(longest_gap, tick - last_keyframe);
+
+    check(ok, test, "stream does not parse");
+    check(keyframes >= FRAMES / SpectatorStream::KEYFRAME_INTERVAL, test,
+          "too few keyframes");
+    check(longest_gap <= SpectatorStream::KEYFRAME_INTERVAL, test,
+          "keyframes further apart than KEYFRAME_INTERVAL");
+}
+
+void scoreImportOnce() {
+    const char* test = "score_import_once";
+    const std::string base = "score-test";
+    const std::string legacy = base + ".txt";
+    const char* suffixes[] = { ".log", ".idx", ".nam", ".jnl", ".lck",
+                               ".imp", ".txt" };
+    auto removeAll = [&]() {
+        for ( const char* suffix : suffixes ) {
+            std::remove((base + suffix).c_str());
+        }
+    };
+    removeAll();
+
+    std::ofstream(legacy) << "alice:1:2:100\nbob:0:30:50\n";
+
+    // The scoreboard dialog only reads
+    ScoreStore reader(base);
+    check(reader.openReadOnly() && reader.size() == 0, test,
+          "read only open of a missing store failed");
+    check(!reader.exists(), test, "read only open created the log");
+
+    ScoreStore store(base);
+    check(store.open() && !store.imported(), test,
+          "new store already imported");
+    check(store.importLegacy(legacy) == 2 && store.imported(), test,
+          "import failed");
+    check(store.importLegacy(legacy) == 0 && store.size() == 2, test,
+          "import was repeated");
+
+    ScoreStore other(base);
+    check(other.openReadOnly() && other.size() == 2 && other.imported(),
+          test, "imported scores not seen by a reader");
+    removeAll();
+}
+
+}
+
+int main() {
+    inputQueueStartsOver();
+    inputQueueReleasesSoftDrop();
+    spectatorKeyframes();
+    scoreImportOnce();
+
+    if ( failures == 0 ) {
+        std::cout << "All tests passed\n";
+    }
+    return failures;
+}
@@ -0,0 +1,28 @@
+#-------------------------------------------------
+#
+# Microbenchmarks for the game engine,
+# prints CSV to compare runs across commits
+#
+#-------------------------------------------------
+
+TARGET = tetris-bench
+TEMPLATE = app
+
+CONFIG += console c++14 release
+CONFIG -= qt app_bundle
+
+SOURCES += \
+        bench.cpp \
+    engine.cpp \
+    board.cpp \
+    featurebatch.cpp \
+    wideboard.cpp \
+    trace.cpp
+
+HEADERS += \
+        engine.hh \
+    board.hh \
+    tetromino.hh \
+    featurebatch.hh \
+    wideboard.hh \
+    trace.hh
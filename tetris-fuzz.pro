@@ -0,0 +1,43 @@
+#-------------------------------------------------
+#
+# Fuzz target for the game engine. Checks the
+# engine invariants after every step of random
+# inputs, or of libFuzzer's coverage guided ones
+# with CONFIG+=libfuzzer (needs clang).
+# CONFIG+=sanitizer sanitize_address
+# sanitize_undefined catches stray writes.
+#
+#-------------------------------------------------
+
+TARGET = tetris-fuzz
+TEMPLATE = app
+
+CONFIG += console c++14 thread
+CONFIG -= qt app_bundle
+
+# Millions of steps, nobody reads their trace
+DEFINES += TRACE_CATEGORIES=0
+
+libfuzzer {
+    QMAKE_CXX = clang++
+    QMAKE_LINK = clang++
+    CONFIG += sanitizer sanitize_address sanitize_undefined
+    DEFINES += TETRIS_LIBFUZZER
+    QMAKE_CXXFLAGS += -fsanitize=fuzzer
+    QMAKE_LFLAGS += -fsanitize=fuzzer
+}
+
+SOURCES += \
+        fuzz.cpp \
+    engine.cpp \
+    board.cpp \
+    replay.cpp \
+    trace.cpp
+
+HEADERS += \
+        engine.hh \
+    board.hh \
+    tetromino.hh \
+    replay.hh \
+    varint.hh \
+    trace.hh
@@ -0,0 +1,40 @@
+#-------------------------------------------------
+#
+# Headless simulator, runs the game engine
+# without Qt as fast as the CPU allows
+#
+#-------------------------------------------------
+
+TARGET = tetris-sim
+TEMPLATE = app
+
+CONFIG += console c++14 thread
+CONFIG -= qt app_bundle
+
+# Millions of games, nobody reads their trace
+DEFINES += TRACE_CATEGORIES=0
+
+SOURCES += \
+        sim.cpp \
+    engine.cpp \
+    board.cpp \
+    replay.cpp \
+    batch.cpp \
+    aiplayer.cpp \
+    versus.cpp \
+    versuslink.cpp \
+    wideboard.cpp \
+    trace.cpp
+
+HEADERS += \
+        engine.hh \
+    replay.hh \
+    board.hh \
+    tetromino.hh \
+    batch.hh \
+    aiplayer.hh \
+    versus.hh \
+    versuslink.hh \
+    varint.hh \
+    wideboard.hh \
+    trace.hh
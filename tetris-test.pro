@@ -0,0 +1,37 @@
+#-------------------------------------------------
+#
+# Regression tests of the code that runs
+# without Qt, run the binary after building
+#
+#-------------------------------------------------
+
+TARGET = tetris-test
+TEMPLATE = app
+
+# The score store parses the old scoreboard with
+# string_view and from_chars
+CONFIG += console c++17 thread
+CONFIG -= qt app_bundle
+
+DEFINES += TRACE_CATEGORIES=0
+
+SOURCES += \
+        tests.cpp \
+    inputqueue.cpp \
+    spectator.cpp \
+    scorestore.cpp \
+    legacyscores.cpp \
+    engine.cpp \
+    board.cpp \
+    trace.cpp
+
+HEADERS += \
+        inputqueue.hh \
+    spectator.hh \
+    scorestore.hh \
+    legacyscores.hh \
+    varint.hh \
+    engine.hh \
+    board.hh \
+    tetromino.hh \
+    trace.hh
@@ -0,0 +1,19 @@
+#-------------------------------------------------
+#
+# Trace decoder. Prints the records of a binary
+# trace dump of the game as text.
+#
+#-------------------------------------------------
+
+TARGET = tetris-trace
+TEMPLATE = app
+
+CONFIG += console c++14
+CONFIG -= qt app_bundle
+
+SOURCES += \
+        tracedump.cpp \
+    trace.cpp
+
+HEADERS += \
+        trace.hh
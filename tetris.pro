@@ -17,6 +17,13 @@ TEMPLATE = app
 # deprecated API in order to know how to port your code away from it.
 DEFINES += QT_DEPRECATED_WARNINGS
 
+# Rotation tables are built by constexpr functions, the old
+# scoreboard is parsed with string_view and from_chars
+CONFIG += c++17
+
+# Field size, see board.hh. Every size is its own build.
+#DEFINES += BOARD_WIDTH=10 BOARD_HEIGHT=20
+
 # You can also make your code fail to compile if you use deprecated APIs.
 # In order to do so, uncomment the following line.
 # You can also select to disable deprecated APIs only up to a certain version of Qt.
@@ -26,13 +33,48 @@ DEFINES += QT_DEPRECATED_WARNINGS
 SOURCES += \
         main.cpp \
         mainwindow.cpp \
-    scoreboard.cpp
+    scoreboard.cpp \
+    board.cpp \
+    engine.cpp \
+    replay.cpp \
+    aiplayer.cpp \
+    scorestore.cpp \
+    legacyscores.cpp \
+    scoremodel.cpp \
+    inputqueue.cpp \
+    framestats.cpp \
+    trace.cpp \
+    spectator.cpp \
+    snapshot.cpp \
+    scorewriter.cpp \
+    versus.cpp \
+    versuslink.cpp \
+    versuswindow.cpp
 
 HEADERS += \
         mainwindow.hh \
-    scoreboard.hh
+    scoreboard.hh \
+    board.hh \
+    tetromino.hh \
+    engine.hh \
+    replay.hh \
+    varint.hh \
+    aiplayer.hh \
+    scorestore.hh \
+    legacyscores.hh \
+    scoremodel.hh \
+    inputqueue.hh \
+    framestats.hh \
+    trace.hh \
+    spectator.hh \
+    snapshot.hh \
+    scorewriter.hh \
+    versus.hh \
+    versuslink.hh \
+    versuswindow.hh
 
 FORMS += \
         mainwindow.ui \
-    scoreboard.ui
+    scoreboard.ui \
+    versuswindow.ui
 
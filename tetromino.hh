@@ -0,0 +1,254 @@
+/*
+ * Tetris -game
+ * Tetromino shapes with every orientation
+ * and wall kick precomputed at compile time
+ *
+ * Timi Rautamäki, 284032
+ *
+ */
+
+#ifndef TETROMINO_HH
+#define TETROMINO_HH
+
+#include "board.hh"
+#include <cstdint>
+
+namespace Tetrominos {
+
+const int NUMBER_OF_TETROMINOS = 7;
+const int ORIENTATIONS = 4;
+const int MAX_KICKS = 5;
+
+// 4*4 spawn shape indexed [x][y]
+struct Shape {
+    uint8_t cells[4][4];
+};
+
+// One orientation of a tetromino. Each of the 4 rows of
+// the 4*4 box is a mask with bit 0 as the leftmost column.
+// The bounds are the extents of the filled cells in the box,
+// 'bottom' the lowest filled row of each box column or -1.
+struct Orientation {
+    uint8_t rows[4];
+    int8_t min_x;
+    int8_t max_x;
+    int8_t min_y;
+    int8_t max_y;
+    int8_t bottom[4];
+};
+
+struct Kick {
+    int8_t dx;
+    int8_t dy;
+};
+
+// Offsets tried in order after a rotation
+struct KickList {
+    int count;
+    Kick kicks[MAX_KICKS];
+};
+
+// Ordered by 'TETROMINO_KIND'
+constexpr Shape SHAPES[NUMBER_OF_TETROMINOS] = {
+    // ####
+    { { { 0, 0, 1, 0 },
+        { 0, 0, 1, 0 },
+        { 0, 0, 1, 0 },
+        { 0, 0, 1, 0 } } },
+
+    // #
+    // ###
+    { { { 0, 1, 1, 0 },
+        { 0, 1, 0, 0 },
+        { 0, 1, 0, 0 },
+        { 0, 0, 0, 0 } } },
+
+    //   #
+    // ###
+    { { { 0, 1, 1, 0 },
+        { 0, 0, 1, 0 },
+        { 0, 0, 1, 0 },
+        { 0, 0, 0, 0 } } },
+
+    // ##
+    // ##
+    { { { 0, 0, 0, 0 },
+        { 1, 1, 0, 0 },
+        { 1, 1, 0, 0 },
+        { 0, 0, 0, 0 } } },
+
+    //  ##
+    // ##
+    { { { 0, 1, 0, 0 },
+        { 0, 1, 1, 0 },
+        { 0, 0, 1, 0 },
+        { 0, 0, 0, 0 } } },
+
+    //  #
+    // ###
+    { { { 0, 0, 1, 0 },
+        { 0, 1, 1, 0 },
+        { 0, 0, 1, 0 },
+        { 0, 0, 0, 0 } } },
+
+    // ##
+    //  ##
+    { { { 0, 0, 1, 0 },
+        { 0, 1, 1, 0 },
+        { 0, 1, 0, 0 },
+        { 0, 0, 0, 0 } } }
+};
+
+// Wall kicks. The long tetromino may need to move two
+// columns away from a wall, the square never rotates.
+constexpr KickList KICKS_NORMAL = { 3, { { 0, 0 }, { 1, 0 }, { -1, 0 } } };
+constexpr KickList KICKS_LONG = { 5, { { 0, 0 }, { 1, 0 }, { -1, 0 },
+                                       { 2, 0 }, { -2, 0 } } };
+constexpr KickList KICKS_NONE = { 1, { { 0, 0 } } };
+
+constexpr Orientation makeOrientation(const Shape& shape, int rotation) {
+    Orientation o = { { 0, 0, 0, 0 }, 4, -1, 4, -1, { -1, -1, -1, -1 } };
+
+    for ( int x = 0; x < 4; ++x ) {
+        for ( int y = 0; y < 4; ++y ) {
+            if ( shape.cells[x][y] != 1 ) continue;
+
+            // Same turn as the old 4*4 matrix rotation:
+            // (x, y) -> (y, 3 - x), applied 'rotation' times
+            int rx = x;
+            int ry = y;
+            for ( int r = 0; r < rotation; ++r ) {
+                int tmp = rx;
+                rx = ry;
+                ry = 3 - tmp;
+            }
+
+            o.rows[ry] = uint8_t(o.rows[ry] | (1 << rx));
+            if ( rx < o.min_x ) o.min_x = int8_t(rx);
+            if ( rx > o.max_x ) o.max_x = int8_t(rx);
+            if ( ry < o.min_y ) o.min_y = int8_t(ry);
+            if ( ry > o.max_y ) o.max_y = int8_t(ry);
+            if ( ry > o.bottom[rx] ) o.bottom[rx] = int8_t(ry);
+        }
+    }
+
+    return o;
+}
+
+struct Table {
+    Orientation orientations[NUMBER_OF_TETROMINOS][ORIENTATIONS];
+    KickList kicks[NUMBER_OF_TETROMINOS][ORIENTATIONS];
+};
+
+constexpr Table makeTable() {
+    Table t = {};
+    for ( int kind = 0; kind < NUMBER_OF_TETROMINOS; ++kind ) {
+        for ( int r = 0; r < ORIENTATIONS; ++r ) {
+            t.orientations[kind][r] = makeOrientation(SHAPES[kind], r);
+            // Kind 0 is the long one, kind 3 the square
+            t.kicks[kind][r] = kind == 0 ? KICKS_LONG
+                             : kind == 3 ? KICKS_NONE
+                                         : KICKS_NORMAL;
+        }
+    }
+    return t;
+}
+
+constexpr Table TABLE = makeTable();
+
+/**
+ * @brief orientation
+ * @param kind: tetromino kind
+ * @param rotation: 0..3
+ * @return precomputed orientation
+ */
+inline const Orientation& orientation(int kind, int rotation) {
+    return TABLE.orientations[kind][rotation & 3];
+}
+
+/**
+ * @brief kicks
+ * @param kind: tetromino kind
+ * @param rotation: orientation being rotated into
+ * @return offsets to try in order
+ */
+inline const KickList& kicks(int kind, int rotation) {
+    return TABLE.kicks[kind][rotation & 3];
+}
+
+/**
+ * @brief filled
+ * @return true if cell (x, y) of the 4*4 box is part of the tetromino
+ */
+inline bool filled(const Orientation& o, int x, int y) {
+    return (o.rows[y] >> x) & 1;
+}
+
+/**
+ * @brief fits
+ * @param board: field to test against
+ * @param o: orientation
+ * @param x: x coordinate of the 4*4 box
+ * @param y: y coordinate of the 4*4 box
+ * @return true if the tetromino does not overlap walls, the floor
+ *         or finished cells. Rows above the field are free.
+ */
+inline bool fits(const Board& board, const Orientation& o, int x, int y) {
+    if ( x + o.min_x < 0 || x + o.max_x >= Board::COLUMNS ) return false;
+    if ( y + o.max_y >= Board::ROWS ) return false;
+
+    for ( int r = o.min_y; r <= o.max_y; ++r ) {
+        if ( y + r < 0 ) continue;
+
+        Board::RowMask bits = o.rows[r];
+        Board::RowMask mask = x >= 0 ? Board::RowMask(bits << x)
+                                     : Board::RowMask(bits >> -x);
+        if ( board.row(y + r) & mask ) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief dropDistance
+ * @param board: field to drop on
+ * @param o: orientation
+ * @param x: x coordinate of the 4*4 box
+ * @param y: y coordinate of the 4*4 box
+ * @return how many rows the tetromino can fall
+ * When the tetromino is above the surface of every column it
+ * covers this is a lookup of at most 4 column heights. Only a
+ * tetromino tucked under an overhang falls back to stepping.
+ */
+inline int dropDistance(const Board& board, const Orientation& o,
+                        int x, int y) {
+    int distance = -1;
+
+    for ( int c = o.min_x; c <= o.max_x; ++c ) {
+        if ( o.bottom[c] < 0 ) continue;
+
+        int lowest = y + o.bottom[c];
+        int room = board.surface(x + c) - 1 - lowest;
+
+        if ( room < 0 ) {
+            // Under an overhang, step down one row at a time
+            distance = 0;
+            while ( fits(board, o, x, y + distance + 1) ) {
+                ++distance;
+            }
+            return distance;
+        }
+
+        if ( distance < 0 || room < distance ) {
+            distance = room;
+        }
+    }
+
+    return distance;
+}
+
+}
+
+#endif // TETROMINO_HH
@@ -0,0 +1,258 @@
+/*
+ * Tetris -game
+ * Always-on event trace. Fixed size binary
+ * records go into a ring per thread, the
+ * newest ones can be dumped to a file and
+ * decoded offline with tetris-trace
+ *
+ * Timi Rautamäki, 284032
+ *
+ */
+
+#include "trace.hh"
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <fstream>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+static_assert(sizeof(Trace::Record) == 24, "trace records are 24 bytes");
+
+// Dump header: "TTRC", version, number of records
+const char MAGIC[4] = { 'T', 'T', 'R', 'C' };
+// Version 2 widened the record timestamps to 64 bits
+const uint32_t VERSION = 2;
+
+struct EventInfo {
+    const char* name;
+    // Names of the arguments, nullptr if unused
+    const char* a;
+    const char* b;
+};
+
+const EventInfo EVENTS[Trace::NUMBER_OF_EVENTS] = {
+    { "spawn", "shape", "pieces" },
+    { "blocked", "obstacle", "input" },
+    { "lock", "x", "y" },
+    { "lines", "lines", "points" },
+    { "game_over", "points", "pieces" },
+    { "step", "input", "time_ms" },
+    { "speed", "interval_ms", "seconds" },
+    { "backlog", "dropped_ms", nullptr },
+    { "game_start", "seed", "difficulty" },
+    { "pause", "paused", nullptr },
+    { "game_end", "points", "seconds" },
+    { "import", "scores", "malformed" },
+    { "rollback", "frame", "frames" },
+    { "resume", "seed", "seconds" },
+    { "scores", "scores", "written" },
+};
+
+// The owner thread is the only writer of a ring. 'head' counts
+// every record ever written, the newest RING_SIZE are kept.
+struct Ring {
+    std::atomic< uint64_t > head{ 0 };
+    Trace::Record records[Trace::RING_SIZE];
+};
+
+Ring rings[Trace::MAX_THREADS];
+std::atomic< int > threads{ 0 };
+
+const std::chrono::steady_clock::time_point start =
+        std::chrono::steady_clock::now();
+
+// Where the crash handler writes, fixed before any crash
+char crash_file[512];
+
+Ring* claimRing() {
+    int index = threads.fetch_add(1);
+    if ( index >= Trace::MAX_THREADS ) {
+        threads.store(Trace::MAX_THREADS);
+        return nullptr;
+    }
+
+    return &rings[index];
+}
+
+// Oldest record of a ring still kept and one past the newest
+void ringRange(const Ring& ring, uint64_t& first, uint64_t& end) {
+    end = ring.head.load(std::memory_order_acquire);
+    first = end > uint64_t(Trace::RING_SIZE) ? end - Trace::RING_SIZE : 0;
+}
+
+uint32_t countRecords() {
+    uint32_t count = 0;
+    int n = std::min(threads.load(), int(Trace::MAX_THREADS));
+    for ( int t = 0; t < n; ++t ) {
+        uint64_t first = 0;
+        uint64_t end = 0;
+        ringRange(rings[t], first, end);
+        count += uint32_t(end - first);
+    }
+    return count;
+}
+
+#ifndef _WIN32
+void writeAll(int fd, const void* data, size_t size) {
+    const char* p = static_cast< const char* >(data);
+    while ( size > 0 ) {
+        ssize_t written = ::write(fd, p, size);
+        if ( written <= 0 ) return;
+        p += written;
+        size -= size_t(written);
+    }
+}
+
+// Only async-signal-safe calls from here on
+void crashed(int signal) {
+    int fd = ::open(crash_file, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if ( fd >= 0 ) {
+        uint32_t header[2] = { VERSION, countRecords() };
+        writeAll(fd, MAGIC, sizeof(MAGIC));
+        writeAll(fd, header, sizeof(header));
+
+        int n = std::min(threads.load(), int(Trace::MAX_THREADS));
+        for ( int t = 0; t < n; ++t ) {
+            uint64_t first = 0;
+            uint64_t end = 0;
+            ringRange(rings[t], first, end);
+            for ( uint64_t i = first; i < end; ++i ) {
+                writeAll(fd, &rings[t].records[i % Trace::RING_SIZE],
+                         sizeof(Trace::Record));
+            }
+        }
+        ::close(fd);
+    }
+
+    // Let the default action end the process
+    std::signal(signal, SIG_DFL);
+    std::raise(signal);
+}
+#endif
+
+}
+
+void Trace::write(int category, int event, int32_t a, int32_t b) {
+    thread_local Ring* ring = claimRing();
+    thread_local uint8_t thread = ring != nullptr ? uint8_t(ring - rings) : 0;
+    if ( ring == nullptr ) return;
+
+    std::chrono::microseconds time =
+            std::chrono::duration_cast< std::chrono::microseconds >(
+                std::chrono::steady_clock::now() - start);
+
+    uint64_t head = ring->head.load(std::memory_order_relaxed);
+    Record& r = ring->records[head % RING_SIZE];
+    r.time_us = uint64_t(time.count());
+    r.event = uint16_t(event);
+    r.category = uint8_t(category);
+    r.thread = thread;
+    r.a = a;
+    r.b = b;
+    r.spare = 0;
+
+    // Publish the record to dumps on other threads
+    ring->head.store(head + 1, std::memory_order_release);
+}
+
+bool Trace::dump(const std::string& filename) {
+    std::vector< Record > records;
+    int n = std::min(threads.load(), int(MAX_THREADS));
+    for ( int t = 0; t < n; ++t ) {
+        uint64_t first = 0;
+        uint64_t end = 0;
+        ringRange(rings[t], first, end);
+        for ( uint64_t i = first; i < end; ++i ) {
+            records.push_back(rings[t].records[i % RING_SIZE]);
+        }
+    }
+
+    std::ofstream file(filename, std::ios::binary);
+    if ( !file ) return false;
+
+    uint32_t header[2] = { VERSION, uint32_t(records.size()) };
+    file.write(MAGIC, sizeof(MAGIC));
+    file.write(reinterpret_cast< const char* >(header), sizeof(header));
+    file.write(reinterpret_cast< const char* >(records.data()),
+               std::streamsize(records.size() * sizeof(Record)));
+
+    return bool(file);
+}
+
+bool Trace::installCrashHandler(const std::string& filename) {
+#ifndef _WIN32
+    if ( filename.size() >= sizeof(crash_file) ) return false;
+    std::strcpy(crash_file, filename.c_str());
+
+    for ( int signal : { SIGSEGV, SIGABRT, SIGFPE, SIGILL, SIGBUS } ) {
+        std::signal(signal, crashed);
+    }
+    return true;
+#else
+    (void)filename;
+    return false;
+#endif
+}
+
+bool Trace::load(const std::string& filename, std::vector< Record >& records) {
+    std::ifstream file(filename, std::ios::binary);
+    if ( !file ) return false;
+
+    char magic[4];
+    uint32_t header[2];
+    file.read(magic, sizeof(magic));
+    file.read(reinterpret_cast< char* >(header), sizeof(header));
+    if ( !file || std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0 ||
+         header[0] != VERSION ) {
+        return false;
+    }
+
+    records.resize(header[1]);
+    file.read(reinterpret_cast< char* >(records.data()),
+              std::streamsize(records.size() * sizeof(Record)));
+    records.resize(size_t(file.gcount()) / sizeof(Record));
+
+    // Threads are dumped one after another, merge them by time
+    std::stable_sort(records.begin(), records.end(),
+                     [](const Record& x, const Record& y) {
+        return x.time_us < y.time_us;
+    });
+
+    return true;
+}
+
+std::string Trace::format(const Record& record) {
+    const char* category = "?";
+    switch ( record.category ) {
+    case ENGINE: category = "engine"; break;
+    case INPUT: category = "input"; break;
+    case TIMING: category = "timing"; break;
+    case GAME: category = "game"; break;
+    case STORE: category = "store"; break;
+    }
+
+    std::string text = category;
+    if ( record.event >= NUMBER_OF_EVENTS ) {
+        return text + " event " + std::to_string(record.event) + " a="
+             + std::to_string(record.a) + " b=" + std::to_string(record.b);
+    }
+
+    const EventInfo& info = EVENTS[record.event];
+    text += " ";
+    text += info.name;
+    if ( info.a != nullptr ) {
+        text += std::string(" ") + info.a + "=" + std::to_string(record.a);
+    }
+    if ( info.b != nullptr ) {
+        text += std::string(" ") + info.b + "=" + std::to_string(record.b);
+    }
+
+    return text;
+}
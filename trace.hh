@@ -0,0 +1,122 @@
+/*
+ * Tetris -game
+ * Always-on event trace. Fixed size binary
+ * records go into a ring per thread, the
+ * newest ones can be dumped to a file and
+ * decoded offline with tetris-trace
+ *
+ * Timi Rautamäki, 284032
+ *
+ */
+
+#ifndef TRACE_HH
+#define TRACE_HH
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Categories compiled in, see Trace::CATEGORY. Builds that
+// want no tracing at all define this as 0.
+#ifndef TRACE_CATEGORIES
+#define TRACE_CATEGORIES 0xff
+#endif
+
+class Trace {
+public:
+    enum CATEGORY { ENGINE = 1,     // Spawns, locks, blocked moves
+                    INPUT = 2,      // Inputs fed to the engine
+                    TIMING = 4,     // Speed changes, dropped ticks
+                    GAME = 8,       // Start, pause and end of games
+                    STORE = 16 };   // Scoreboard maintenance
+
+    // What happened. The meaning of the two arguments
+    // of each event is listed in trace.cpp.
+    enum EVENT { SPAWN,
+                 BLOCKED,
+                 LOCK,
+                 LINES,
+                 GAME_OVER,
+                 STEP,
+                 SPEED,
+                 BACKLOG,
+                 GAME_START,
+                 PAUSE,
+                 GAME_END,
+                 IMPORT,
+                 ROLLBACK,
+                 RESUME,
+                 SCORES,
+                 NUMBER_OF_EVENTS };
+
+    // One trace entry, written to dumps as is
+    struct Record {
+        // Microseconds since the trace started, 64 bits
+        // so that long sessions do not wrap around
+        uint64_t time_us;
+        uint16_t event;
+        uint8_t category;
+        // Order in which the thread first traced
+        uint8_t thread;
+        int32_t a;
+        int32_t b;
+        // Zero, fills the record to a whole 8 bytes
+        uint32_t spare;
+    };
+
+    // Newest records kept per thread
+    static const int RING_SIZE = 4096;
+    // Threads that get a ring, later ones are not traced
+    static const int MAX_THREADS = 32;
+
+    /**
+     * @brief record
+     * @param event: Trace::EVENT
+     * @param a: first argument
+     * @param b: second argument
+     * Compiles to nothing if CATEGORY is filtered out
+     */
+    template< int CATEGORY >
+    static void record(int event, int32_t a = 0, int32_t b = 0) {
+        if ( (TRACE_CATEGORIES & CATEGORY) != 0 ) {
+            write(CATEGORY, event, a, b);
+        }
+    }
+
+    /**
+     * @brief dump
+     * @param filename: file to write
+     * @return false on write errors
+     * Write the records of every thread. Records a thread
+     * overwrites during the dump may come out torn.
+     */
+    static bool dump(const std::string& filename);
+    /**
+     * @brief installCrashHandler
+     * @param filename: file the crash dump goes to
+     * @return false if crash dumps are not supported
+     * Dump the trace when the process crashes or aborts
+     */
+    static bool installCrashHandler(const std::string& filename);
+
+    /**
+     * @brief load
+     * @param filename: dump to read
+     * @param records: filled with the records in time order
+     * @return false if the file is not a trace dump
+     */
+    static bool load(const std::string& filename,
+                     std::vector< Record >& records);
+    /**
+     * @brief format
+     * @param record: record to describe
+     * @return one line of text, e.g. "engine lock x=3 y=18"
+     */
+    static std::string format(const Record& record);
+
+private:
+    static void write(int category, int event, int32_t a, int32_t b);
+};
+
+#endif // TRACE_HH
@@ -0,0 +1,34 @@
+/*
+ * Tetris -game
+ * Turns a binary trace dump into text,
+ * one record per line in time order
+ *
+ * Timi Rautamäki, 284032
+ *
+ */
+
+#include "trace.hh"
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+int main(int argc, char* argv[]) {
+    if ( argc != 2 ) {
+        std::cerr << "usage: tetris-trace dumpfile" << std::endl;
+        return 2;
+    }
+
+    std::vector< Trace::Record > records;
+    if ( !Trace::load(argv[1], records) ) {
+        std::cerr << "Error reading trace " << argv[1] << std::endl;
+        return 1;
+    }
+
+    for ( const Trace::Record& r : records ) {
+        std::printf("%12.6f s  t%-2d %s\n", r.time_us / 1e6, r.thread,
+                    Trace::format(r).c_str());
+    }
+
+    return 0;
+}
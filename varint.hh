@@ -0,0 +1,52 @@
+/*
+ * Tetris -game
+ * LEB128 variable length integers used by
+ * replays and network packets
+ *
+ * Timi Rautamäki, 284032
+ *
+ */
+
+#ifndef VARINT_HH
+#define VARINT_HH
+
+#include <cstdint>
+#include <string>
+
+namespace Varint {
+
+/**
+ * @brief put
+ * @param out: string to append to
+ * @param value: value to append, 7 bits per byte
+ */
+inline void put(std::string& out, uint64_t value) {
+    while ( value >= 0x80 ) {
+        out.push_back(char((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(char(value));
+}
+
+/**
+ * @brief get
+ * @param in: string to read from
+ * @param pos: position to read at, moved past the value
+ * @param value: filled with the value
+ * @return false if the value runs past the end
+ */
+inline bool get(const std::string& in, size_t& pos, uint64_t& value) {
+    value = 0;
+    for ( int shift = 0; shift < 64 && pos < in.size(); shift += 7 ) {
+        uint8_t byte = uint8_t(in[pos++]);
+        value |= uint64_t(byte & 0x7f) << shift;
+        if ( !(byte & 0x80) ) {
+            return true;
+        }
+    }
+    return false;
+}
+
+}
+
+#endif // VARINT_HH
@@ -0,0 +1,321 @@
+/*
+ * Tetris -game
+ * Two player versus session. Both players
+ * simulate both games from the inputs alone,
+ * predicting the other player's inputs and
+ * rolling back when a prediction was wrong
+ *
+ * Timi Rautamäki, 284032
+ *
+ */
+
+#include "versus.hh"
+#include "trace.hh"
+#include "varint.hh"
+#include <algorithm>
+#include <limits>
+
+namespace {
+
+const char MAGIC = 'V';
+
+// Garbage rows sent for clearing 0..4 rows at once
+const int GARBAGE_LINES[] = { 0, 0, 1, 2, 4 };
+
+const long NONE = std::numeric_limits< long >::max();
+
+// Nothing pressed, the prediction for frames not heard of yet
+const Versus::FrameInput NO_INPUT;
+
+class Hash {
+public:
+    void add(int64_t value) {
+        for ( int i = 0; i < 8; ++i ) {
+            hash_ = (hash_ ^ uint64_t(value & 0xff)) * 1099511628211ull;
+            value >>= 8;
+        }
+    }
+    uint64_t value() const { return hash_; }
+
+private:
+    uint64_t hash_ = 14695981039346656037ull;
+};
+
+void hashGame(Hash& h, const Engine& game) {
+    for ( int y = 0; y < Board::ROWS; ++y ) {
+        h.add(game.board().row(y));
+        for ( int x = 0; x < Board::COLUMNS; ++x ) {
+            h.add(game.board().colour(x, y));
+        }
+    }
+    h.add(game.piece().x);
+    h.add(game.piece().y);
+    h.add(game.piece().rotation);
+    h.add(game.currentShape());
+    h.add(game.nextShape());
+    h.add(game.points());
+    h.add(game.pieces());
+    h.add(game.fast());
+    h.add(game.gameOver());
+}
+
+}
+
+bool Versus::FrameInput::operator==(const FrameInput& other) const {
+    return count == other.count &&
+           std::equal(inputs, inputs + count, other.inputs);
+}
+
+Versus::Versus(int player, unsigned seed, int difficulty, Link& link) :
+    player_(player),
+    seed_(seed),
+    base_speed_(Engine::DIFFICULTIES[difficulty].speed),
+    link_(link),
+    mispredicted_(NONE) {
+
+    // Same seed, same tetrominos for both
+    for ( Engine& game : state_.games ) {
+        game.reset(seed, Engine::DIFFICULTIES[difficulty].points);
+    }
+
+    std::fill(remote_frame_, remote_frame_ + HISTORY, -1);
+}
+
+void Versus::input(int input) {
+    if ( pending_.count < MAX_FRAME_INPUTS ) {
+        pending_.inputs[pending_.count++] = uint8_t(input);
+    }
+}
+
+bool Versus::advance() {
+    receive();
+    rollback();
+
+    // Far enough ahead that a late packet could need a rollback
+    // past the snapshots, or our inputs past the history
+    if ( frame_ - confirmed_ >= MAX_ROLLBACK ||
+         frame_ - acknowledged_ >= HISTORY - 1 ) {
+        send();
+        return false;
+    }
+
+    int slot = int(frame_ % HISTORY);
+    local_[slot] = pending_;
+    pending_ = FrameInput();
+
+    snapshots_[slot] = state_;
+    simulate(frame_);
+    ++frame_;
+
+    send();
+    return true;
+}
+
+int Versus::incoming(int player) const {
+    int lines = 0;
+    for ( const Incoming& garbage : state_.incoming[player] ) {
+        lines += garbage.lines;
+    }
+    return lines;
+}
+
+uint64_t Versus::checksum(long frame) const {
+    const State* state = nullptr;
+    if ( frame == frame_ ) {
+        state = &state_;
+    } else if ( frame < frame_ && frame > frame_ - HISTORY && frame >= 0 ) {
+        state = &snapshots_[frame % HISTORY];
+    } else {
+        return 0;
+    }
+
+    Hash h;
+    for ( int p = 0; p < 2; ++p ) {
+        hashGame(h, state->games[p]);
+        h.add(state->gravity_us[p]);
+        for ( const Incoming& g : state->incoming[p] ) {
+            h.add(g.lines);
+            h.add(g.hole);
+        }
+    }
+    h.add(state->winner);
+
+    return h.value();
+}
+
+void Versus::simulate(long frame) {
+    State& s = state_;
+    if ( s.winner != PLAYING ) return;
+
+    const FrameInput* inputs[2];
+    inputs[player_] = &local_[frame % HISTORY];
+    inputs[1 - player_] = &remoteInput(frame);
+
+    long interval_us = speed(frame) * 1000L;
+
+    for ( int p = 0; p < 2; ++p ) {
+        Engine& game = s.games[p];
+
+        Incoming& garbage = s.incoming[p][frame % (GARBAGE_DELAY + 1)];
+        if ( garbage.lines > 0 ) {
+            game.addGarbage(garbage.lines, garbage.hole);
+            garbage = Incoming();
+        }
+
+        for ( int i = 0; i < inputs[p]->count; ++i ) {
+            sendGarbage(p, game.step(inputs[p]->inputs[i]).lines, frame);
+        }
+
+        s.gravity_us[p] += FRAME_US;
+        while ( s.gravity_us[p] >= interval_us ) {
+            s.gravity_us[p] -= interval_us;
+            sendGarbage(p, game.step(Engine::TICK).lines, frame);
+        }
+    }
+
+    bool lost[2] = { s.games[0].gameOver(), s.games[1].gameOver() };
+    if ( lost[0] && lost[1] ) {
+        s.winner = DRAW;
+    } else if ( lost[0] || lost[1] ) {
+        s.winner = lost[0] ? 1 : 0;
+    }
+}
+
+void Versus::sendGarbage(int from, int lines, long frame) {
+    if ( lines <= 0 ) return;
+
+    int count = GARBAGE_LINES[std::min(lines, 4)];
+    if ( count == 0 ) return;
+
+    int to = 1 - from;
+    long arrival = frame + GARBAGE_DELAY;
+    Incoming& garbage = state_.incoming[to][arrival % (GARBAGE_DELAY + 1)];
+
+    // The hole only depends on things both players know
+    if ( garbage.lines == 0 ) {
+        uint32_t h = seed_ * 2654435761u ^ uint32_t(arrival) * 40503u
+                   ^ uint32_t(to) * 97u;
+        h ^= h >> 15;
+        h *= 0x2c1b3c6du;
+        h ^= h >> 12;
+        garbage.hole = int(h % Board::COLUMNS);
+    }
+    garbage.lines += count;
+}
+
+int Versus::speed(long frame) const {
+    long seconds = frame * FRAME_US / 1000000;
+
+    // Same curve as the single player game
+    int speed = base_speed_;
+    for ( long s = Engine::DIFFICULTY_INTERVAL; s <= seconds;
+          s += Engine::DIFFICULTY_INTERVAL ) {
+        if ( speed <= Engine::MAX_DIFFICULTY ) break;
+        speed -= Engine::DIFFICULTY_STEP;
+    }
+
+    return speed;
+}
+
+const Versus::FrameInput& Versus::remoteInput(long frame) const {
+    int slot = int(frame % HISTORY);
+    return remote_frame_[slot] == frame ? remote_[slot] : NO_INPUT;
+}
+
+void Versus::receive() {
+    std::string packet;
+    while ( link_.receive(packet) ) {
+        // 'V', sender, ack, first frame, frame count, then for
+        // each frame the number of inputs and the inputs
+        if ( packet.empty() || packet[0] != MAGIC ) continue;
+
+        size_t pos = 1;
+        uint64_t sender = 0;
+        uint64_t ack = 0;
+        uint64_t first = 0;
+        uint64_t count = 0;
+        if ( !Varint::get(packet, pos, sender) ||
+             !Varint::get(packet, pos, ack) ||
+             !Varint::get(packet, pos, first) ||
+             !Varint::get(packet, pos, count) ||
+             int(sender) != 1 - player_ ) {
+            continue;
+        }
+
+        acknowledged_ = std::max(acknowledged_,
+                                 std::min(long(ack), frame_));
+
+        for ( uint64_t i = 0; i < count && pos < packet.size(); ++i ) {
+            long frame = long(first + i);
+
+            FrameInput input;
+            input.count = uint8_t(packet[pos++]);
+            if ( input.count > MAX_FRAME_INPUTS ||
+                 pos + input.count > packet.size() ) {
+                break;
+            }
+            for ( int k = 0; k < input.count; ++k ) {
+                input.inputs[k] = uint8_t(packet[pos++]);
+            }
+
+            int slot = int(frame % HISTORY);
+            if ( frame < confirmed_ || frame >= confirmed_ + HISTORY ||
+                 remote_frame_[slot] == frame ) {
+                continue;
+            }
+            remote_[slot] = input;
+            remote_frame_[slot] = frame;
+
+            // Already simulated with nothing pressed
+            if ( frame < frame_ && input != NO_INPUT ) {
+                mispredicted_ = std::min(mispredicted_, frame);
+            }
+        }
+
+        while ( remote_frame_[confirmed_ % HISTORY] == confirmed_ ) {
+            ++confirmed_;
+        }
+    }
+}
+
+void Versus::rollback() {
+    if ( mispredicted_ >= frame_ ) {
+        mispredicted_ = NONE;
+        return;
+    }
+
+    int depth = int(frame_ - mispredicted_);
+    ++rollbacks_;
+    resimulated_ += depth;
+    deepest_ = std::max(deepest_, depth);
+    Trace::record< Trace::GAME >(Trace::ROLLBACK, int32_t(mispredicted_),
+                                 depth);
+
+    state_ = snapshots_[mispredicted_ % HISTORY];
+    for ( long f = mispredicted_; f < frame_; ++f ) {
+        snapshots_[f % HISTORY] = state_;
+        simulate(f);
+    }
+
+    mispredicted_ = NONE;
+}
+
+void Versus::send() {
+    long first = acknowledged_;
+
+    std::string packet(1, MAGIC);
+    Varint::put(packet, uint64_t(player_));
+    Varint::put(packet, uint64_t(confirmed_));
+    Varint::put(packet, uint64_t(first));
+    Varint::put(packet, uint64_t(frame_ - first));
+
+    // Every input not acknowledged yet, so lost packets need no resend
+    for ( long f = first; f < frame_; ++f ) {
+        const FrameInput& input = local_[f % HISTORY];
+        packet.push_back(char(input.count));
+        packet.append(reinterpret_cast< const char* >(input.inputs),
+                      input.count);
+    }
+
+    link_.send(packet);
+}
@@ -0,0 +1,195 @@
+/*
+ * Tetris -game
+ * Two player versus session. Both players
+ * simulate both games from the inputs alone,
+ * predicting the other player's inputs and
+ * rolling back when a prediction was wrong
+ *
+ * Timi Rautamäki, 284032
+ *
+ */
+
+#ifndef VERSUS_HH
+#define VERSUS_HH
+
+#include "engine.hh"
+#include "versuslink.hh"
+#include <cstdint>
+#include <vector>
+
+class Versus {
+public:
+    // Length of one simulation frame
+    static const int FRAME_US = 16667;
+    // Frames the session may run ahead of the other player
+    static const int MAX_ROLLBACK = 60;
+    // Inputs and snapshots kept, at least twice MAX_ROLLBACK
+    static const int HISTORY = 128;
+    // Engine inputs one player can give in a frame
+    static const int MAX_FRAME_INPUTS = 7;
+    // Frames from a clear to the garbage arriving
+    static const int GARBAGE_DELAY = 30;
+
+    // Result of finished()
+    enum RESULT { PLAYING = -1, DRAW = 2 };
+
+    // Inputs of one player in one frame, in order
+    struct FrameInput {
+        uint8_t count = 0;
+        uint8_t inputs[MAX_FRAME_INPUTS] = {};
+
+        bool operator==(const FrameInput& other) const;
+        bool operator!=(const FrameInput& other) const {
+            return !(*this == other);
+        }
+    };
+
+    /**
+     * @brief Versus
+     * @param player: 0 or 1, which of the two games is ours
+     * @param seed: seed agreed by both players
+     * @param difficulty: Engine::DIFFICULTY agreed by both players
+     * @param link: link to the other player
+     */
+    Versus(int player, unsigned seed, int difficulty, Link& link);
+
+    /**
+     * @brief input
+     * @param input: Engine::INPUT other than TICK
+     * Give an input to our game in the next frame. The frame
+     * is simulated right away, whatever the link does.
+     */
+    void input(int input);
+    /**
+     * @brief advance
+     * @return false if the other player is too far behind
+     *         and the frame had to wait
+     * Take in the packets that arrived, roll back if the other
+     * player did something else than predicted, simulate one
+     * frame and send our inputs
+     */
+    bool advance();
+
+    /**
+     * @brief game
+     * @param player: 0 or 1
+     * @return game of the player as currently predicted
+     */
+    const Engine& game(int player) const { return state_.games[player]; }
+    int player() const { return player_; }
+    // Next frame to simulate
+    long frame() const { return frame_; }
+    // Frames with the other player's inputs known
+    long confirmed() const { return confirmed_; }
+    /**
+     * @brief finished
+     * @return winning player, DRAW or PLAYING
+     */
+    int finished() const { return state_.winner; }
+    /**
+     * @brief incoming
+     * @param player: 0 or 1
+     * @return garbage rows on their way to the player
+     */
+    int incoming(int player) const;
+
+    /**
+     * @brief checksum
+     * @param frame: frame within the last HISTORY frames
+     * @return hash of the state before 'frame' was simulated,
+     *         0 if it is no longer kept. Equal on both players
+     *         for frames both have confirmed.
+     */
+    uint64_t checksum(long frame) const;
+
+    // Rollbacks done, frames simulated again and the deepest rollback
+    long rollbacks() const { return rollbacks_; }
+    long resimulated() const { return resimulated_; }
+    int deepestRollback() const { return deepest_; }
+
+private:
+    // Garbage on its way to a player
+    struct Incoming {
+        int lines = 0;
+        int hole = 0;
+    };
+
+    // Everything that changes from frame to frame, copied as is
+    struct State {
+        Engine games[2];
+        // Game time towards the next gravity step
+        long gravity_us[2] = {};
+        // Indexed by arrival frame
+        Incoming incoming[2][GARBAGE_DELAY + 1];
+        int winner = PLAYING;
+    };
+
+    /**
+     * @brief simulate
+     * @param frame: frame to simulate on 'state_'
+     */
+    void simulate(long frame);
+    /**
+     * @brief sendGarbage
+     * @param from: player who cleared the rows
+     * @param lines: rows cleared
+     * @param frame: frame of the clear
+     */
+    void sendGarbage(int from, int lines, long frame);
+    /**
+     * @brief speed
+     * @param frame: frame number
+     * @return gravity interval in ms, on the difficulty curve
+     */
+    int speed(long frame) const;
+
+    /**
+     * @brief receive
+     * Take in every packet that has arrived
+     */
+    void receive();
+    /**
+     * @brief rollback
+     * Go back to the first frame that was mispredicted and
+     * simulate up to the current frame again
+     */
+    void rollback();
+    /**
+     * @brief send
+     * Send our inputs the other player has not confirmed
+     */
+    void send();
+
+    const FrameInput& remoteInput(long frame) const;
+
+    int player_;
+    unsigned seed_;
+    int base_speed_;
+    Link& link_;
+
+    State state_;
+    long frame_ = 0;
+
+    // Our inputs for the next frame
+    FrameInput pending_;
+    // Our inputs and the other player's, by frame % HISTORY
+    FrameInput local_[HISTORY];
+    FrameInput remote_[HISTORY];
+    // Frame each remote_ entry belongs to, -1 if not known
+    long remote_frame_[HISTORY];
+    // State before each frame, by frame % HISTORY
+    State snapshots_[HISTORY];
+
+    // Remote inputs known for every frame before this
+    long confirmed_ = 0;
+    // Our inputs the other player has for every frame before this
+    long acknowledged_ = 0;
+    // First frame simulated with a wrong prediction
+    long mispredicted_;
+
+    long rollbacks_ = 0;
+    long resimulated_ = 0;
+    int deepest_ = 0;
+};
+
+#endif // VERSUS_HH
@@ -0,0 +1,148 @@
+/*
+ * Tetris -game
+ * Packet links between two versus players:
+ * UDP between two processes and an in-process
+ * loopback with delay, jitter and loss
+ *
+ * Timi Rautamäki, 284032
+ *
+ */
+
+#include "versuslink.hh"
+#include <algorithm>
+#include <cstring>
+
+#ifndef _WIN32
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#ifndef _WIN32
+static_assert(sizeof(sockaddr_in) <= 16, "address must fit remote_");
+#endif
+
+UdpLink::~UdpLink() {
+    close();
+}
+
+bool UdpLink::open(int local_port, int remote_port, const std::string& host) {
+    close();
+
+#ifndef _WIN32
+    sockaddr_in local = {};
+    local.sin_family = AF_INET;
+    local.sin_port = htons(uint16_t(local_port));
+    local.sin_addr.s_addr = htonl(INADDR_ANY);
+
+    sockaddr_in remote = {};
+    remote.sin_family = AF_INET;
+    remote.sin_port = htons(uint16_t(remote_port));
+    if ( inet_pton(AF_INET, host.c_str(), &remote.sin_addr) != 1 ) {
+        return false;
+    }
+    std::memcpy(remote_, &remote, sizeof(remote));
+
+    socket_ = ::socket(AF_INET, SOCK_DGRAM, 0);
+    if ( socket_ < 0 ) return false;
+
+    if ( ::bind(socket_, reinterpret_cast< sockaddr* >(&local),
+                sizeof(local)) != 0 ||
+         ::fcntl(socket_, F_SETFL,
+                 ::fcntl(socket_, F_GETFL) | O_NONBLOCK) != 0 ) {
+        close();
+        return false;
+    }
+
+    return true;
+#else
+    (void)local_port;
+    (void)remote_port;
+    (void)host;
+    return false;
+#endif
+}
+
+void UdpLink::close() {
+#ifndef _WIN32
+    if ( socket_ >= 0 ) {
+        ::close(socket_);
+    }
+#endif
+    socket_ = -1;
+}
+
+void UdpLink::send(const std::string& packet) {
+#ifndef _WIN32
+    if ( socket_ < 0 ) return;
+
+    // A full socket buffer is just another lost packet
+    ::sendto(socket_, packet.data(), packet.size(), 0,
+             reinterpret_cast< const sockaddr* >(remote_),
+             sizeof(sockaddr_in));
+#else
+    (void)packet;
+#endif
+}
+
+bool UdpLink::receive(std::string& packet) {
+#ifndef _WIN32
+    if ( socket_ < 0 ) return false;
+
+    ssize_t size = ::recv(socket_, buffer_.data(), buffer_.size(), 0);
+    if ( size < 0 ) return false;
+
+    packet.assign(buffer_.data(), size_t(size));
+    return true;
+#else
+    (void)packet;
+    return false;
+#endif
+}
+
+Loopback::Loopback(int delay_ms, int jitter_ms, double loss, unsigned seed) :
+    delay_ms_(std::max(delay_ms, 0)),
+    jitter_ms_(std::max(jitter_ms, 0)),
+    loss_(loss),
+    random_(seed) {
+
+    for ( int side = 0; side < 2; ++side ) {
+        ends_[side].wire = this;
+        ends_[side].side = side;
+    }
+}
+
+void Loopback::End::send(const std::string& packet) {
+    Loopback& w = *wire;
+    ++w.sent_;
+
+    if ( std::uniform_real_distribution< double >(0, 1)(w.random_) < w.loss_ ) {
+        ++w.dropped_;
+        return;
+    }
+
+    long jitter = long(w.random_() % unsigned(w.jitter_ms_ + 1));
+    w.ends_[1 - side].incoming.push_back({
+        w.time_ms_ + w.delay_ms_ + jitter, w.sent_, packet });
+}
+
+bool Loopback::End::receive(std::string& packet) {
+    // Earliest arrival that is due, ties in send order
+    auto due = incoming.end();
+    for ( auto it = incoming.begin(); it != incoming.end(); ++it ) {
+        if ( it->arrival_ms > wire->time_ms_ ) continue;
+        if ( due == incoming.end() ||
+             it->arrival_ms < due->arrival_ms ||
+             (it->arrival_ms == due->arrival_ms &&
+              it->sequence < due->sequence) ) {
+            due = it;
+        }
+    }
+    if ( due == incoming.end() ) return false;
+
+    packet.swap(due->packet);
+    incoming.erase(due);
+    return true;
+}
@@ -0,0 +1,125 @@
+/*
+ * Tetris -game
+ * Packet links between two versus players:
+ * UDP between two processes and an in-process
+ * loopback with delay, jitter and loss
+ *
+ * Timi Rautamäki, 284032
+ *
+ */
+
+#ifndef VERSUSLINK_HH
+#define VERSUSLINK_HH
+
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+// Unreliable, unordered packet transport. Neither call blocks.
+class Link {
+public:
+    virtual ~Link() = default;
+
+    /**
+     * @brief send
+     * @param packet: bytes to send, may be lost
+     */
+    virtual void send(const std::string& packet) = 0;
+    /**
+     * @brief receive
+     * @param packet: filled with the next packet that arrived
+     * @return false if nothing has arrived
+     */
+    virtual bool receive(std::string& packet) = 0;
+};
+
+class UdpLink : public Link {
+public:
+    UdpLink() = default;
+    ~UdpLink() override;
+    UdpLink(const UdpLink&) = delete;
+    UdpLink& operator=(const UdpLink&) = delete;
+
+    /**
+     * @brief open
+     * @param local_port: port to receive on
+     * @param remote_port: port of the other player
+     * @param host: IPv4 address of the other player
+     * @return false if the socket can't be set up
+     */
+    bool open(int local_port, int remote_port,
+              const std::string& host = "127.0.0.1");
+    void close();
+
+    void send(const std::string& packet) override;
+    bool receive(std::string& packet) override;
+
+private:
+    int socket_ = -1;
+    // sockaddr_in of the other player
+    char remote_[16] = {};
+    std::vector< char > buffer_ = std::vector< char >(2048);
+};
+
+// Two connected link ends in one process. Packets arrive after
+// the delay plus up to 'jitter' ms more, so they can overtake
+// each other, and a share of them is dropped. Time only moves
+// with setTime(), so runs are repeatable.
+class Loopback {
+public:
+    /**
+     * @brief Loopback
+     * @param delay_ms: one-way delay of every packet
+     * @param jitter_ms: extra random delay, 0..jitter_ms
+     * @param loss: share of packets dropped, 0..1
+     * @param seed: seed for the jitter and the losses
+     */
+    Loopback(int delay_ms, int jitter_ms, double loss, unsigned seed);
+
+    /**
+     * @brief end
+     * @param side: 0 or 1
+     * @return link of that side, sends to the other side
+     */
+    Link& end(int side) { return ends_[side]; }
+    /**
+     * @brief setTime
+     * @param time_ms: current time of both ends
+     */
+    void setTime(long time_ms) { time_ms_ = time_ms; }
+
+    long sent() const { return sent_; }
+    long dropped() const { return dropped_; }
+
+private:
+    struct InFlight {
+        long arrival_ms;
+        // Send order, keeps equal arrival times in order
+        long sequence;
+        std::string packet;
+    };
+
+    class End : public Link {
+    public:
+        void send(const std::string& packet) override;
+        bool receive(std::string& packet) override;
+
+        Loopback* wire = nullptr;
+        int side = 0;
+        // Packets on their way to this end
+        std::vector< InFlight > incoming;
+    };
+
+    int delay_ms_;
+    int jitter_ms_;
+    double loss_;
+    std::minstd_rand random_;
+    long time_ms_ = 0;
+    long sent_ = 0;
+    long dropped_ = 0;
+
+    End ends_[2];
+};
+
+#endif // VERSUSLINK_HH
@@ -0,0 +1,311 @@
+/*
+ * Tetris -game
+ * Versus window: two game instances play
+ * each other over UDP, both fields shown
+ * side by side
+ *
+ * Timi Rautamäki, 284032
+ *
+ */
+
+#include "versuswindow.hh"
+#include "ui_versuswindow.h"
+#include "varint.hh"
+#include <algorithm>
+#include <ctime>
+#include <QKeyEvent>
+
+VersusWindow::VersusWindow(int difficulty, QWidget *parent) :
+    QDialog(parent),
+    ui(new Ui::VersusWindow),
+    difficulty_(difficulty) {
+
+    ui->setupUi(this);
+    setFocusPolicy(Qt::StrongFocus);
+
+    setupField(fields_[0], ui->ownGraphicsView);
+    setupField(fields_[1], ui->opponentGraphicsView);
+
+    timer_.setSingleShot(false);
+    timer_.setTimerType(Qt::PreciseTimer);
+    connect(&timer_, &QTimer::timeout, this, &VersusWindow::frame);
+}
+
+VersusWindow::~VersusWindow() {
+    timer_.stop();
+    delete ui;
+}
+
+void VersusWindow::setupField(Field& field, QGraphicsView* view) {
+    field.scene = new QGraphicsScene(this);
+    field.scene->setSceneRect(0, 0, BORDER_RIGHT + 2 + GARBAGE_BAR,
+                              BORDER_DOWN);
+    view->setScene(field.scene);
+    view->setMinimumSize(BORDER_RIGHT + GARBAGE_BAR + 6, BORDER_DOWN + 4);
+
+    QPen grayPen(Qt::gray);
+    field.scene->addRect(0, 0, BORDER_RIGHT, BORDER_DOWN, grayPen);
+
+    // Every cell has its square from the start, drawing
+    // only changes their colour and visibility
+    QPen blackPen(Qt::black);
+    blackPen.setWidth(2);
+    for ( int y = 0; y < ROWS; ++y ) {
+        for ( int x = 0; x < COLUMNS; ++x ) {
+            QGraphicsRectItem* square =
+                    field.scene->addRect(x*SQUARE_SIDE, y*SQUARE_SIDE,
+                                         SQUARE_SIDE, SQUARE_SIDE,
+                                         blackPen);
+            square->setVisible(false);
+            field.squares.push_back(square);
+            field.shown.push_back(Board::EMPTY);
+        }
+    }
+
+    field.garbage = field.scene->addRect(0, 0, 0, 0, QPen(Qt::NoPen),
+                                         QBrush(Qt::red));
+    field.garbage->setVisible(false);
+}
+
+void VersusWindow::on_joinRadio_toggled(bool checked) {
+    Q_UNUSED(checked);
+
+    // The ports of the two players are the other way round
+    int port = ui->portSpinBox->value();
+    ui->portSpinBox->setValue(ui->remotePortSpinBox->value());
+    ui->remotePortSpinBox->setValue(port);
+}
+
+void VersusWindow::on_connectButton_clicked() {
+    std::string address = ui->addressLineEdit->text().trimmed().toStdString();
+    if ( !link_.open(ui->portSpinBox->value(),
+                     ui->remotePortSpinBox->value(), address) ) {
+        ui->statusLabel->setText("Error opening the port");
+        return;
+    }
+
+    player_ = ui->joinRadio->isChecked() ? 1 : 0;
+    seed_ = unsigned(time(0));
+    connecting_ = true;
+
+    ui->hostRadio->setEnabled(false);
+    ui->joinRadio->setEnabled(false);
+    ui->addressLineEdit->setEnabled(false);
+    ui->portSpinBox->setEnabled(false);
+    ui->remotePortSpinBox->setEnabled(false);
+    ui->connectButton->setEnabled(false);
+    ui->ownLabel->setText(player_ == 0 ? "You, hosting" : "You, joined");
+    setFocus();
+
+    clock_.start();
+    timer_.start(Versus::FRAME_US / 1000);
+    showStatus();
+}
+
+void VersusWindow::handshake() {
+    std::string packet;
+    while ( link_.receive(packet) ) {
+        if ( packet.empty() ) continue;
+
+        if ( player_ == 0 ) {
+            // The other player only sends inputs once it has
+            // started, so those answer the hello as well
+            uint64_t seed = 0;
+            size_t pos = 1;
+            if ( packet[0] != HELLO ||
+                 (Varint::get(packet, pos, seed) && seed == seed_) ) {
+                start(seed_, difficulty_);
+                return;
+            }
+            continue;
+        }
+
+        uint64_t seed = 0;
+        uint64_t difficulty = 0;
+        size_t pos = 1;
+        if ( packet[0] != HELLO || !Varint::get(packet, pos, seed) ||
+             !Varint::get(packet, pos, difficulty) ||
+             difficulty >= uint64_t(Engine::NUMBER_OF_DIFFICULTIES) ) {
+            continue;
+        }
+
+        for ( int i = 0; i < HELLO_ANSWERS; ++i ) {
+            link_.send(packet);
+        }
+        start(unsigned(seed), int(difficulty));
+        return;
+    }
+
+    if ( player_ == 0 && clock_.elapsed() - last_hello_ >= HELLO_INTERVAL_MS ) {
+        last_hello_ = clock_.elapsed();
+
+        std::string hello(1, HELLO);
+        Varint::put(hello, seed_);
+        Varint::put(hello, uint64_t(difficulty_));
+        link_.send(hello);
+    }
+}
+
+void VersusWindow::start(unsigned seed, int difficulty) {
+    seed_ = seed;
+    difficulty_ = difficulty;
+    connecting_ = false;
+    versus_.reset(new Versus(player_, seed_, difficulty_, link_));
+
+    inputs_.clear();
+    // Repeats are single steps, the session can't tell
+    // when the tetromino has reached the wall
+    inputs_.setAutoRepeat(DAS_MS, std::max(1, ARR_MS));
+
+    clock_.start();
+    waited_us_ = 0;
+    stalls_ = 0;
+}
+
+void VersusWindow::frame() {
+    if ( connecting_ ) {
+        handshake();
+        showStatus();
+        return;
+    }
+    if ( !versus_ ) return;
+
+    InputQueue::Step step = [this](long, int input) {
+        versus_->input(input);
+        return Engine::Events();
+    };
+
+    // Frames keep going after the game has ended, so that
+    // the other player gets our last inputs too
+    qint64 now_us = clock_.nsecsElapsed() / 1000 - waited_us_;
+    long due = long(now_us / Versus::FRAME_US);
+    int frames = 0;
+    while ( versus_->frame() < due ) {
+        inputs_.advance(frameTime(), step);
+
+        bool waited = !versus_->advance();
+        if ( waited ) ++stalls_;
+
+        // Waiting for the other player, or far behind after a stall.
+        // The time is not simulated later in one go.
+        if ( waited || ++frames == MAX_FRAMES_PER_TICK ) {
+            waited_us_ = clock_.nsecsElapsed() / 1000
+                       - qint64(versus_->frame()) * Versus::FRAME_US;
+            break;
+        }
+    }
+
+    draw(fields_[0], player_);
+    draw(fields_[1], 1 - player_);
+    showStatus();
+}
+
+void VersusWindow::draw(Field& field, int player) {
+    const Engine& game = versus_->game(player);
+    const Board& board = game.board();
+
+    std::vector< int > colours(size_t(ROWS * COLUMNS));
+    for ( int y = 0; y < ROWS; ++y ) {
+        for ( int x = 0; x < COLUMNS; ++x ) {
+            colours[size_t(y * COLUMNS + x)] = board.colour(x, y);
+        }
+    }
+
+    const Tetrominos::Orientation* current = game.current();
+    if ( current != nullptr ) {
+        const Engine::Pose& piece = game.piece();
+        for ( int py = 0; py < 4; ++py ) {
+            for ( int px = 0; px < 4; ++px ) {
+                int x = piece.x + px;
+                int y = piece.y + py;
+                if ( !Tetrominos::filled(*current, px, py) ||
+                     x < 0 || x >= COLUMNS || y < 0 || y >= ROWS ) {
+                    continue;
+                }
+                colours[size_t(y * COLUMNS + x)] = game.currentShape();
+            }
+        }
+    }
+
+    for ( size_t i = 0; i < colours.size(); ++i ) {
+        if ( colours[i] == field.shown[i] ) continue;
+
+        QGraphicsRectItem* square = field.squares[i];
+        if ( colours[i] == Board::EMPTY ) {
+            square->setVisible(false);
+        } else {
+            square->setBrush(colours_.at(size_t(colours[i])));
+            square->setVisible(true);
+        }
+        field.shown[i] = colours[i];
+    }
+
+    int lines = std::min(versus_->incoming(player), ROWS);
+    field.garbage->setVisible(lines > 0);
+    field.garbage->setRect(BORDER_RIGHT + 2, BORDER_DOWN - lines * SQUARE_SIDE,
+                           GARBAGE_BAR, lines * SQUARE_SIDE);
+}
+
+void VersusWindow::showStatus() {
+    QString status;
+    if ( connecting_ ) {
+        status = player_ == 0 ? "Waiting for the other player to join"
+                              : "Waiting for the host";
+    } else if ( versus_ ) {
+        int winner = versus_->finished();
+        if ( winner == Versus::DRAW ) {
+            status = "Draw";
+        } else if ( winner != Versus::PLAYING ) {
+            status = winner == player_ ? "You win" : "You lose";
+        } else {
+            status = QString("Points %1 - %2, rollbacks %3, waits %4")
+                    .arg(versus_->game(player_).points())
+                    .arg(versus_->game(1 - player_).points())
+                    .arg(versus_->rollbacks())
+                    .arg(stalls_);
+        }
+    }
+
+    if ( ui->statusLabel->text() != status ) {
+        ui->statusLabel->setText(status);
+    }
+}
+
+void VersusWindow::keyPressEvent(QKeyEvent* event) {
+    int input = keyInput(event->key());
+    if ( input < 0 || !versus_ ) {
+        QDialog::keyPressEvent(event);
+        return;
+    }
+
+    // Held keys repeat on game time, not on the desktop's settings
+    if ( !event->isAutoRepeat() ) {
+        inputs_.press(input, frameTime());
+    }
+}
+
+void VersusWindow::keyReleaseEvent(QKeyEvent* event) {
+    int input = keyInput(event->key());
+    if ( input < 0 || !versus_ ) {
+        QDialog::keyReleaseEvent(event);
+        return;
+    }
+
+    if ( !event->isAutoRepeat() ) {
+        inputs_.release(input, frameTime());
+    }
+}
+
+int VersusWindow::keyInput(int key) const {
+    if ( key == KEY_DOWN ) return Engine::DOWN;
+    if ( key == KEY_LEFT ) return Engine::LEFT;
+    if ( key == KEY_RIGHT ) return Engine::RIGHT;
+    if ( key == KEY_ROTATE ) return Engine::ROTATE;
+    if ( key == KEY_DROP ) return Engine::DROP;
+
+    return -1;
+}
+
+long VersusWindow::frameTime() const {
+    return long(versus_->frame() * Versus::FRAME_US / 1000);
+}
@@ -0,0 +1,181 @@
+/*
+ * Tetris -game
+ * Versus window: two game instances play
+ * each other over UDP, both fields shown
+ * side by side
+ *
+ * Timi Rautamäki, 284032
+ *
+ */
+
+#ifndef VERSUSWINDOW_HH
+#define VERSUSWINDOW_HH
+
+#include "engine.hh"
+#include "inputqueue.hh"
+#include "versus.hh"
+#include "versuslink.hh"
+#include <memory>
+#include <string>
+#include <vector>
+#include <QDialog>
+#include <QElapsedTimer>
+#include <QGraphicsRectItem>
+#include <QGraphicsScene>
+#include <QTimer>
+
+namespace Ui {
+    class VersusWindow;
+}
+
+class VersusWindow : public QDialog {
+    Q_OBJECT
+
+public:
+    /**
+     * @brief VersusWindow
+     * @param difficulty: Engine::DIFFICULTY to host with, the
+     *        joining player plays on the host's
+     * @param parent
+     */
+    explicit VersusWindow(int difficulty, QWidget *parent = 0);
+    ~VersusWindow();
+
+protected:
+    void keyPressEvent(QKeyEvent* event) override;
+    void keyReleaseEvent(QKeyEvent* event) override;
+
+private slots:
+    void on_connectButton_clicked();
+
+    void on_joinRadio_toggled(bool checked);
+
+private:
+    Ui::VersusWindow *ui;
+
+    // Scene coordinates of one field, the garbage bar
+    // is right of the field
+    static const int SQUARE_SIDE = 20;
+    static const int COLUMNS = Board::COLUMNS;
+    static const int ROWS = Board::ROWS;
+    static const int BORDER_RIGHT = COLUMNS * SQUARE_SIDE;
+    static const int BORDER_DOWN = ROWS * SQUARE_SIDE;
+    static const int GARBAGE_BAR = 6;
+
+    // Hello packets agree on the seed and the difficulty:
+    // HELLO, seed, difficulty. The host sends them until the
+    // other player answers with one or its first inputs.
+    static const char HELLO = 'H';
+    static const int HELLO_INTERVAL_MS = 100;
+    // Answers sent back, any one of them getting through will do
+    static const int HELLO_ANSWERS = 3;
+
+    // Frames one timer tick may catch up on
+    static const int MAX_FRAMES_PER_TICK = 4;
+
+    // One player's field in the window
+    struct Field {
+        QGraphicsScene* scene = nullptr;
+        // Square of every cell, row by row
+        std::vector< QGraphicsRectItem* > squares;
+        // Colour each square shows, Board::EMPTY if hidden
+        std::vector< int > shown;
+        // Incoming garbage next to the field
+        QGraphicsRectItem* garbage = nullptr;
+    };
+
+    /**
+     * @brief setupField
+     * @param field: field to set up
+     * @param view: view showing it
+     */
+    void setupField(Field& field, QGraphicsView* view);
+    /**
+     * @brief handshake
+     * Send and answer hello packets until both
+     * players know the seed, then start
+     */
+    void handshake();
+    /**
+     * @brief start
+     * @param seed: seed both players use
+     * @param difficulty: Engine::DIFFICULTY both players use
+     */
+    void start(unsigned seed, int difficulty);
+    /**
+     * @brief frame
+     * Run on the timer: simulate the frames that are due
+     * and draw both fields
+     */
+    void frame();
+    /**
+     * @brief draw
+     * @param field: field to draw on
+     * @param player: whose game to draw
+     * Touch only the squares whose colour changed
+     */
+    void draw(Field& field, int player);
+    /**
+     * @brief showStatus
+     * Tell how the game is going
+     */
+    void showStatus();
+    /**
+     * @brief keyInput
+     * @param key: pressed or released key
+     * @return Engine::INPUT of the key, -1 if it has none
+     */
+    int keyInput(int key) const;
+    /**
+     * @brief frameTime
+     * @return game time of the next frame in ms
+     */
+    long frameTime() const;
+
+    UdpLink link_;
+    std::unique_ptr< Versus > versus_;
+    // 0 hosts, 1 joins
+    int player_ = 0;
+    unsigned seed_ = 0;
+    int difficulty_;
+    bool connecting_ = false;
+
+    // Frame timer and the time the session started
+    QTimer timer_;
+    QElapsedTimer clock_;
+    // Time the session could not go on, not simulated
+    qint64 waited_us_ = 0;
+    qint64 last_hello_ = -HELLO_INTERVAL_MS;
+    // Frames that had to wait for the other player
+    long stalls_ = 0;
+
+    // Key presses and releases waiting for the next frame
+    InputQueue inputs_;
+
+    Field fields_[2];
+
+    // Brushes. Ordered by 'Engine::TETROMINO_KIND', garbage last
+    std::vector< QBrush > colours_ = {
+        QBrush(Qt::cyan),
+        QBrush(Qt::blue),
+        QBrush(QColor("orange")),
+        QBrush(Qt::yellow),
+        QBrush(Qt::green),
+        QBrush(Qt::magenta),
+        QBrush(Qt::red),
+        // Board::GARBAGE
+        QBrush(Qt::darkGray)
+    };
+
+    // Key bindings, the same as in the single player game
+    Qt::Key KEY_DOWN = Qt::Key_S;
+    Qt::Key KEY_LEFT = Qt::Key_A;
+    Qt::Key KEY_RIGHT = Qt::Key_D;
+    Qt::Key KEY_ROTATE = Qt::Key_W;
+    Qt::Key KEY_DROP = Qt::Key_Space;
+
+    int DAS_MS = 167;
+    int ARR_MS = 33;
+};
+
+#endif // VERSUSWINDOW_HH
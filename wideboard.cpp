@@ -0,0 +1,212 @@
+/*
+ * Tetris -game
+ * Occupancy board for stress tests on fields
+ * far larger than the game's. Rows are bit
+ * vectors of many words, processed with AVX2
+ * where available
+ *
+ * Timi Rautamäki, 284032
+ *
+ */
+
+#include "wideboard.hh"
+#include <algorithm>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define WIDEBOARD_AVX2
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// Row operations over 'words' words, a multiple of VECTOR_WORDS
+
+bool missingScalar(const uint64_t* row, const uint64_t* full, int words) {
+    uint64_t missing = 0;
+    for ( int w = 0; w < words; ++w ) {
+        missing |= full[w] & ~row[w];
+    }
+    return missing != 0;
+}
+
+bool overlapScalar(const uint64_t* row, const uint64_t* mask, int words) {
+    uint64_t overlap = 0;
+    for ( int w = 0; w < words; ++w ) {
+        overlap |= row[w] & mask[w];
+    }
+    return overlap != 0;
+}
+
+#ifdef WIDEBOARD_AVX2
+
+__attribute__((target("avx2")))
+bool missingAvx2(const uint64_t* row, const uint64_t* full, int words) {
+    __m256i missing = _mm256_setzero_si256();
+    for ( int w = 0; w < words; w += WideBoard::VECTOR_WORDS ) {
+        __m256i r = _mm256_loadu_si256(
+                    reinterpret_cast< const __m256i* >(row + w));
+        __m256i f = _mm256_loadu_si256(
+                    reinterpret_cast< const __m256i* >(full + w));
+        missing = _mm256_or_si256(missing, _mm256_andnot_si256(r, f));
+    }
+    return !_mm256_testz_si256(missing, missing);
+}
+
+__attribute__((target("avx2")))
+bool overlapAvx2(const uint64_t* row, const uint64_t* mask, int words) {
+    __m256i overlap = _mm256_setzero_si256();
+    for ( int w = 0; w < words; w += WideBoard::VECTOR_WORDS ) {
+        __m256i r = _mm256_loadu_si256(
+                    reinterpret_cast< const __m256i* >(row + w));
+        __m256i m = _mm256_loadu_si256(
+                    reinterpret_cast< const __m256i* >(mask + w));
+        overlap = _mm256_or_si256(overlap, _mm256_and_si256(r, m));
+    }
+    return !_mm256_testz_si256(overlap, overlap);
+}
+
+#endif
+
+}
+
+WideBoard::WideBoard(int columns, int rows) :
+    columns_(std::min(std::max(columns, 1), int(MAX_COLUMNS))),
+    rows_(std::min(std::max(rows, 1), int(MAX_ROWS))),
+    avx2_(hasAvx2()) {
+
+    int words = (columns_ + 63) / 64;
+    words_ = (words + VECTOR_WORDS - 1) / VECTOR_WORDS * VECTOR_WORDS;
+
+    cells_.assign(size_t(rows_) * size_t(words_), 0);
+    index_.resize(size_t(rows_));
+    freed_.reserve(size_t(rows_));
+
+    full_.assign(size_t(words_), 0);
+    for ( int x = 0; x < columns_; ++x ) {
+        full_[size_t(x / 64)] |= uint64_t(1) << (x % 64);
+    }
+
+    clear();
+}
+
+void WideBoard::clear() {
+    std::fill(cells_.begin(), cells_.end(), 0);
+    for ( int y = 0; y < rows_; ++y ) {
+        index_[size_t(y)] = uint32_t(y);
+    }
+}
+
+bool WideBoard::occupied(int x, int y) const {
+    if ( x < 0 || x >= columns_ || y >= rows_ ) return true;
+    if ( y < 0 ) return false;
+
+    return (slot(y)[x / 64] >> (x % 64)) & 1;
+}
+
+void WideBoard::set(int x, int y) {
+    if ( x < 0 || x >= columns_ || y < 0 || y >= rows_ ) return;
+
+    slot(y)[x / 64] |= uint64_t(1) << (x % 64);
+}
+
+void WideBoard::fillRow(int y, int hole) {
+    if ( y < 0 || y >= rows_ ) return;
+
+    uint64_t* r = slot(y);
+    std::memcpy(r, full_.data(), size_t(words_) * sizeof(uint64_t));
+    if ( hole >= 0 && hole < columns_ ) {
+        r[hole / 64] &= ~(uint64_t(1) << (hole % 64));
+    }
+}
+
+bool WideBoard::isFull(int y) const {
+#ifdef WIDEBOARD_AVX2
+    if ( avx2_ ) return !missingAvx2(slot(y), full_.data(), words_);
+#endif
+    return !missingScalar(slot(y), full_.data(), words_);
+}
+
+bool WideBoard::collides(const uint64_t* mask, int y) const {
+    if ( y < 0 ) return false;
+    if ( y >= rows_ ) return true;
+
+#ifdef WIDEBOARD_AVX2
+    if ( avx2_ ) return overlapAvx2(slot(y), mask, words_);
+#endif
+    return overlapScalar(slot(y), mask, words_);
+}
+
+bool WideBoard::fits(const Tetrominos::Orientation& o, int x, int y) const {
+    if ( x + o.min_x < 0 || x + o.max_x >= columns_ ) return false;
+    if ( y + o.max_y >= rows_ ) return false;
+
+    // A tetromino row covers at most two words. Past the last
+    // word there are no cells, the wall check covers them.
+    int left = x + o.min_x;
+    int word = left / 64;
+    int shift = left % 64;
+    bool spills = shift > 60 && word + 1 < words_;
+
+    for ( int r = o.min_y; r <= o.max_y; ++r ) {
+        if ( y + r < 0 ) continue;
+
+        uint64_t bits = uint64_t(o.rows[r]) >> o.min_x;
+        const uint64_t* cells = slot(y + r);
+
+        if ( cells[word] & (bits << shift) ) {
+            return false;
+        }
+        if ( spills && (cells[word + 1] & (bits >> (64 - shift))) ) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int WideBoard::clearFullRows(int top, int bottom) {
+    if ( top < 0 ) top = 0;
+    if ( bottom >= rows_ ) bottom = rows_ - 1;
+
+    // Compact the index of the checked range from the bottom up,
+    // setting the storage of the full rows aside
+    freed_.clear();
+    int write = bottom;
+    for ( int y = bottom; y >= top; --y ) {
+        if ( isFull(y) ) {
+            freed_.push_back(index_[size_t(y)]);
+            continue;
+        }
+        index_[size_t(write)] = index_[size_t(y)];
+        --write;
+    }
+
+    int cleared = int(freed_.size());
+    if ( cleared == 0 ) return 0;
+
+    // Rows above the range slide down, only their index moves
+    std::memmove(&index_[size_t(cleared)], &index_[0],
+                 size_t(top) * sizeof(uint32_t));
+
+    // The cleared rows come back empty at the top
+    for ( int i = 0; i < cleared; ++i ) {
+        index_[size_t(i)] = freed_[size_t(i)];
+        std::memset(slot(i), 0, size_t(words_) * sizeof(uint64_t));
+    }
+
+    return cleared;
+}
+
+bool WideBoard::hasAvx2() {
+#ifdef WIDEBOARD_AVX2
+    return __builtin_cpu_supports("avx2");
+#else
+    return false;
+#endif
+}
+
+bool WideBoard::setAvx2(bool enabled) {
+    avx2_ = enabled && hasAvx2();
+    return avx2_;
+}
@@ -0,0 +1,143 @@
+/*
+ * Tetris -game
+ * Occupancy board for stress tests on fields
+ * far larger than the game's. Rows are bit
+ * vectors of many words, processed with AVX2
+ * where available
+ *
+ * Timi Rautamäki, 284032
+ *
+ */
+
+#ifndef WIDEBOARD_HH
+#define WIDEBOARD_HH
+
+#include "tetromino.hh"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class WideBoard {
+public:
+    static const int MAX_COLUMNS = 512;
+    static const int MAX_ROWS = 4096;
+    // Rows are padded to whole vectors of this many words
+    static const int VECTOR_WORDS = 4;
+
+    /**
+     * @brief WideBoard
+     * @param columns: 1..MAX_COLUMNS
+     * @param rows: 1..MAX_ROWS
+     */
+    WideBoard(int columns, int rows);
+
+    int columns() const { return columns_; }
+    int rows() const { return rows_; }
+    // 64-bit words per row, padding included
+    int words() const { return words_; }
+
+    /**
+     * @brief clear
+     * Empty the whole board
+     */
+    void clear();
+    /**
+     * @brief occupied
+     * @param x: column
+     * @param y: row
+     * @return true if the cell is taken. Cells outside the
+     *         walls and floor count as taken, cells above
+     *         the top of the field count as free
+     */
+    bool occupied(int x, int y) const;
+    /**
+     * @brief set
+     * @param x: column
+     * @param y: row
+     * Mark a cell as taken
+     */
+    void set(int x, int y);
+    /**
+     * @brief fillRow
+     * @param y: row
+     * @param hole: column to leave free, -1 for none
+     * Take every cell of the row but 'hole'
+     */
+    void fillRow(int y, int hole = -1);
+    /**
+     * @brief row
+     * @param y: row
+     * @return the words of the row, bit 0 of word 0 is column 0
+     */
+    const uint64_t* row(int y) const { return slot(y); }
+
+    /**
+     * @brief isFull
+     * @param y: row
+     * @return true if every column of the row is taken
+     */
+    bool isFull(int y) const;
+    /**
+     * @brief collides
+     * @param mask: words() words to test against the row
+     * @param y: row
+     * @return true if the mask and the row share a taken cell
+     */
+    bool collides(const uint64_t* mask, int y) const;
+    /**
+     * @brief fits
+     * @param o: orientation
+     * @param x: x coordinate of the 4*4 box
+     * @param y: y coordinate of the 4*4 box
+     * @return true if the tetromino does not overlap walls, the floor
+     *         or taken cells. Rows above the field are free.
+     */
+    bool fits(const Tetrominos::Orientation& o, int x, int y) const;
+    /**
+     * @brief clearFullRows
+     * @param top: first row to check
+     * @param bottom: last row to check
+     * @return number of rows cleared
+     * Remove every full row between 'top' and 'bottom'. Rows are
+     * reached through an index, so the rows above slide down by
+     * moving their index entries, not their words. Only the
+     * checked rows and the cleared ones are touched word by word.
+     */
+    int clearFullRows(int top, int bottom);
+
+    /**
+     * @brief hasAvx2
+     * @return true if the CPU and the build support AVX2
+     */
+    static bool hasAvx2();
+    /**
+     * @brief setAvx2
+     * @param enabled: use AVX2 for the row operations
+     * @return true if AVX2 is in use
+     */
+    bool setAvx2(bool enabled);
+
+private:
+    uint64_t* slot(int y) {
+        return &cells_[size_t(index_[y]) * size_t(words_)];
+    }
+    const uint64_t* slot(int y) const {
+        return &cells_[size_t(index_[y]) * size_t(words_)];
+    }
+
+    int columns_;
+    int rows_;
+    int words_;
+    bool avx2_;
+
+    // Row storage, rows_ rows of words_ words in any order
+    std::vector< uint64_t > cells_;
+    // Storage row of every row of the field, top down
+    std::vector< uint32_t > index_;
+    // A full row, the padding bits are zero
+    std::vector< uint64_t > full_;
+    // Storage rows freed by clearFullRows()
+    std::vector< uint32_t > freed_;
+};
+
+#endif // WIDEBOARD_HH